@@ -307,6 +307,8 @@ struct LodePNGCompressSettings /*deflate = compress*/
 
 extern const LodePNGCompressSettings lodepng_default_compress_settings;
 void lodepng_compress_settings_init(LodePNGCompressSettings* settings);
+/*preset for frame dumps: a fast, shallow LZ77 search and the parallel zlib compressor*/
+void lodepng_compress_settings_init_fast(LodePNGCompressSettings* settings);
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 #ifdef LODEPNG_COMPILE_PNG
@@ -775,6 +777,16 @@ unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize,
                                const unsigned char* in, size_t insize,
                                const LodePNGCompressSettings* settings);
 
+/*
+Same as lodepng_zlib_compress, but deflates independent stripes of the input on
+all OpenMP threads and joins them into one valid zlib stream. The output does
+not depend on the thread count. Has the signature of custom_zlib, so setting
+settings.custom_zlib to it makes the PNG encoder compress in parallel.
+*/
+unsigned lodepng_zlib_compress_parallel(unsigned char** out, size_t* outsize,
+                                        const unsigned char* in, size_t insize,
+                                        const LodePNGCompressSettings* settings);
+
 /*
 Find length-limited Huffman code for given frequencies. This function is in the
 public interface only for tests, it's used internally by lodepng_deflate.
@@ -1993,17 +1993,16 @@ static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
   return error;
 }
 
-static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
-                                 const LodePNGCompressSettings* settings)
+/*deflates in as a series of fixed or dynamic blocks. Only if final is set does the last block have
+BFINAL set, otherwise the stream can be continued with more blocks, as the parallel zlib compressor does.*/
+static unsigned deflateBlocks(ucvector* out, size_t* bp, const unsigned char* in, size_t insize,
+                              const LodePNGCompressSettings* settings, unsigned final)
 {
   unsigned error = 0;
   size_t i, blocksize, numdeflateblocks;
-  size_t bp = 0; /*the bit pointer*/
   Hash hash;
 
-  if(settings->btype > 2) return 61;
-  else if(settings->btype == 0) return deflateNoCompression(out, in, insize);
-  else if(settings->btype == 1) blocksize = insize;
+  if(settings->btype == 1) blocksize = insize;
   else /*if(settings->btype == 2)*/
   {
     /*on PNGs, deflate blocks of 65-262k seem to give most dense encoding*/
@@ -2020,13 +2019,13 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
 
   for(i = 0; i != numdeflateblocks && !error; ++i)
   {
-    unsigned final = (i == numdeflateblocks - 1);
+    unsigned lastblock = final && (i == numdeflateblocks - 1);
     size_t start = i * blocksize;
     size_t end = start + blocksize;
     if(end > insize) end = insize;
 
-    if(settings->btype == 1) error = deflateFixed(out, &bp, &hash, in, start, end, settings, final);
-    else if(settings->btype == 2) error = deflateDynamic(out, &bp, &hash, in, start, end, settings, final);
+    if(settings->btype == 1) error = deflateFixed(out, bp, &hash, in, start, end, settings, lastblock);
+    else if(settings->btype == 2) error = deflateDynamic(out, bp, &hash, in, start, end, settings, lastblock);
   }
 
   hash_cleanup(&hash);
@@ -2034,6 +2033,16 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
   return error;
 }
 
+static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
+                                 const LodePNGCompressSettings* settings)
+{
+  size_t bp = 0; /*the bit pointer*/
+
+  if(settings->btype > 2) return 61;
+  else if(settings->btype == 0) return deflateNoCompression(out, in, insize);
+  return deflateBlocks(out, &bp, in, insize, settings, 1);
+}
+
 unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings)
@@ -2096,6 +2105,25 @@ static unsigned adler32(const unsigned char* data, unsigned len)
   return update_adler32(1L, data, len);
 }
 
+#ifdef LODEPNG_COMPILE_ENCODER
+/*Return the adler32 of two buffers joined, from the adler32 of each and the length of the second.
+Same method as zlib's adler32_combine.*/
+static unsigned adler32_combine(unsigned adler1, unsigned adler2, size_t len2)
+{
+  const unsigned base = 65521;
+  unsigned rem = (unsigned)(len2 % base);
+  unsigned sum1 = adler1 & 0xffff;
+  unsigned sum2 = (rem * sum1) % base;
+  sum1 += (adler2 & 0xffff) + base - 1;
+  sum2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + base - rem;
+  if(sum1 >= base) sum1 -= base;
+  if(sum1 >= base) sum1 -= base;
+  if(sum2 >= (base << 1)) sum2 -= (base << 1);
+  if(sum2 >= base) sum2 -= base;
+  return sum1 | (sum2 << 16);
+}
+#endif /*LODEPNG_COMPILE_ENCODER*/
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Zlib                                                                   / */
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -2205,6 +2233,87 @@ unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsig
   return error;
 }
 
+/*size of the input stripes the parallel compressor deflates independently. Fixed rather than derived from
+the thread count, so the output is the same whatever machine made it.*/
+#define PARALLEL_STRIPE_SIZE 524288
+
+/*one stripe of the parallel compressor*/
+typedef struct ZlibStripe
+{
+  ucvector data;
+  unsigned adler;
+  unsigned error;
+} ZlibStripe;
+
+unsigned lodepng_zlib_compress_parallel(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                        size_t insize, const LodePNGCompressSettings* settings)
+{
+  ucvector outv;
+  ZlibStripe* stripes;
+  long i, numstripes;
+  unsigned error = 0;
+  unsigned ADLER32 = 1;
+  unsigned CMFFLG = 256 * 120 + 1; /*CM 8, CINFO 7, FCHECK 1 as in lodepng_zlib_compress*/
+
+  /*stored blocks and custom deflaters can not be split; neither can small inputs usefully*/
+  if(settings->btype == 0 || settings->custom_deflate || insize <= PARALLEL_STRIPE_SIZE)
+  {
+    return lodepng_zlib_compress(out, outsize, in, insize, settings);
+  }
+  if(settings->btype > 2) return 61;
+
+  numstripes = (long)((insize + PARALLEL_STRIPE_SIZE - 1) / PARALLEL_STRIPE_SIZE);
+  stripes = (ZlibStripe*)lodepng_malloc(numstripes * sizeof(ZlibStripe));
+  if(!stripes) return 83; /*alloc fail*/
+
+  /*every stripe but the last ends with an empty stored block (a zlib sync flush): it leaves the bit stream
+  byte aligned without ending it, so the stripes can simply be concatenated. Back references never cross
+  stripes, which costs a little compression.*/
+#pragma omp parallel for schedule(dynamic, 1)
+  for(i = 0; i < numstripes; ++i)
+  {
+    size_t start = (size_t)i * PARALLEL_STRIPE_SIZE;
+    size_t size = insize - start < PARALLEL_STRIPE_SIZE ? insize - start : PARALLEL_STRIPE_SIZE;
+    unsigned last = (i == numstripes - 1);
+    size_t bp = 0;
+    ZlibStripe* stripe = &stripes[i];
+    ucvector_init(&stripe->data);
+    stripe->adler = adler32(&in[start], (unsigned)size);
+    stripe->error = deflateBlocks(&stripe->data, &bp, &in[start], size, settings, last);
+    if(!last && !stripe->error)
+    {
+      addBitsToStream(&bp, &stripe->data, 0, 3); /*BFINAL 0, BTYPE 00*/
+      ucvector_push_back(&stripe->data, 0);
+      ucvector_push_back(&stripe->data, 0);
+      ucvector_push_back(&stripe->data, 255);
+      ucvector_push_back(&stripe->data, 255);
+    }
+  }
+
+  ucvector_init_buffer(&outv, *out, *outsize);
+  ucvector_push_back(&outv, (unsigned char)(CMFFLG / 256));
+  ucvector_push_back(&outv, (unsigned char)(CMFFLG % 256));
+  for(i = 0; i != numstripes; ++i)
+  {
+    size_t j, size = insize - (size_t)i * PARALLEL_STRIPE_SIZE;
+    if(size > PARALLEL_STRIPE_SIZE) size = PARALLEL_STRIPE_SIZE;
+    if(stripes[i].error && !error) error = stripes[i].error;
+    if(!error)
+    {
+      for(j = 0; j != stripes[i].data.size; ++j) ucvector_push_back(&outv, stripes[i].data.data[j]);
+      ADLER32 = i == 0 ? stripes[i].adler : adler32_combine(ADLER32, stripes[i].adler, size);
+    }
+    ucvector_cleanup(&stripes[i].data);
+  }
+  lodepng_free(stripes);
+  if(!error) lodepng_add32bitInt(&outv, ADLER32);
+
+  *out = outv.data;
+  *outsize = outv.size;
+
+  return error;
+}
+
 /* compress using the default or custom zlib function */
 static unsigned zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
                               size_t insize, const LodePNGCompressSettings* settings)
@@ -2266,6 +2375,16 @@ void lodepng_compress_settings_init(LodePNGCompressSettings* settings)
 
 const LodePNGCompressSettings lodepng_default_compress_settings = {2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, 0, 0, 0};
 
+void lodepng_compress_settings_init_fast(LodePNGCompressSettings* settings)
+{
+  lodepng_compress_settings_init(settings);
+  /*take the first good match instead of searching on: on filtered frames this costs about 5% in size.
+  The window stays at the default, shrinking it costs far more size than it saves time*/
+  settings->nicematch = 16;
+  settings->lazymatching = 0;
+  settings->custom_zlib = lodepng_zlib_compress_parallel;
+}
+
 
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
@@ -5168,41 +5287,54 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
   }
   else if(strategy == LFS_MINSUM)
   {
-    /*adaptive filtering*/
-    size_t sum[5];
-    ucvector attempt[5]; /*five filtering attempts, one for each filter type*/
-    size_t smallest = 0;
-    unsigned char type, bestType = 0;
-
-    for(type = 0; type != 5; ++type)
+    /*adaptive filtering. A row only reads the unfiltered row above it, so rows are filtered in parallel,
+    each thread with its own five attempts*/
+    long row;
+#pragma omp parallel
     {
-      ucvector_init(&attempt[type]);
-      if(!ucvector_resize(&attempt[type], linebytes)) return 83; /*alloc fail*/
-    }
+      size_t sum[5];
+      ucvector attempt[5]; /*five filtering attempts, one for each filter type*/
+      size_t smallest = 0, i;
+      unsigned char type, bestType = 0;
+      unsigned allocated = 1;
 
-    if(!error)
-    {
-      for(y = 0; y != h; ++y)
+      for(type = 0; type != 5; ++type)
       {
+        ucvector_init(&attempt[type]);
+        if(!ucvector_resize(&attempt[type], linebytes)) allocated = 0;
+      }
+      if(!allocated)
+      {
+#pragma omp critical
+        error = 83; /*alloc fail*/
+      }
+
+#pragma omp for schedule(static)
+      for(row = 0; row < (long)h; ++row)
+      {
+        const unsigned char* above = row == 0 ? 0 : &in[(row - 1) * linebytes];
+        const unsigned char* line = &in[row * linebytes];
+        if(!allocated) continue;
+
         /*try the 5 filter types*/
         for(type = 0; type != 5; ++type)
         {
-          filterScanline(attempt[type].data, &in[y * linebytes], prevline, linebytes, bytewidth, type);
+          filterScanline(attempt[type].data, line, above, linebytes, bytewidth, type);
 
           /*calculate the sum of the result*/
           sum[type] = 0;
           if(type == 0)
           {
-            for(x = 0; x != linebytes; ++x) sum[type] += (unsigned char)(attempt[type].data[x]);
+            for(i = 0; i != linebytes; ++i) sum[type] += (unsigned char)(attempt[type].data[i]);
           }
           else
           {
-            for(x = 0; x != linebytes; ++x)
+            for(i = 0; i != linebytes; ++i)
             {
               /*For differences, each byte should be treated as signed, values above 127 are negative
               (converted to signed char). Filtertype 0 isn't a difference though, so use unsigned there.
               This means filtertype 0 is almost never chosen, but that is justified.*/
-              unsigned char s = attempt[type].data[x];
+              unsigned char s = attempt[type].data[i];
               sum[type] += s < 128 ? s : (255U - s);
             }
           }
@@ -5215,15 +5347,13 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
           }
         }
 
-        prevline = &in[y * linebytes];
-
         /*now fill the out values*/
-        out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-        for(x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType].data[x];
+        out[row * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
+        for(i = 0; i != linebytes; ++i) out[row * (linebytes + 1) + 1 + i] = attempt[bestType].data[i];
       }
-    }
 
-    for(type = 0; type != 5; ++type) ucvector_cleanup(&attempt[type]);
+      for(type = 0; type != 5; ++type) ucvector_cleanup(&attempt[type]);
+    }
   }
   else if(strategy == LFS_ENTROPY)
   {
@@ -0,0 +1,298 @@
+#include "Audio.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include "Simulation.h"
+#include "CGL/complex.h"
+
+using CGL::Complex;
+
+// WAVE format tags.
+static const int WAVE_FORMAT_PCM = 1;
+static const int WAVE_FORMAT_IEEE_FLOAT = 3;
+static const int WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+// Little-endian field readers.
+static unsigned int readLe16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned int readLe32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<unsigned int>(p[3]) << 24);
+}
+
+// Opens the file and parses its header.
+bool WavReader::open(const std::string& filename, std::string& error) {
+    file.close();
+    file.clear();
+    file.open(filename.c_str(), std::ios::binary);
+    if (!file) {
+        error = "cannot open file";
+        return false;
+    }
+
+    unsigned char header[12];
+    if (!file.read(reinterpret_cast<char*>(header), 12) ||
+        std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0) {
+        error = "not a RIFF WAVE file";
+        return false;
+    }
+
+    // Walk the chunks until the sample data, picking up the format on the way.
+    bool haveFormat = false;
+    int blockAlign = 0;
+    while (true) {
+        unsigned char chunk[8];
+        if (!file.read(reinterpret_cast<char*>(chunk), 8)) {
+            error = "no data chunk";
+            return false;
+        }
+        const unsigned int chunkSize = readLe32(chunk + 4);
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            std::vector<unsigned char> format(std::max(chunkSize, 16u));
+            if (chunkSize < 16 || !file.read(reinterpret_cast<char*>(format.data()), chunkSize)) {
+                error = "truncated format chunk";
+                return false;
+            }
+            int tag = readLe16(&format[0]);
+            if (tag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 26) tag = readLe16(&format[24]);
+            channels = readLe16(&format[2]);
+            sampleRate = readLe32(&format[4]);
+            blockAlign = readLe16(&format[12]);
+            bitsPerSample = readLe16(&format[14]);
+            floatSamples = tag == WAVE_FORMAT_IEEE_FLOAT;
+            const bool supported = (tag == WAVE_FORMAT_PCM && bitsPerSample >= 8 && bitsPerSample <= 32 &&
+                                    bitsPerSample % 8 == 0) ||
+                                   (floatSamples && bitsPerSample == 32);
+            if (!supported || channels < 1 || sampleRate < 1 || blockAlign != channels * bitsPerSample / 8) {
+                error = "unsupported sample format";
+                return false;
+            }
+            haveFormat = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat) {
+                error = "data chunk before format chunk";
+                return false;
+            }
+            frames = chunkSize / blockAlign;
+            framesRead = 0;
+            return true;
+        } else {
+            file.seekg(chunkSize + (chunkSize & 1), std::ios::cur);   // Chunks are padded to even sizes.
+        }
+    }
+}
+
+// Reads up to count mono samples in [-1, 1].
+int WavReader::read(float* out, int count) {
+    const int bytesPerSample = bitsPerSample / 8;
+    const int frameBytes = bytesPerSample * channels;
+    const int wanted = static_cast<int>(std::min<long long>(count, frames - framesRead));
+    if (wanted <= 0) return 0;
+
+    bytes.resize(static_cast<size_t>(wanted) * frameBytes);
+    file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    const int got = static_cast<int>(file.gcount() / frameBytes);
+
+    const float channelScale = 1.0f / channels;
+    for (int i = 0; i < got; ++i) {
+        const unsigned char* p = &bytes[static_cast<size_t>(i) * frameBytes];
+        float sum = 0;
+        for (int c = 0; c < channels; ++c, p += bytesPerSample) {
+            if (floatSamples) {
+                float value;
+                std::memcpy(&value, p, sizeof(value));
+                sum += value;
+            } else if (bytesPerSample == 1) {
+                sum += (p[0] - 128) / 128.0f;
+            } else {
+                // Left-align the sample in 32 bits so the sign lands in the top bit.
+                unsigned int raw = 0;
+                for (int b = 0; b < bytesPerSample; ++b) raw |= static_cast<unsigned int>(p[b]) << (8 * (4 - bytesPerSample + b));
+                sum += static_cast<int>(raw) / 2147483648.0f;
+            }
+        }
+        out[i] = sum * channelScale;
+    }
+    framesRead += got;
+    if (got < wanted) frames = framesRead;   // Truncated file.
+    return got;
+}
+
+// Twiddle factors and the in-place transform buffer.
+struct SpectrumAnalyzer::Transform {
+    std::vector<Complex> twiddles;
+    std::vector<Complex> buffer;
+};
+
+SpectrumAnalyzer::SpectrumAnalyzer() : transform(new Transform) {}
+
+SpectrumAnalyzer::~SpectrumAnalyzer() {}
+
+// Prepares the window and tables for blocks of size samples.
+void SpectrumAnalyzer::resize(int newSize) {
+    size = newSize;
+    window.resize(size);
+    for (int i = 0; i < size; ++i) {
+        window[i] = 0.5f - 0.5f * std::cos(2.0 * PI * i / size);
+    }
+
+    int bits = 0;
+    while ((1 << bits) < size) ++bits;
+    bitReverse.resize(size);
+    for (int i = 0; i < size; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+        bitReverse[i] = r;
+    }
+
+    transform->twiddles.resize(size / 2);
+    for (int k = 0; k < size / 2; ++k) {
+        const double angle = -2.0 * PI * k / size;
+        transform->twiddles[k] = Complex(std::cos(angle), std::sin(angle));
+    }
+    transform->buffer.resize(size);
+    magnitudes.resize(size / 2 + 1);
+}
+
+// Transforms size samples into magnitudes.
+void SpectrumAnalyzer::analyze(const float* samples) {
+    std::vector<Complex>& buffer = transform->buffer;
+    const std::vector<Complex>& twiddles = transform->twiddles;
+    for (int i = 0; i < size; ++i) {
+        buffer[bitReverse[i]] = Complex(samples[i] * window[i], 0.0);
+    }
+
+    for (int length = 2; length <= size; length <<= 1) {
+        const int half = length / 2;
+        const int stride = size / length;
+        for (int start = 0; start < size; start += length) {
+            for (int k = 0; k < half; ++k) {
+                Complex& a = buffer[start + k];
+                Complex& b = buffer[start + k + half];
+                const Complex t = b * twiddles[k * stride];
+                b = a - t;
+                a += t;
+            }
+        }
+    }
+
+    // Scale so a full-scale sine at a bin centre has magnitude 1 (the Hann window halves the gain).
+    const float scale = 4.0f / size;
+    for (int k = 0; k <= size / 2; ++k) {
+        magnitudes[k] = static_cast<float>(buffer[k].norm()) * scale;
+    }
+}
+
+// Finds the strongest local maxima of the magnitude spectrum.
+void SpectrumAnalyzer::peaks(int count, float threshold, float sampleRate,
+                             std::vector<float>& frequencies, std::vector<float>& levels) const {
+    frequencies.clear();
+    levels.clear();
+    const int bins = static_cast<int>(magnitudes.size());
+    const float largest = *std::max_element(magnitudes.begin() + 1, magnitudes.end());
+    if (largest <= 0) return;
+
+    std::vector<std::pair<float, int> > candidates;
+    for (int k = 2; k < bins - 1; ++k) {
+        const float m = magnitudes[k];
+        if (m >= threshold * largest && m > magnitudes[k - 1] && m >= magnitudes[k + 1]) {
+            candidates.push_back(std::make_pair(m, k));
+        }
+    }
+    const int kept = std::min(count, static_cast<int>(candidates.size()));
+    std::partial_sort(candidates.begin(), candidates.begin() + kept, candidates.end(),
+                      std::greater<std::pair<float, int> >());
+
+    for (int i = 0; i < kept; ++i) {
+        const int k = candidates[i].second;
+        const float a = std::log(magnitudes[k - 1] + 1e-12f);
+        const float b = std::log(magnitudes[k] + 1e-12f);
+        const float c = std::log(magnitudes[k + 1] + 1e-12f);
+        const float denominator = a - 2.0f * b + c;
+        const float offset = denominator < 0 ? 0.5f * (a - c) / denominator : 0.0f;
+        frequencies.push_back((k + offset) * sampleRate / size);
+        levels.push_back(candidates[i].first);
+    }
+}
+
+// Opens the WAV file.
+bool AudioExcitation::open(const std::string& filename, std::string& error) {
+    if (!reader.open(filename, error)) return false;
+    spectrum.resize(windowSize);
+    history.assign(windowSize, 0.0f);
+    blocks = 0;
+    analysisSeconds = 0;
+    dominantFrequency = 0;
+    endOfFile = false;
+    return true;
+}
+
+// Sets the resonant frequency of every pattern and clears the weights.
+void AudioExcitation::setPatterns(const std::vector<float>& frequencies) {
+    // Computed modes (e.g. of a mask) are only degenerate to solver precision.
+    patterns.degeneracyTolerance = 1e-3f;
+    patterns.build(frequencies);
+    patternWeights.assign(frequencies.size(), 0.0f);
+    blockWeights.assign(frequencies.size(), 0.0f);
+}
+
+// Audio seconds consumed.
+double AudioExcitation::position() const {
+    return reader.sampleRate > 0 ? static_cast<double>(reader.framesRead) / reader.sampleRate : 0.0;
+}
+
+// Reads one hop and analyses the window ending there. Returns true if the weights changed.
+bool AudioExcitation::analyzeBlock() {
+    std::memmove(history.data(), history.data() + hopSize, (windowSize - hopSize) * sizeof(float));
+    float* hop = history.data() + windowSize - hopSize;
+    const int got = reader.read(hop, hopSize);
+    std::fill(hop + got, hop + hopSize, 0.0f);
+    if (got < hopSize) endOfFile = true;
+    ++blocks;
+
+    float energy = 0;
+    for (float s : history) energy += s * s;
+    if (std::sqrt(energy / windowSize) < silenceLevel) return false;
+
+    spectrum.analyze(history.data());
+    spectrum.peaks(maxPeaks, peakThreshold, static_cast<float>(reader.sampleRate), peakFrequencies, peakLevels);
+    if (peakFrequencies.empty()) return false;
+    dominantFrequency = peakFrequencies[0];
+
+    std::fill(blockWeights.begin(), blockWeights.end(), 0.0f);
+    float total = 0;
+    for (size_t p = 0; p < peakFrequencies.size(); ++p) {
+        // A peak excites every pattern degenerate with the nearest one equally.
+        const int nearest = patterns.nearest(peakFrequencies[p]);
+        if (nearest < 0) continue;
+        const float frequency = patterns.modes()[nearest].frequency;
+        if (std::abs(frequency - peakFrequencies[p]) > matchTolerance * peakFrequencies[p]) continue;
+        const std::pair<int, int> range = patterns.degenerate(nearest);
+        const float share = peakLevels[p] / (range.second - range.first);
+        for (int i = range.first; i < range.second; ++i) {
+            blockWeights[patterns.modes()[i].pattern] += share;
+        }
+        total += peakLevels[p];
+    }
+    if (total <= 0) return false;
+
+    for (size_t i = 0; i < patternWeights.size(); ++i) {
+        patternWeights[i] += (blockWeights[i] / total - patternWeights[i]) * smoothing;
+    }
+    return true;
+}
+
+// Analyses every hop due by the given audio time.
+bool AudioExcitation::advanceTo(double seconds) {
+    auto start = std::chrono::steady_clock::now();
+    bool changed = false;
+    while (!endOfFile && position() < seconds) {
+        changed |= analyzeBlock();
+    }
+    analysisSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return changed;
+}
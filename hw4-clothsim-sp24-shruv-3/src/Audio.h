@@ -0,0 +1,115 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ModeIndex.h"
+
+// Streaming reader for RIFF WAVE files.
+// Reads 8, 16, 24 and 32-bit integer PCM and 32-bit float samples in small
+// chunks, mixing all channels down to mono, so files of any length can be
+// analysed without loading them whole.
+class WavReader {
+public:
+    // Opens the file and parses its header. Returns false and fills error if
+    // it is not a WAV file in a supported format.
+    bool open(const std::string& filename, std::string& error);
+
+    // Reads up to count mono samples in [-1, 1]. Returns the number read,
+    // which is less than count only at the end of the file.
+    int read(float* out, int count);
+
+    int sampleRate = 0;
+    int channels = 0;
+    long long frames = 0;        // Sample frames in the file.
+    long long framesRead = 0;
+
+private:
+    std::ifstream file;
+    int bitsPerSample = 0;
+    bool floatSamples = false;
+    std::vector<unsigned char> bytes;   // Raw chunk buffer, reused between reads.
+};
+
+// Magnitude spectrum of a Hann-windowed block.
+// An iterative radix-2 FFT on CGL::Complex with precomputed twiddle factors
+// and bit-reversal order.
+class SpectrumAnalyzer {
+public:
+    SpectrumAnalyzer();
+    ~SpectrumAnalyzer();
+
+    // Prepares the window and tables for blocks of size samples (a power of two).
+    void resize(int size);
+
+    // Transforms size samples. magnitudes then holds size / 2 + 1 bins.
+    void analyze(const float* samples);
+
+    // Finds up to count local maxima of at least threshold times the largest
+    // bin, strongest first. Frequencies are refined by parabolic interpolation
+    // of the neighbouring log magnitudes.
+    void peaks(int count, float threshold, float sampleRate,
+               std::vector<float>& frequencies, std::vector<float>& levels) const;
+
+    std::vector<float> magnitudes;
+
+private:
+    // The complex arrays live in Audio.cpp, the only file that includes CGL,
+    // because CGL's misc.h defines a PI macro that clashes with Simulation.h.
+    struct Transform;
+
+    int size = 0;
+    std::vector<float> window;
+    std::vector<int> bitReverse;
+    std::unique_ptr<Transform> transform;
+};
+
+// Drives the pattern weights from a WAV file.
+// Audio is consumed in hops; each hop the last windowSize samples are
+// transformed, the strongest spectral peaks are matched through a ModeIndex to
+// the patterns with the nearest resonant frequency, and the per-pattern
+// weights move toward the peak levels. The weights are meant for ModeBlender::compose.
+class AudioExcitation {
+public:
+    int windowSize = 4096;        // FFT length in samples, a power of two.
+    int hopSize = 1024;           // Samples between two analysed blocks.
+    int maxPeaks = 3;             // Spectral peaks matched to patterns per block.
+    float peakThreshold = 0.1f;   // Peaks weaker than this fraction of the strongest are ignored.
+    float matchTolerance = 0.08f; // Largest relative distance from a peak to a pattern frequency.
+    float silenceLevel = 1e-3f;   // RMS below which a block leaves the weights alone.
+    float smoothing = 0.5f;       // Fraction of the new block's weights mixed in per block.
+
+    // Opens the WAV file. Returns false and fills error on failure.
+    bool open(const std::string& filename, std::string& error);
+
+    // Sets the resonant frequency of every pattern and clears the weights.
+    void setPatterns(const std::vector<float>& frequencies);
+
+    // Analyses every hop due by the given audio time in seconds.
+    // Returns true if the weights changed.
+    bool advanceTo(double seconds);
+
+    const std::vector<float>& weights() const { return patternWeights; }
+    bool finished() const { return endOfFile; }
+    double position() const;          // Audio seconds consumed.
+
+    // Statistics.
+    long long blocks = 0;             // Blocks analysed.
+    double analysisSeconds = 0;       // Wall time spent reading and analysing.
+    float dominantFrequency = 0;      // Strongest peak of the last block in Hz.
+
+private:
+    bool analyzeBlock();
+
+    WavReader reader;
+    SpectrumAnalyzer spectrum;
+    std::vector<float> history;           // Last windowSize samples, oldest first.
+    ModeIndex patterns;                   // Pattern frequencies, sorted for nearest lookups.
+    std::vector<float> patternWeights, blockWeights;
+    std::vector<float> peakFrequencies, peakLevels;
+    bool endOfFile = true;
+};
+
+#endif // AUDIO_H
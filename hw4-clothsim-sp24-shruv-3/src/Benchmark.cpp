@@ -0,0 +1,1396 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Audio.h"
+#include "CGL/lodepng.h"
+#include "CGL/tinyexr.h"
+#include "CircularPlate.h"
+#include "Control.h"
+#include "FieldExr.h"
+#include "Integrator.h"
+#include "Json.h"
+#include "MeasuredField.h"
+#include "ModeIndex.h"
+#include "ModeBlend.h"
+#include "Multigrid.h"
+#include "Plate.h"
+#include "PngDump.h"
+#include "RunSpec.h"
+#include "Session.h"
+#include "SharedFrames.h"
+#include "SimClock.h"
+#include "Simulation.h"
+#include "SpatialGrid.h"
+#include "Superposition.h"
+#include "VideoStream.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Grid size used by the benchmarks, matching the default window.
+static const int BENCH_WIDTH = 640;
+static const int BENCH_HEIGHT = 480;
+
+// Seconds elapsed since start.
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Compares the analytic field against the driven plate solver for every mode.
+static void benchmarkFdtd(std::ostream& out) {
+    Simulation sim;
+    sim.width = BENCH_WIDTH;
+    sim.height = BENCH_HEIGHT;
+    const double cells = static_cast<double>(sim.width) * sim.height;
+
+    out << "mode    analytic ms  analytic cells/s   fdtd ms  fdtd steps  fdtd cells/s  steady" << std::endl;
+    for (const ChladniParams& params : chladniParams) {
+        auto start = std::chrono::steady_clock::now();
+        sim.computeVibrationValues(params);
+        double analyticSeconds = secondsSince(start);
+
+        PlateSolver plate;
+        start = std::chrono::steady_clock::now();
+        bool steady = plate.solve(calculateFrequency(params));
+        plate.sampleAmplitude(sim.vibrationValues, sim.width, sim.height);
+        double fdtdSeconds = secondsSince(start);
+
+        char line[256];
+        snprintf(line, sizeof(line), "(%d,%d)  %11.2f  %16.3g  %8.0f  %10lld  %12.3g  %s",
+                 params.m, params.n, analyticSeconds * 1000.0, cells / analyticSeconds,
+                 fdtdSeconds * 1000.0, plate.steps, plate.cellsPerSecond(), steady ? "yes" : "no");
+        out << line << std::endl;
+    }
+}
+
+// Sweeps relaxation may take in the multigrid comparison before it is called stalled.
+static const int RELAX_SWEEPS = 5000;
+
+// Compares time to a steady driven field: multigrid with and without GMRES,
+// plain Gauss-Seidel relaxation and time stepping.
+static void benchmarkMultigrid(std::ostream& out) {
+    out << "mode    gmres+mg cycles  rate   ms    v-cycle cycles  rate   ms    "
+           "relax sweeps  rate     residual   ms      fdtd ms" << std::endl;
+    for (const ChladniParams& params : chladniParams) {
+        const float frequency = calculateFrequency(params);
+
+        PlateMultigrid accelerated;
+        accelerated.solve(frequency);
+
+        PlateMultigrid plain;
+        plain.accelerate = false;
+        plain.solve(frequency);
+
+        PlateMultigrid relaxed;
+        relaxed.relax(frequency, RELAX_SWEEPS);
+
+        PlateSolver plate;
+        plate.resolution = accelerated.resolution;
+        plate.solve(frequency);
+
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "(%d,%d)  %15d  %5.3f  %5.0f  %14d  %5.3f  %5.0f  %12d  %7.5f  %9.2e  %6.0f  %8.0f",
+                 params.m, params.n,
+                 accelerated.cycles, accelerated.convergenceRate, accelerated.seconds * 1000.0,
+                 plain.cycles, plain.convergenceRate, plain.seconds * 1000.0,
+                 relaxed.cycles, relaxed.convergenceRate, relaxed.residual, relaxed.seconds * 1000.0,
+                 plate.seconds * 1000.0);
+        out << line << std::endl;
+    }
+}
+
+// Compares building the circular Bessel fields from their tables against the
+// square analytic field of the same grid.
+static void benchmarkCircular(std::ostream& out) {
+    Simulation sim;
+    sim.width = BENCH_WIDTH;
+    sim.height = BENCH_HEIGHT;
+    const double cells = static_cast<double>(sim.width) * sim.height;
+
+    // One-off costs: Bessel tables for every mode and per-pixel table positions.
+    CircularPlate circular;
+    auto start = std::chrono::steady_clock::now();
+    circular.precompute(circularModes);
+    double tableSeconds = secondsSince(start);
+    start = std::chrono::steady_clock::now();
+    circular.sampleMode(circularModes[0], sim.vibrationValues, sim.width, sim.height);
+    double geometrySeconds = secondsSince(start);
+    char line[256];
+    snprintf(line, sizeof(line), "tables %.2f ms, first field with geometry %.2f ms", tableSeconds * 1000.0,
+             geometrySeconds * 1000.0);
+    out << line << std::endl;
+
+    out << "square  analytic ms  analytic cells/s   circle  bessel ms  bessel cells/s  frequency Hz" << std::endl;
+    for (size_t i = 0; i < circularModes.size(); ++i) {
+        const ChladniParams& params = chladniParams[i % chladniParams.size()];
+        start = std::chrono::steady_clock::now();
+        sim.computeVibrationValues(params);
+        double analyticSeconds = secondsSince(start);
+
+        const CircularMode& mode = circularModes[i];
+        start = std::chrono::steady_clock::now();
+        circular.sampleMode(mode, sim.vibrationValues, sim.width, sim.height);
+        double besselSeconds = secondsSince(start);
+
+        snprintf(line, sizeof(line), "(%d,%d)  %11.2f  %16.3g   (%d,%d)  %9.2f  %14.3g  %12.1f",
+                 params.m, params.n, analyticSeconds * 1000.0, cells / analyticSeconds,
+                 mode.n, mode.s, besselSeconds * 1000.0, cells / besselSeconds, circularFrequency(mode));
+        out << line << std::endl;
+    }
+}
+
+// Frames timed in the blend benchmark, one crossfade per pattern at 60 FPS.
+static const int BLEND_FRAMES = 600;
+
+// Compares a frame of the crossfade, blended from cached patterns, against
+// rebuilding the analytic field every frame.
+static void benchmarkBlend(std::ostream& out) {
+    Simulation sim;
+    sim.width = BENCH_WIDTH;
+    sim.height = BENCH_HEIGHT;
+    Simulation patternSim;
+    patternSim.width = sim.width;
+    patternSim.height = sim.height;
+
+    ModeBlender blender;
+    blender.reset([&](int pattern, std::vector<float>& field) {
+        patternSim.computeVibrationValues(chladniParams[pattern]);
+        field.swap(patternSim.vibrationValues);
+    }, static_cast<int>(chladniParams.size()), 0);
+
+    // First pass builds every pattern once, second pass only blends.
+    const float dt = 1.0f / 60.0f;
+    double passSeconds[2];
+    for (int pass = 0; pass < 2; ++pass) {
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < BLEND_FRAMES; ++frame) {
+            if (frame % 60 == 0) blender.step(1);
+            blender.update(sim, dt);
+        }
+        passSeconds[pass] = secondsSince(start);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < BLEND_FRAMES; ++frame) {
+        sim.computeVibrationValues(chladniParams[(frame / 60) % chladniParams.size()]);
+        sim.computeGradients();
+    }
+    double rebuildSeconds = secondsSince(start);
+
+    char line[256];
+    snprintf(line, sizeof(line), "frames %d  first pass %.2f ms/frame  cached blend %.2f ms/frame  "
+             "rebuild %.2f ms/frame", BLEND_FRAMES, passSeconds[0] * 1000.0 / BLEND_FRAMES,
+             passSeconds[1] * 1000.0 / BLEND_FRAMES, rebuildSeconds * 1000.0 / BLEND_FRAMES);
+    out << line << std::endl;
+}
+
+// Test recording for the audio benchmark: one second per pattern at its
+// resonant frequency with a weaker partial of the next pattern.
+static const int AUDIO_RATE = 44100;
+static const char* AUDIO_FILE = "chladni_audio_bench.wav";
+
+// Writes little-endian integers of the given byte count.
+static void writeLe(std::ofstream& file, unsigned int value, int bytes) {
+    for (int i = 0; i < bytes; ++i) file.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+// Writes a 16-bit stereo WAV with the test tones. Returns the duration in seconds.
+static int writeTestRecording(const char* filename) {
+    const int seconds = static_cast<int>(chladniParams.size());
+    const unsigned int frames = seconds * AUDIO_RATE;
+    std::ofstream file(filename, std::ios::binary);
+    file.write("RIFF", 4);
+    writeLe(file, 36 + frames * 4, 4);
+    file.write("WAVEfmt ", 8);
+    writeLe(file, 16, 4);
+    writeLe(file, 1, 2);                // PCM
+    writeLe(file, 2, 2);                // Stereo
+    writeLe(file, AUDIO_RATE, 4);
+    writeLe(file, AUDIO_RATE * 4, 4);
+    writeLe(file, 4, 2);
+    writeLe(file, 16, 2);
+    file.write("data", 4);
+    writeLe(file, frames * 4, 4);
+
+    for (unsigned int i = 0; i < frames; ++i) {
+        const int second = i / AUDIO_RATE;
+        const double t = static_cast<double>(i) / AUDIO_RATE;
+        const double f0 = calculateFrequency(chladniParams[second]);
+        const double f1 = calculateFrequency(chladniParams[(second + 1) % chladniParams.size()]);
+        const double value = 0.5 * std::sin(2.0 * PI * f0 * t) + 0.15 * std::sin(2.0 * PI * f1 * t);
+        const unsigned int sample = static_cast<unsigned short>(static_cast<short>(value * 32767.0));
+        writeLe(file, sample, 2);
+        writeLe(file, sample, 2);
+    }
+    return seconds;
+}
+
+// Drives the pattern blend from a test recording as fast as possible and
+// reports which pattern dominates at the end of each tone.
+static void benchmarkAudio(std::ostream& out) {
+    const int seconds = writeTestRecording(AUDIO_FILE);
+
+    Simulation sim;
+    sim.width = BENCH_WIDTH;
+    sim.height = BENCH_HEIGHT;
+    Simulation patternSim;
+    patternSim.width = sim.width;
+    patternSim.height = sim.height;
+    ModeBlender blender;
+    blender.reset([&](int pattern, std::vector<float>& field) {
+        patternSim.computeVibrationValues(chladniParams[pattern]);
+        field.swap(patternSim.vibrationValues);
+    }, static_cast<int>(chladniParams.size()), 0);
+
+    AudioExcitation audio;
+    std::string error;
+    if (!audio.open(AUDIO_FILE, error)) {
+        out << "Failed to open " << AUDIO_FILE << ": " << error << std::endl;
+        return;
+    }
+    std::vector<float> frequencies;
+    for (const ChladniParams& params : chladniParams) frequencies.push_back(calculateFrequency(params));
+    audio.setPatterns(frequencies);
+
+    out << "tone  expected  dominant  weight   peak Hz" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    long long composed = 0;
+    int correct = 0;
+    for (int second = 1; second <= seconds; ++second) {
+        // One compose per analysed block, as the app would do at that block's frame.
+        while (!audio.finished() && audio.position() < second) {
+            if (audio.advanceTo(audio.position() + 0.5 * audio.hopSize / AUDIO_RATE)) {
+                composed += blender.compose(sim, audio.weights());
+            }
+        }
+        const std::vector<float>& weights = audio.weights();
+        const int dominant = static_cast<int>(std::max_element(weights.begin(), weights.end()) - weights.begin());
+        correct += dominant == second - 1;
+
+        char line[256];
+        snprintf(line, sizeof(line), "%4d  %8d  %8d  %6.3f  %8.1f", second, second - 1, dominant,
+                 weights[dominant], audio.dominantFrequency);
+        out << line << std::endl;
+    }
+    const double elapsed = secondsSince(start);
+    std::remove(AUDIO_FILE);
+
+    char line[256];
+    snprintf(line, sizeof(line), "%d s of audio, %lld blocks (%.2f ms analysis), %lld fields composed, "
+             "%.2f s total, %.1fx real time, %d/%d tones matched",
+             seconds, audio.blocks, audio.analysisSeconds * 1000.0, composed, elapsed, seconds / elapsed,
+             correct, seconds);
+    out << line << std::endl;
+}
+
+// Largest mode order and number of random queries in the mode index benchmark.
+static const int INDEX_ORDER = 200;
+static const int INDEX_QUERIES = 1000000;
+
+// Compares nearest-mode lookups in the sorted index against a linear scan
+// and reports the degenerate groups.
+static void benchmarkModeIndex(std::ostream& out) {
+    ModeIndex index;
+    auto start = std::chrono::steady_clock::now();
+    index.build(INDEX_ORDER);
+    double buildSeconds = secondsSince(start);
+    const std::vector<IndexedMode>& modes = index.modes();
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> dis(0.0f, modes.back().frequency * 1.05f);
+    std::vector<float> targets(INDEX_QUERIES);
+    for (float& target : targets) target = dis(gen);
+
+    start = std::chrono::steady_clock::now();
+    long long indexSum = 0;
+    for (float target : targets) indexSum += index.nearest(target);
+    double indexSeconds = secondsSince(start);
+
+    // The scan sees far fewer queries; it is orders of magnitude slower.
+    const int scanQueries = INDEX_QUERIES / 1000;
+    start = std::chrono::steady_clock::now();
+    int mismatches = 0;
+    for (int q = 0; q < scanQueries; ++q) {
+        int best = 0;
+        for (size_t i = 1; i < modes.size(); ++i) {
+            if (std::abs(modes[i].frequency - targets[q]) < std::abs(modes[best].frequency - targets[q])) {
+                best = static_cast<int>(i);
+            }
+        }
+        const int found = index.nearest(targets[q]);
+        mismatches += std::abs(modes[found].frequency - targets[q]) != std::abs(modes[best].frequency - targets[q]);
+    }
+    double scanSeconds = secondsSince(start);
+
+    int groups = 0, largest = 0, largestAt = 0;
+    for (int i = 0; i < static_cast<int>(modes.size());) {
+        const std::pair<int, int> range = index.degenerate(i);
+        if (range.second - range.first > 1) ++groups;
+        if (range.second - range.first > largest) {
+            largest = range.second - range.first;
+            largestAt = range.first;
+        }
+        i = range.second;
+    }
+
+    char line[256];
+    snprintf(line, sizeof(line), "order %d: %d modes indexed in %.2f ms", INDEX_ORDER,
+             static_cast<int>(modes.size()), buildSeconds * 1000.0);
+    out << line << std::endl;
+    snprintf(line, sizeof(line), "index %.3g queries/s, linear scan %.3g queries/s, %d mismatches (checksum %lld)",
+             INDEX_QUERIES / indexSeconds, scanQueries / scanSeconds, mismatches, indexSum);
+    out << line << std::endl;
+    snprintf(line, sizeof(line), "%d degenerate groups, largest has %d modes at %.1f Hz:", groups, largest,
+             modes[largestAt].frequency);
+    out << line;
+    for (int i = largestAt; i < largestAt + largest; ++i) {
+        out << " (" << modes[i].m << "," << modes[i].n << ")";
+    }
+    out << std::endl;
+}
+
+// Largest mode sum and largest sum also evaluated with direct trigonometry.
+static const int SUPERPOSITION_MAX_MODES = 64;
+static const int SUPERPOSITION_MAX_DIRECT = 16;
+
+// Times weighted sums of K modes from the table bank against evaluating the
+// same sum with cosines per cell, and checks that they agree.
+static void benchmarkSuperposition(std::ostream& out) {
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> order(1, 20);
+    std::uniform_real_distribution<float> weight(-1.0f, 1.0f);
+    std::vector<ChladniParams> modes;
+    std::vector<float> weights;
+    while (static_cast<int>(modes.size()) < SUPERPOSITION_MAX_MODES) {
+        int m = order(gen), n = order(gen);
+        if (m == n) continue;
+        modes.push_back(ChladniParams(m, n, L2));
+        weights.push_back(weight(gen));
+    }
+
+    ModeSuperposition superposition;
+    superposition.resize(BENCH_WIDTH, BENCH_HEIGHT);
+    const double cells = static_cast<double>(BENCH_WIDTH) * BENCH_HEIGHT;
+    std::vector<float> field, direct(BENCH_WIDTH * BENCH_HEIGHT);
+
+    out << "modes  tables  first ms  table ms  ns/cell/mode  direct ms  max error" << std::endl;
+    for (int count = 1; count <= SUPERPOSITION_MAX_MODES; count *= 2) {
+        std::vector<ChladniParams> subset(modes.begin(), modes.begin() + count);
+        std::vector<float> subsetWeights(weights.begin(), weights.begin() + count);
+
+        // The first call also builds the tables of modes not seen before.
+        auto start = std::chrono::steady_clock::now();
+        superposition.evaluate(subset, subsetWeights, field);
+        double firstSeconds = secondsSince(start);
+        start = std::chrono::steady_clock::now();
+        superposition.evaluate(subset, subsetWeights, field);
+        double tableSeconds = secondsSince(start);
+
+        double directSeconds = 0, maxError = 0;
+        if (count <= SUPERPOSITION_MAX_DIRECT) {
+            float total = 0;
+            for (float w : subsetWeights) total += std::abs(w);
+            start = std::chrono::steady_clock::now();
+            for (int y = 0; y < BENCH_HEIGHT; ++y) {
+                for (int x = 0; x < BENCH_WIDTH; ++x) {
+                    float sum = 0;
+                    for (int k = 0; k < count; ++k) {
+                        const ChladniParams& p = subset[k];
+                        sum += subsetWeights[k] * 0.5f * (std::cos(p.n * (x * p.l)) * std::cos(p.m * (y * p.l)) -
+                                           std::cos(p.m * (x * p.l)) * std::cos(p.n * (y * p.l)));
+                    }
+                    direct[y * BENCH_WIDTH + x] = std::abs(sum) / total;
+                }
+            }
+            directSeconds = secondsSince(start);
+            for (size_t i = 0; i < direct.size(); ++i) {
+                maxError = std::max(maxError, static_cast<double>(std::abs(direct[i] - field[i])));
+            }
+        }
+
+        char line[256];
+        if (count <= SUPERPOSITION_MAX_DIRECT) {
+            snprintf(line, sizeof(line), "%5d  %6d  %8.2f  %8.2f  %12.3f  %9.1f  %9.2e", count,
+                     superposition.tableCount(), firstSeconds * 1000.0, tableSeconds * 1000.0,
+                     tableSeconds * 1e9 / (cells * count), directSeconds * 1000.0, maxError);
+        } else {
+            snprintf(line, sizeof(line), "%5d  %6d  %8.2f  %8.2f  %12.3f  %9s  %9s", count,
+                     superposition.tableCount(), firstSeconds * 1000.0, tableSeconds * 1000.0,
+                     tableSeconds * 1e9 / (cells * count), "-", "-");
+        }
+        out << line << std::endl;
+    }
+}
+
+// Frames stepped per configuration in the session benchmark.
+static const int SESSION_FRAMES = 30;
+
+// Steps many sessions of uneven size with 1, 2, 4, ... threads and reports
+// aggregate particle throughput, stealing and field sharing. At least four
+// threads run even on smaller machines so the stealing paths are exercised;
+// rows marked * have more threads than cores and measure only overhead.
+static void benchmarkSessions(std::ostream& out) {
+    const int hardware = std::max(1u, std::thread::hardware_concurrency());
+    const int maxThreads = std::max(hardware, 4);
+    out << "hardware threads: " << hardware << std::endl;
+    out << "threads  sessions  particles  Mparticles/s  speedup  steals/frame  fields  shared MB  unshared MB"
+        << std::endl;
+    for (int sessions = 1; sessions <= 32; sessions *= 4) {
+        double baseline = 0;
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            SessionManager manager(threads);
+            for (int i = 0; i < sessions; ++i) {
+                // Sizes vary four to one so that fixed assignment would leave workers idle.
+                const int id = manager.add(BENCH_WIDTH, BENCH_HEIGHT, 25000 * (1 + i % 4));
+                manager.setMode(id, chladniParams[i % chladniParams.size()]);
+            }
+            manager.step();   // Warm up the threads and caches.
+
+            auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < SESSION_FRAMES; ++frame) manager.step();
+            const double seconds = secondsSince(start);
+            const double rate = manager.particleCount() * SESSION_FRAMES / seconds;
+            if (threads == 1) baseline = rate;
+
+            const double fieldMb = BENCH_WIDTH * BENCH_HEIGHT * (sizeof(float) + sizeof(Gradient)) / 1e6;
+            const int fields = manager.cache.liveFields();
+            char line[256];
+            snprintf(line, sizeof(line), "%6d%c  %8d  %9lld  %12.1f  %7.2f  %12.1f  %6d  %9.1f  %11.1f",
+                     threads, threads > hardware ? '*' : ' ', sessions, manager.particleCount(), rate / 1e6, rate / baseline,
+                     static_cast<double>(manager.pool.steals) / (SESSION_FRAMES + 1), fields,
+                     fields * fieldMb, sessions * fieldMb);
+            out << line << std::endl;
+        }
+    }
+}
+
+// Requests per kind in the control benchmark.
+static const int CONTROL_REQUESTS = 2000;
+
+// Particles of the stand-in render thread, so snapshot copies cost what they would in a large run.
+static const int CONTROL_PARTICLES = 2000000;
+
+#ifndef _WIN32
+// Sends one line and waits for the one-line reply. Returns the round trip in seconds.
+static double roundTrip(int fd, const std::string& line, std::string& reply) {
+    auto start = std::chrono::steady_clock::now();
+    send(fd, line.data(), line.size(), 0);
+    reply.clear();
+    char c;
+    while (recv(fd, &c, 1, 0) == 1 && c != '\n') reply += c;
+    return secondsSince(start);
+}
+
+// Prints median, 99th percentile and worst of a list of round trips.
+static void printLatency(std::ostream& out, const char* name, std::vector<double>& times) {
+    std::sort(times.begin(), times.end());
+    char line[256];
+    snprintf(line, sizeof(line), "%-9s  %8d  %8.1f  %8.1f  %8.1f", name, static_cast<int>(times.size()),
+             times[times.size() / 2] * 1e6, times[times.size() * 99 / 100] * 1e6, times.back() * 1e6);
+    out << line << std::endl;
+}
+#endif
+
+// Drives a control server from a client while a stand-in render thread runs
+// 60 Hz frames, and reports round-trip latency and the time each frame spent
+// on commands.
+static void benchmarkControl(std::ostream& out) {
+#ifdef _WIN32
+    out << "Unix-domain sockets are not supported on this platform" << std::endl;
+#else
+    const std::string path = "/tmp/chladni_bench_" + std::to_string(getpid()) + ".sock";
+    ControlServer server;
+    std::string error;
+    if (!server.start(path, error)) {
+        out << "Failed to start control server: " << error << std::endl;
+        return;
+    }
+    server.metrics.patternCount.store(static_cast<int>(chladniParams.size()));
+
+    // Stand-in render thread: drains commands once per frame like main.
+    std::atomic<bool> done(false);
+    double worstFrameSeconds = 0;
+    long long frames = 0, spawned = 0;
+    std::vector<double> copyTimes;   // Render-thread time of each snapshot hand-over.
+    std::thread render([&] {
+        std::vector<Particle> particles(CONTROL_PARTICLES, Particle(1.0f, 2.0f));
+        while (!done) {
+            auto start = std::chrono::steady_clock::now();
+            Command command;
+            while (server.nextCommand(command)) {
+                if (command.type == CommandType::Spawn) spawned += command.count;
+                if (command.type == CommandType::Snapshot) {
+                    auto copyStart = std::chrono::steady_clock::now();
+                    server.completeSnapshot(command, particles);
+                    copyTimes.push_back(secondsSince(copyStart));
+                }
+            }
+            server.metrics.frame.store(++frames);
+            worstFrameSeconds = std::max(worstFrameSeconds, secondsSince(start));
+            std::this_thread::sleep_for(std::chrono::microseconds(16667));
+        }
+    });
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        out << "Failed to connect to " << path << std::endl;
+    } else {
+        std::string reply;
+        std::vector<double> metricsTimes, spawnTimes, snapshotTimes;
+        for (int i = 0; i < CONTROL_REQUESTS; ++i) metricsTimes.push_back(roundTrip(fd, "metrics\n", reply));
+        for (int i = 0; i < CONTROL_REQUESTS; ++i) spawnTimes.push_back(roundTrip(fd, "spawn 10 10 5\n", reply));
+        const std::string snapshotPath = path + ".bin";
+        for (int i = 0; i < 10; ++i) snapshotTimes.push_back(roundTrip(fd, "snapshot " + snapshotPath + "\n", reply));
+        std::remove(snapshotPath.c_str());
+
+        out << "request    count   p50 us   p99 us   max us" << std::endl;
+        printLatency(out, "metrics", metricsTimes);
+        printLatency(out, "spawn", spawnTimes);
+        printLatency(out, "snapshot", snapshotTimes);
+        out << "last snapshot reply: " << reply << std::endl;
+        close(fd);
+    }
+
+    done = true;
+    render.join();
+    server.stop();
+    char line[256];
+    snprintf(line, sizeof(line), "render frames %lld, particles spawned %lld, worst frame spent %.1f us on commands",
+             frames, spawned, worstFrameSeconds * 1e6);
+    out << line << std::endl;
+    if (!copyTimes.empty()) {
+        // The first hand-over allocates its buffer; later ones reuse a written snapshot's.
+        std::vector<double> reused(copyTimes.begin() + 1, copyTimes.end());
+        std::sort(reused.begin(), reused.end());
+        snprintf(line, sizeof(line), "snapshot hand-over of %d particles: first %.2f ms, later median %.2f ms",
+                 CONTROL_PARTICLES, copyTimes[0] * 1e3, reused.empty() ? 0.0 : reused[reused.size() / 2] * 1e3);
+        out << line << std::endl;
+    }
+#endif
+}
+
+// Frames per kind in the shared-memory benchmark.
+static const int SHM_FRAMES = 600;
+
+// Publishes particle and pixel frames into a shared-memory ring while a
+// reader thread follows the newest frame, and reports publish cost and how
+// many frames the reader saw torn.
+static void benchmarkSharedFrames(std::ostream& out) {
+    const std::string name = "chladni_bench_" + std::to_string(static_cast<long long>(
+        std::chrono::steady_clock::now().time_since_epoch().count() % 1000000));
+    std::vector<Particle> particles(100000, Particle(1.0f, 2.0f));
+    std::vector<unsigned char> image(1280 * 960 * 4, 128);
+
+    out << "kind        frames  payload MB  publish us   GB/s   read  torn  regrows" << std::endl;
+    for (int pass = 0; pass < 2; ++pass) {
+        const bool pixels = pass == 1;
+        SharedFrameWriter writer;
+        std::string error;
+        // Pixel frames start at a smaller window size to exercise growing the ring.
+        const size_t initialBytes = pixels ? 640 * 480 * 4 : particles.size() * 2 * sizeof(float);
+        if (!writer.open(name, pixels ? SharedFrameKind::Pixels : SharedFrameKind::Particles, initialBytes, error)) {
+            out << "Failed to open shared memory: " << error << std::endl;
+            return;
+        }
+
+        std::atomic<bool> done(false);
+        long long read = 0, torn = 0;
+        std::thread reader([&] {
+            SharedFrameReader ring;
+            std::string readerError;
+            if (!ring.open(name, readerError)) return;
+            uint64_t last = UINT64_MAX;
+            SharedFrameView view;
+            while (!done) {
+                if (!ring.latest(view, last)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                // Touch the payload in place, then confirm it was not overwritten meanwhile.
+                const unsigned char* bytes = static_cast<const unsigned char*>(view.data);
+                unsigned sum = 0;
+                for (size_t i = 0; i < view.bytes; i += 4096) sum += bytes[i];
+                (void)sum;
+                if (ring.stillValid(view)) {
+                    ++read;
+                    last = view.frame;
+                } else {
+                    ++torn;
+                }
+            }
+        });
+
+        const size_t bytes = pixels ? image.size() : particles.size() * 2 * sizeof(float);
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < SHM_FRAMES; ++frame) {
+            if (pixels) {
+                void* slot = writer.beginFrame(bytes, 1280, 960, frame);
+                if (slot) std::memcpy(slot, image.data(), bytes);
+                writer.endFrame();
+            } else {
+                writer.publishParticles(particles, 1280, 960, frame);
+            }
+            if (frame % 4 == 0) std::this_thread::yield();
+        }
+        const double seconds = secondsSince(start);
+        done = true;
+        reader.join();
+
+        char line[256];
+        snprintf(line, sizeof(line), "%-10s  %6lld  %10.2f  %10.1f  %5.2f  %5lld  %4lld  %7lld",
+                 pixels ? "pixels" : "particles", writer.framesPublished, bytes / 1e6, seconds / SHM_FRAMES * 1e6,
+                 bytes * static_cast<double>(SHM_FRAMES) / seconds / 1e9, read, torn, writer.regrows);
+        out << line << std::endl;
+    }
+}
+
+// Frames per format in the video benchmark.
+static const int VIDEO_FRAMES = 300;
+
+// Streams frames to /dev/null in both formats and reports what the render
+// thread pays per frame against the throughput of the whole pipeline.
+static void benchmarkVideo(std::ostream& out) {
+#ifdef _WIN32
+    const std::string sink = "NUL";
+#else
+    const std::string sink = "/dev/null";
+#endif
+    const int width = 1280, height = 960;
+    std::vector<uint8_t> image(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < image.size(); ++i) image[i] = static_cast<uint8_t>(i * 7);
+
+    out << "format   frames  written   submit us  wait max us    pipeline fps" << std::endl;
+    for (int pass = 0; pass < 2; ++pass) {
+        const VideoFormat format = pass == 0 ? VideoFormat::Y4m : VideoFormat::RawRgb;
+        VideoStreamer streamer;
+        std::string error;
+        if (!streamer.open(sink, format, width, height, 60, error)) {
+            out << "Failed to open " << sink << ": " << error << std::endl;
+            return;
+        }
+        // The copy stands in for glReadPixels.
+        double submitSeconds = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < VIDEO_FRAMES; ++frame) {
+            auto submitStart = std::chrono::steady_clock::now();
+            uint8_t* pixels = streamer.acquire(width, height);
+            if (pixels) std::memcpy(pixels, image.data(), image.size());
+            streamer.submit();
+            submitSeconds += secondsSince(submitStart);
+        }
+        streamer.close();
+        const double seconds = secondsSince(start);
+
+        char line[256];
+        snprintf(line, sizeof(line), "%-7s  %6lld  %7lld  %10.1f  %11.1f  %14.1f", pass == 0 ? "y4m" : "rgb24",
+                 streamer.framesSubmitted, streamer.framesWritten.load(), submitSeconds / VIDEO_FRAMES * 1e6,
+                 streamer.maxRenderWaitSeconds * 1e6, VIDEO_FRAMES / seconds);
+        out << line << std::endl;
+    }
+}
+
+// Size of the density frame in the PNG benchmark: 4K UHD.
+static const int PNG_WIDTH = 3840;
+static const int PNG_HEIGHT = 2160;
+
+// Encodes a 4K particle-density-like frame with lodepng's default settings,
+// the fast preset on one thread, and the fast preset on every thread, and
+// checks each PNG decodes back to the frame.
+static void benchmarkPng(std::ostream& out) {
+    // Particles gather on the nodal lines, so shade by closeness to them.
+    ModeSuperposition superposition;
+    superposition.resize(PNG_WIDTH, PNG_HEIGHT);
+    std::vector<float> field;
+    superposition.evaluate(std::vector<ChladniParams>(1, chladniParams[3]), std::vector<float>(1, 1.0f), field);
+    std::vector<uint8_t> image(static_cast<size_t>(PNG_WIDTH) * PNG_HEIGHT * 4);
+    for (size_t i = 0; i < field.size(); ++i) {
+        const uint8_t density = static_cast<uint8_t>(255.0f * std::exp(-12.0f * field[i]));
+        image[4 * i] = image[4 * i + 1] = image[4 * i + 2] = density;
+        image[4 * i + 3] = 255;
+    }
+    const double megabytes = image.size() / 1e6;
+
+    out << "encoder          threads   encode ms     MB/s   size MB  ratio  decodes" << std::endl;
+    for (int pass = 0; pass < 3; ++pass) {
+        const bool fast = pass > 0;
+#ifdef _OPENMP
+        const int threads = pass == 1 ? 1 : omp_get_max_threads();
+        const int previous = omp_get_max_threads();
+        omp_set_num_threads(threads);
+#else
+        const int threads = 1;
+#endif
+        std::vector<unsigned char> png;
+        std::string error;
+        auto start = std::chrono::steady_clock::now();
+        const bool encoded = encodePng(png, image, PNG_WIDTH, PNG_HEIGHT, fast, error);
+        const double seconds = secondsSince(start);
+#ifdef _OPENMP
+        omp_set_num_threads(previous);
+#endif
+        if (!encoded) {
+            out << "Encoding failed: " << error << std::endl;
+            return;
+        }
+
+        std::vector<unsigned char> decoded;
+        unsigned w = 0, h = 0;
+        const bool matches = lodepng::decode(decoded, w, h, png) == 0 && decoded == image;
+
+        char line[256];
+        snprintf(line, sizeof(line), "%-15s  %7d  %10.1f  %7.1f  %8.2f  %5.1f  %7s",
+                 pass == 0 ? "default" : "fast", threads, seconds * 1000.0, megabytes / seconds, png.size() / 1e6,
+                 image.size() / static_cast<double>(png.size()), matches ? "yes" : "NO");
+        out << line << std::endl;
+    }
+}
+
+// Side of the procedural field streamed by the EXR benchmark. Memory use
+// depends on the width only, so 32768 behaves the same, just slower.
+static const int EXR_STREAM_SIZE = 8192;
+
+// Round-trips the analytic field through a tiled EXR, then streams a large
+// procedural field and reports throughput and the memory held while writing.
+static void benchmarkExr(std::ostream& out) {
+    Simulation sim;
+    sim.width = BENCH_WIDTH;
+    sim.height = BENCH_HEIGHT;
+    sim.computeVibrationValues(chladniParams[3]);
+    sim.computeGradients();
+    const std::string filename = "chladni_bench_field.exr";
+
+    out << "field          tiles   raw MB  file MB  write ms    MB/s  buffered MB  round trip" << std::endl;
+    for (int pass = 0; pass < 2; ++pass) {
+        FieldExrWriter writer;
+        std::string error;
+        const int side = pass == 0 ? 0 : EXR_STREAM_SIZE;
+        auto start = std::chrono::steady_clock::now();
+        bool written;
+        if (pass == 0) {
+            written = writer.write(filename, sim, error);
+        } else {
+            // A field generated tile by tile; nothing of the full size exists in memory.
+            const float k = 12.0f * PI / side;
+            written = writer.write(filename, side, side, [k](int x0, int y0, int w, int h, float* vibration,
+                                                             float* dx, float* dy) {
+                for (int y = 0; y < h; ++y) {
+                    const float cy = std::cos((y0 + y) * k), sy = std::sin((y0 + y) * k);
+                    for (int x = 0; x < w; ++x) {
+                        const float cx = std::cos((x0 + x) * k * 1.5f), sx = std::sin((x0 + x) * k * 1.5f);
+                        const size_t i = static_cast<size_t>(y) * w + x;
+                        vibration[i] = std::abs(cx * cy);
+                        dx[i] = -1.5f * k * sx * cy;
+                        dy[i] = -k * cx * sy;
+                    }
+                }
+            }, error);
+        }
+        const double seconds = secondsSince(start);
+        if (!written) {
+            out << "Failed to write " << filename << ": " << error << std::endl;
+            return;
+        }
+
+        // Read the small field back and compare. Reading the large one would hold it all in memory.
+        ExrField field;
+        std::string check = "-";
+        if (pass == 0) check = readTiledExr(filename, field, error) ? "ok" : "read failed: " + error;
+        if (pass == 0 && check == "ok") {
+            const std::vector<float>* vibration = field.channel("vibration");
+            const std::vector<float>* dy = field.channel("dy");
+            for (int y = 0; y < sim.height && vibration && dy; ++y) {
+                for (int x = 0; x < sim.width; ++x) {
+                    const size_t exrIndex = static_cast<size_t>(y) * sim.width + x;
+                    const size_t simIndex = static_cast<size_t>(sim.height - 1 - y) * sim.width + x;
+                    if ((*vibration)[exrIndex] != sim.vibrationValues[simIndex] ||
+                        (*dy)[exrIndex] != sim.gradients[simIndex].dy) {
+                        check = "MISMATCH";
+                    }
+                }
+            }
+        }
+        std::remove(filename.c_str());
+
+        char line[256];
+        snprintf(line, sizeof(line), "%5dx%-5d  %6lld  %7.1f  %7.1f  %8.1f  %6.1f  %11.2f  %s",
+                 pass == 0 ? sim.width : side, pass == 0 ? sim.height : side, writer.tiles, writer.rawBytes / 1e6,
+                 writer.fileBytes / 1e6, seconds * 1000.0, writer.rawBytes / 1e6 / seconds,
+                 writer.peakBufferedBytes / 1e6, check.c_str());
+        out << line << std::endl;
+    }
+}
+
+// Side of the synthetic vibrometer scan, and the grids it is resampled onto.
+static const int SCAN_SIZE = 2048;
+static const int SCAN_TARGETS[][2] = {{640, 480}, {1920, 1080}, {4096, 4096}};
+
+// Displacement of the synthetic plate at (u, v) in [0, 1]^2, v pointing up.
+static float scanDisplacement(float u, float v) {
+    const float m = 3 * PI, n = 5 * PI;
+    return 0.5f * (std::cos(n * u) * std::cos(m * v) - std::cos(m * u) * std::cos(n * v));
+}
+
+// Writes a synthetic scan as a tiled EXR, a half-float scanline EXR and a
+// 16-bit PNG, loads each cold and from the cache, then resamples it with both
+// filters and compares against the exact field.
+static void benchmarkScan(std::ostream& out) {
+    // Image rows run top to bottom; the scan's y axis points up.
+    std::vector<float> displacement(static_cast<size_t>(SCAN_SIZE) * SCAN_SIZE);
+    for (int row = 0; row < SCAN_SIZE; ++row) {
+        const float v = (SCAN_SIZE - 1 - row + 0.5f) / SCAN_SIZE;
+        for (int x = 0; x < SCAN_SIZE; ++x) {
+            displacement[static_cast<size_t>(row) * SCAN_SIZE + x] = scanDisplacement((x + 0.5f) / SCAN_SIZE, v);
+        }
+    }
+    std::vector<float> magnitudes(displacement.size());
+    for (size_t i = 0; i < displacement.size(); ++i) magnitudes[i] = std::abs(displacement[i]);
+    std::nth_element(magnitudes.begin(), magnitudes.begin() + magnitudes.size() * 999 / 1000, magnitudes.end());
+    const float scale = magnitudes[magnitudes.size() * 999 / 1000];
+
+    const char* files[3] = {"chladni_bench_scan_tiled.exr", "chladni_bench_scan.exr", "chladni_bench_scan.png"};
+    std::string error;
+    FieldExrWriter writer;
+    bool written = writer.write(files[0], SCAN_SIZE, SCAN_SIZE, [&](int x0, int y0, int w, int h, float* vibration,
+                                                                    float* dx, float* dy) {
+        for (int y = 0; y < h; ++y) {
+            std::memcpy(vibration + static_cast<size_t>(y) * w,
+                        &displacement[static_cast<size_t>(y0 + y) * SCAN_SIZE + x0], w * sizeof(float));
+        }
+        std::fill(dx, dx + static_cast<size_t>(w) * h, 0.0f);
+        std::fill(dy, dy + static_cast<size_t>(w) * h, 0.0f);
+    }, error);
+
+    EXRImage image;
+    InitEXRImage(&image);
+    const char* channelNames[1] = {"Y"};
+    unsigned char* channelData[1] = {reinterpret_cast<unsigned char*>(displacement.data())};
+    int pixelTypes[1] = {TINYEXR_PIXELTYPE_FLOAT};
+    int storedTypes[1] = {TINYEXR_PIXELTYPE_HALF};
+    image.num_channels = 1;
+    image.channel_names = channelNames;
+    image.images = channelData;
+    image.pixel_types = pixelTypes;
+    image.requested_pixel_types = storedTypes;
+    image.width = SCAN_SIZE;
+    image.height = SCAN_SIZE;
+    const char* message = nullptr;
+    written = written && SaveMultiChannelEXRToFile(&image, files[1], &message) == 0;
+
+    std::vector<unsigned char> grey(displacement.size() * 2);
+    for (size_t i = 0; i < displacement.size(); ++i) {
+        const unsigned value = static_cast<unsigned>(std::min(1.0f, std::abs(displacement[i]) / scale) * 65535.0f + 0.5f);
+        grey[2 * i] = static_cast<unsigned char>(value >> 8);
+        grey[2 * i + 1] = static_cast<unsigned char>(value & 255);
+    }
+    written = written && lodepng::encode(files[2], grey, SCAN_SIZE, SCAN_SIZE, LCT_GREY, 16) == 0;
+    if (!written) {
+        out << "Failed to write the test scans" << std::endl;
+        return;
+    }
+
+    MeasuredFieldCache cache;
+    std::shared_ptr<const MeasuredScan> scans[3];
+    out << "scan file                       channel    cold ms  cached us  hits  misses" << std::endl;
+    for (int f = 0; f < 3; ++f) {
+        auto start = std::chrono::steady_clock::now();
+        scans[f] = cache.load(files[f], error);
+        const double coldSeconds = secondsSince(start);
+        if (!scans[f]) {
+            out << "Failed to load " << files[f] << ": " << error << std::endl;
+            return;
+        }
+        start = std::chrono::steady_clock::now();
+        const bool cached = cache.load(files[f], error) == scans[f];
+        const double cachedSeconds = secondsSince(start);
+
+        char line[256];
+        snprintf(line, sizeof(line), "%-30s  %-9s  %7.1f  %9.1f  %4lld  %6lld%s", files[f], scans[f]->channel.c_str(),
+                 coldSeconds * 1000.0, cachedSeconds * 1e6, cache.hits, cache.misses, cached ? "" : "  NOT CACHED");
+        out << line << std::endl;
+    }
+
+    // Rewriting a file must invalidate its entry.
+    lodepng::encode(files[2], grey, SCAN_SIZE, SCAN_SIZE, LCT_GREY, 16);
+    const bool reloaded = cache.load(files[2], error) != scans[2];
+    out << "rewritten PNG reloaded: " << (reloaded ? "yes" : "NO") << std::endl << std::endl;
+    for (const char* file : files) std::remove(file);
+
+    out << "filter     target       resample ms  rms error  max error" << std::endl;
+    for (const int* target : SCAN_TARGETS) {
+        const int width = target[0], height = target[1];
+        for (int pass = 0; pass < 2; ++pass) {
+            const ResampleFilter filter = pass == 0 ? ResampleFilter::Bilinear : ResampleFilter::Lanczos3;
+            std::vector<float> field;
+            auto start = std::chrono::steady_clock::now();
+            resampleScan(*scans[0], filter, field, width, height);
+            const double seconds = secondsSince(start);
+
+            // The exact field averaged over each target cell, which is what a
+            // resampled scan should approach.
+            const int sub = std::max(1, (SCAN_SIZE + width - 1) / width);
+            double squared = 0, worst = 0;
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    double expected = 0;
+                    for (int j = 0; j < sub; ++j) {
+                        for (int i = 0; i < sub; ++i) {
+                            const float u = (x + (i + 0.5f) / sub) / width, v = (y + (j + 0.5f) / sub) / height;
+                            expected += std::min(1.0f, std::abs(scanDisplacement(u, v)) / scale);
+                        }
+                    }
+                    const double difference = field[static_cast<size_t>(y) * width + x] - expected / (sub * sub);
+                    squared += difference * difference;
+                    worst = std::max(worst, std::abs(difference));
+                }
+            }
+
+            char line[256];
+            snprintf(line, sizeof(line), "%-9s  %4dx%-4d  %12.1f  %9.5f  %9.5f", pass == 0 ? "bilinear" : "lanczos3",
+                     width, height, seconds * 1000.0, std::sqrt(squared / (static_cast<double>(width) * height)), worst);
+            out << line << std::endl;
+        }
+    }
+}
+
+// Example run spec shipped with the scenes, relative to the working directory.
+static const char* SPEC_FILE = "../scene/chladni.json";
+static const int SPEC_GRID_WIDTH = 1920;
+static const int SPEC_GRID_HEIGHT = 1080;
+
+// Loads the example run spec, shows the plan for each precompute policy, and
+// times building the planned analytic fields one after another against one
+// per thread. Also shows the errors malformed specs produce.
+static void benchmarkSpec(std::ostream& out) {
+    RunSpec spec;
+    std::string error;
+    std::string filename = SPEC_FILE;
+    if (!loadRunSpec(filename, spec, error)) {
+        filename = filename.substr(3);
+        if (!loadRunSpec(filename, spec, error)) {
+            out << "Failed to load " << SPEC_FILE << ": " << error << std::endl;
+            return;
+        }
+    }
+    out << filename << ": " << spec.width << "x" << spec.height << ", " << spec.field << " field, "
+        << spec.modes.size() << " modes, " << spec.particleCount << " particles, seed " << spec.seed << std::endl;
+
+    const std::vector<ChladniParams> modes = spec.modes.empty() ? chladniParams : spec.modes;
+    const int patterns = static_cast<int>(modes.size());
+    FieldCost analytic = {true, false};
+    FieldCost solver = {false, true};
+    out << std::endl << "policy       source    resident MB  precompute           limit  parallel" << std::endl;
+    const PrecomputePolicy policies[] = {PrecomputePolicy::None, PrecomputePolicy::Start,
+                                         PrecomputePolicy::Neighbours, PrecomputePolicy::All};
+    for (PrecomputePolicy policy : policies) {
+        for (int source = 0; source < 2; ++source) {
+            RunSpec planned = spec;
+            planned.precompute = policy;
+            planned.residentMegabytes = 48;
+            const FieldPlan plan = planFields(planned, patterns, 9, SPEC_GRID_WIDTH, SPEC_GRID_HEIGHT,
+                                              source == 0 ? analytic : solver, false);
+            std::string list;
+            for (int pattern : plan.precompute) list += (list.empty() ? "" : ",") + std::to_string(pattern);
+            char line[256];
+            snprintf(line, sizeof(line), "%-11s  %-8s  %11d  %-19s  %5d  %8s", precomputePolicyName(policy),
+                     source == 0 ? "analytic" : "fdtd", planned.residentMegabytes, list.empty() ? "-" : list.c_str(),
+                     plan.residentLimit, plan.parallel ? "yes" : "no");
+            out << line << std::endl;
+        }
+    }
+
+    // Every pattern at a large grid, built one after another and then one per thread.
+    out << std::endl << "precompute   patterns  grid        ms" << std::endl;
+    std::vector<std::vector<float> > fields(patterns);
+    for (int pass = 0; pass < 2; ++pass) {
+        auto start = std::chrono::steady_clock::now();
+        #pragma omp parallel for schedule(dynamic) if (pass == 1)
+        for (int i = 0; i < patterns; ++i) {
+            Simulation scratch;
+            scratch.width = SPEC_GRID_WIDTH;
+            scratch.height = SPEC_GRID_HEIGHT;
+            scratch.computeVibrationValues(modes[i], 0.0f, 0.0f);
+            fields[i].swap(scratch.vibrationValues);
+        }
+        char line[256];
+        snprintf(line, sizeof(line), "%-11s  %8d  %4dx%-4d  %6.1f", pass == 0 ? "serial" : "parallel", patterns,
+                 SPEC_GRID_WIDTH, SPEC_GRID_HEIGHT, secondsSince(start) * 1000.0);
+        out << line << std::endl;
+    }
+
+    // Diagnostics for common mistakes.
+    const char* broken[] = {
+        "{\"chladni\": {\"grid\": {\"width\": 640, \"hieght\": 480}}}",
+        "{\"chladni\": {\"particles\": {\"count\": 2.5}}}",
+        "{\"chladni\": {\"field\": {\"source\": \"scan\"}}}",
+        "{\"chladni\": {\"seed\": 1,}}",
+    };
+    const std::string brokenFile = "chladni_bench_spec.json";
+    out << std::endl;
+    for (const char* text : broken) {
+        std::ofstream(brokenFile) << text;
+        RunSpec rejected;
+        out << (loadRunSpec(brokenFile, rejected, error) ? "ACCEPTED" : "rejected: " + error) << std::endl;
+    }
+    std::remove(brokenFile.c_str());
+}
+
+// Display refresh rates the real-time clock is driven at, and the stall it has to absorb.
+static const double CLOCK_REFRESH_RATES[] = {30.0, 60.0, 144.0};
+static const double CLOCK_SECONDS = 10.0;
+static const double CLOCK_STALL_SECONDS = 0.5;
+
+// Fast-forward run: particles stepped on an analytic field for a while, with a
+// fixed stand-in for drawing a frame without vsync.
+static const int CLOCK_PARTICLES = 20000;
+static const double CLOCK_RUN_SECONDS = 1.0;
+static const int CLOCK_RENDER_MS = 2;
+
+// Drives the real-time clock with simulated displays, one of them stalling
+// once, and checks the step rate is the same at every refresh rate. Then
+// runs fast-forward for real, drawing every Nth state, and reports steps per
+// second against drawing every state at a 60 Hz vsync.
+static void benchmarkClock(std::ostream& out) {
+    out << "refresh Hz  substeps  steps/s  frames/s  most steps/frame  after stall" << std::endl;
+    for (double refresh : CLOCK_REFRESH_RATES) {
+        for (int substeps = 1; substeps <= 4; substeps *= 4) {
+            SimClock clock;
+            clock.substeps = substeps;
+            int mostSteps = 0, stallSteps = 0;
+            const int frames = static_cast<int>(CLOCK_SECONDS * refresh);
+            double now = 0;
+            for (int frame = 0; frame <= frames; ++frame) {
+                const bool stall = frame == frames / 2;
+                if (stall) now += CLOCK_STALL_SECONDS;
+                clock.beginFrame(now, true);
+                int steps = 0;
+                while (clock.stepDue(now)) ++steps;
+                clock.renderDue();
+                if (stall) {
+                    stallSteps = steps;
+                } else {
+                    mostSteps = std::max(mostSteps, steps);
+                }
+                now += 1.0 / refresh;
+            }
+            char line[256];
+            snprintf(line, sizeof(line), "%10.0f  %8d  %7.1f  %8.1f  %16d  %11d", refresh, substeps,
+                     clock.steps / now, clock.renders / now, mostSteps, stallSteps);
+            out << line << std::endl;
+        }
+    }
+
+    Simulation sim;
+    sim.width = 640;
+    sim.height = 480;
+    sim.computeVibrationValues(ChladniParams(3, 5, L2), 0.0f, 0.0f);
+    sim.computeGradients();
+    std::shared_ptr<ModeField> field(new ModeField);
+    field->width = sim.width;
+    field->height = sim.height;
+    field->vibrationValues = sim.vibrationValues;
+    field->gradients = sim.gradients;
+
+    out << std::endl << "mode          draw every  steps/s  frames/s" << std::endl;
+    const int renderEvery[] = {1, 16, 0};
+    for (int run = -1; run < 3; ++run) {
+        PlateSession session(1, sim.width, sim.height, CLOCK_PARTICLES);
+        session.field = field;
+        SimClock clock;
+        if (run >= 0) {
+            clock.mode = ClockMode::FastForward;
+            clock.renderEvery = renderEvery[run];
+        }
+        auto start = std::chrono::steady_clock::now();
+        double now = 0;
+        while (now < CLOCK_RUN_SECONDS) {
+            clock.beginFrame(now, true);
+            while (clock.stepDue(secondsSince(start))) {
+                session.update(0, session.particles.size());
+                ++session.frame;
+            }
+            if (clock.renderDue()) {
+                // Real time waits for vsync after drawing; fast-forward swaps without it.
+                std::this_thread::sleep_for(std::chrono::milliseconds(CLOCK_RENDER_MS));
+                if (run < 0) std::this_thread::sleep_until(start + std::chrono::microseconds(
+                                 static_cast<long long>((clock.renders * 1e6) / 60.0)));
+            }
+            now = secondsSince(start);
+        }
+        char line[256];
+        snprintf(line, sizeof(line), "%-12s  %10s  %7.0f  %8.1f", clockModeName(clock.mode),
+                 run < 0 ? "1" : renderEvery[run] == 0 ? "never" : std::to_string(renderEvery[run]).c_str(),
+                 clock.steps / now, clock.renders / now);
+        out << line << std::endl;
+    }
+}
+
+// Modes the integrators settle particles on, and how settling is judged.
+static const ChladniParams INTEGRATOR_MODES[] = {ChladniParams(1, 4, L2), ChladniParams(3, 5, L2),
+                                                 ChladniParams(3, 7, L2)};
+static const int INTEGRATOR_PARTICLES = 30000;
+static const int INTEGRATOR_MAX_STEPS = 2000;
+static const float INTEGRATOR_NODAL_AMPLITUDE = 0.02f;   // Particles over smaller amplitudes sit on a nodal line.
+static const float INTEGRATOR_SETTLED_SHARE = 0.65f;     // A pattern has formed once this share of particles does.
+
+// Share of the particles sitting on a nodal line of the field.
+static float nodalShare(const PlateSession& session) {
+    const ModeField& field = *session.field;
+    int nodal = 0;
+    for (const Particle& p : session.particles) {
+        if (p.x < 0 || p.x >= field.width || p.y < 0 || p.y >= field.height) continue;
+        nodal += field.vibrationValues[static_cast<int>(p.y) * field.width + static_cast<int>(p.x)] <
+                 INTEGRATOR_NODAL_AMPLITUDE;
+    }
+    return static_cast<float>(nodal) / session.particles.size();
+}
+
+// Settles the same particles on several modes with the jitter walk and the
+// inertial integrator, and reports the steps each needs to form the pattern,
+// the nodal share they end at and the cost of a step.
+static void benchmarkIntegrator(std::ostream& out) {
+    out << "mode   integrator  share@100  share@400  share@2000  steps to " << INTEGRATOR_SETTLED_SHARE * 100
+        << "%  ns/particle" << std::endl;
+    for (const ChladniParams& mode : INTEGRATOR_MODES) {
+        Simulation sim;
+        sim.width = 640;
+        sim.height = 480;
+        sim.computeVibrationValues(mode, 0.0f, 0.0f);
+        sim.computeGradients();
+        std::shared_ptr<ModeField> field(new ModeField);
+        field->width = sim.width;
+        field->height = sim.height;
+        field->vibrationValues = sim.vibrationValues;
+        field->gradients = sim.gradients;
+
+        for (int kind = 0; kind < 2; ++kind) {
+            PlateSession session(7, sim.width, sim.height, INTEGRATOR_PARTICLES);
+            session.field = field;
+            session.integrator = kind == 0 ? IntegratorKind::Jitter : IntegratorKind::Inertial;
+            float shares[3] = {0, 0, 0};
+            int settledAt = -1;
+            double seconds = 0;
+            for (int step = 1; step <= INTEGRATOR_MAX_STEPS; ++step) {
+                auto start = std::chrono::steady_clock::now();
+                session.update(0, session.particles.size());
+                seconds += secondsSince(start);
+                ++session.frame;
+                if (settledAt < 0 || step == 100 || step == 400 || step == INTEGRATOR_MAX_STEPS) {
+                    const float share = nodalShare(session);
+                    if (settledAt < 0 && share >= INTEGRATOR_SETTLED_SHARE) settledAt = step;
+                    if (step == 100) shares[0] = share;
+                    if (step == 400) shares[1] = share;
+                    if (step == INTEGRATOR_MAX_STEPS) shares[2] = share;
+                }
+            }
+            char line[256];
+            snprintf(line, sizeof(line), "(%d,%d)  %-10s  %8.1f%%  %8.1f%%  %9.1f%%  %12s  %11.2f", mode.m, mode.n,
+                     integratorName(session.integrator), shares[0] * 100, shares[1] * 100, shares[2] * 100,
+                     settledAt < 0 ? "never" : std::to_string(settledAt).c_str(),
+                     seconds * 1e9 / (static_cast<double>(INTEGRATOR_MAX_STEPS) * INTEGRATOR_PARTICLES));
+            out << line << std::endl;
+        }
+    }
+}
+
+// Annealing runs: every built-in mode, each schedule of the jitter walk.
+static const int ANNEAL_PARTICLES = 20000;
+static const int ANNEAL_MAX_STEPS = 1000;
+static const int ANNEAL_CHECK_INTERVAL = 5;
+static const float ANNEAL_TARGET = 0.98f;   // Converged at this share of the fixed jitter's final nodal share.
+
+// Settles particles on every built-in mode with fixed, globally annealed and
+// locally annealed jitter. A run has converged once its nodal share reaches
+// ANNEAL_TARGET of the share the fixed jitter ends at, so all three race to
+// the same pattern quality; the final shares show how much sharper each gets.
+static void benchmarkAnneal(std::ostream& out) {
+    const AnnealMode modes[] = {AnnealMode::Fixed, AnnealMode::Global, AnnealMode::Local};
+    out << "mode        frames to converge      final nodal share" << std::endl
+        << "            fixed  global  local    fixed  global  local" << std::endl;
+    long long totals[3] = {0, 0, 0};
+    for (const ChladniParams& mode : chladniParams) {
+        Simulation sim;
+        sim.width = 640;
+        sim.height = 480;
+        sim.computeVibrationValues(mode, 0.0f, 0.0f);
+        sim.computeGradients();
+        std::shared_ptr<ModeField> field(new ModeField);
+        field->width = sim.width;
+        field->height = sim.height;
+        field->vibrationValues = sim.vibrationValues;
+        field->gradients = sim.gradients;
+
+        // Nodal share every ANNEAL_CHECK_INTERVAL steps, per schedule.
+        std::vector<float> shares[3];
+        for (int m = 0; m < 3; ++m) {
+            PlateSession session(11, sim.width, sim.height, ANNEAL_PARTICLES);
+            session.field = field;
+            session.schedule.mode = modes[m];
+            for (int step = 1; step <= ANNEAL_MAX_STEPS; ++step) {
+                session.update(0, session.particles.size());
+                ++session.frame;
+                if (step % ANNEAL_CHECK_INTERVAL == 0) shares[m].push_back(nodalShare(session));
+            }
+        }
+
+        const float target = ANNEAL_TARGET * shares[0].back();
+        int frames[3];
+        for (int m = 0; m < 3; ++m) {
+            size_t k = 0;
+            while (k < shares[m].size() && shares[m][k] < target) ++k;
+            frames[m] = k < shares[m].size() ? static_cast<int>(k + 1) * ANNEAL_CHECK_INTERVAL : ANNEAL_MAX_STEPS;
+            totals[m] += frames[m];
+        }
+        char line[256];
+        snprintf(line, sizeof(line), "(%d,%d,%.3f)  %5d  %6d  %5d   %5.1f%%  %5.1f%%  %5.1f%%", mode.m, mode.n, mode.l,
+                 frames[0], frames[1], frames[2], shares[0].back() * 100, shares[1].back() * 100,
+                 shares[2].back() * 100);
+        out << line << std::endl;
+    }
+    char line[256];
+    snprintf(line, sizeof(line), "total       %5lld  %6lld  %5lld", totals[0], totals[1], totals[2]);
+    out << line << std::endl;
+}
+
+// Builds timed per grid and particle count in the spatial grid benchmark, after one untimed build.
+static const int GRID_BUILDS = 5;
+
+// Times SpatialGrid::build with main's 1.5 px cells on window-sized and 4K
+// grids, from 100k to 10M uniformly scattered particles.
+static void benchmarkGrid(std::ostream& out) {
+    const int sizes[][2] = {{1920, 1080}, {3840, 2160}};
+    const int counts[] = {100000, 1000000, 10000000};
+    const float cellSize = 1.5f;
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    out << "threads: " << threads << std::endl;
+    out << "grid        cells      particles  build ms  Mparticles/s" << std::endl;
+    for (const auto& size : sizes) {
+        for (int count : counts) {
+            std::mt19937 gen(1);
+            std::uniform_real_distribution<float> x(0.0f, static_cast<float>(size[0]));
+            std::uniform_real_distribution<float> y(0.0f, static_cast<float>(size[1]));
+            std::vector<Particle> particles;
+            particles.reserve(count);
+            for (int i = 0; i < count; ++i) particles.push_back(Particle(x(gen), y(gen)));
+
+            SpatialGrid grid;
+            grid.build(particles, size[0], size[1], cellSize);
+            std::vector<double> times;
+            for (int i = 0; i < GRID_BUILDS; ++i) {
+                auto start = std::chrono::steady_clock::now();
+                grid.build(particles, size[0], size[1], cellSize);
+                times.push_back(secondsSince(start));
+            }
+            std::sort(times.begin(), times.end());
+            const double seconds = times[times.size() / 2];
+            char line[256];
+            snprintf(line, sizeof(line), "%4dx%-4d  %8d  %11d  %8.2f  %12.1f", size[0], size[1],
+                     grid.cols * grid.rows, count, seconds * 1e3, count / seconds / 1e6);
+            out << line << std::endl;
+        }
+    }
+}
+
+// Runs the named headless benchmark and prints its results.
+bool runBenchmark(const std::string& name, std::ostream& out) {
+    if (name == "fdtd") {
+        benchmarkFdtd(out);
+        return true;
+    }
+    if (name == "multigrid") {
+        benchmarkMultigrid(out);
+        return true;
+    }
+    if (name == "circular") {
+        benchmarkCircular(out);
+        return true;
+    }
+    if (name == "blend") {
+        benchmarkBlend(out);
+        return true;
+    }
+    if (name == "audio") {
+        benchmarkAudio(out);
+        return true;
+    }
+    if (name == "modeindex") {
+        benchmarkModeIndex(out);
+        return true;
+    }
+    if (name == "superposition") {
+        benchmarkSuperposition(out);
+        return true;
+    }
+    if (name == "sessions") {
+        benchmarkSessions(out);
+        return true;
+    }
+    if (name == "control") {
+        benchmarkControl(out);
+        return true;
+    }
+    if (name == "shm") {
+        benchmarkSharedFrames(out);
+        return true;
+    }
+    if (name == "video") {
+        benchmarkVideo(out);
+        return true;
+    }
+    if (name == "png") {
+        benchmarkPng(out);
+        return true;
+    }
+    if (name == "exr") {
+        benchmarkExr(out);
+        return true;
+    }
+    if (name == "scan") {
+        benchmarkScan(out);
+        return true;
+    }
+    if (name == "spec") {
+        benchmarkSpec(out);
+        return true;
+    }
+    if (name == "clock") {
+        benchmarkClock(out);
+        return true;
+    }
+    if (name == "integrator") {
+        benchmarkIntegrator(out);
+        return true;
+    }
+    if (name == "anneal") {
+        benchmarkAnneal(out);
+        return true;
+    }
+    if (name == "grid") {
+        benchmarkGrid(out);
+        return true;
+    }
+    return false;
+}
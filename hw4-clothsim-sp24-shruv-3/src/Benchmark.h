@@ -0,0 +1,11 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <ostream>
+#include <string>
+
+// Runs the named headless benchmark and prints its results.
+// Returns false if there is no benchmark with that name.
+bool runBenchmark(const std::string& name, std::ostream& out);
+
+#endif // BENCHMARK_H
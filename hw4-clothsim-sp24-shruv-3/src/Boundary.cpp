@@ -0,0 +1,65 @@
+#include "Boundary.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Returns a printable name for the policy.
+const char* boundaryPolicyName(BoundaryPolicy policy) {
+    switch (policy) {
+        case BoundaryPolicy::Kill: return "kill";
+        case BoundaryPolicy::Clamp: return "clamp";
+        case BoundaryPolicy::Reflect: return "reflect";
+        case BoundaryPolicy::Wrap: return "wrap";
+    }
+    return "unknown";
+}
+
+// Maps a coordinate back into [0,size) according to the policy.
+static float resolve(float v, float size, BoundaryPolicy policy) {
+    if (v >= 0 && v < size) return v;
+
+    // Largest float strictly below size.
+    const float upper = std::nextafter(size, 0.0f);
+    switch (policy) {
+        case BoundaryPolicy::Clamp:
+            return std::min(std::max(v, 0.0f), upper);
+        case BoundaryPolicy::Reflect:
+            v = v < 0 ? -v : 2 * size - v;
+            return std::min(std::max(v, 0.0f), upper);
+        case BoundaryPolicy::Wrap:
+            v = std::fmod(v, size);
+            if (v < 0) v += size;
+            return std::min(v, upper);
+        case BoundaryPolicy::Kill:
+            break;
+    }
+    return v;
+}
+
+// Applies the policy to every particle outside the window.
+void applyBoundary(std::vector<Particle>& particles, int width, int height, BoundaryPolicy policy) {
+    if (policy == BoundaryPolicy::Kill) return;
+
+    const int numParticles = static_cast<int>(particles.size());
+    const float w = static_cast<float>(width);
+    const float h = static_cast<float>(height);
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < numParticles; ++i) {
+        Particle& p = particles[i];
+        p.x = resolve(p.x, w, policy);
+        p.y = resolve(p.y, h, policy);
+    }
+}
+
+// Applies the policy to a range of particles on the calling thread.
+void applyBoundary(Particle* begin, Particle* end, int width, int height, BoundaryPolicy policy) {
+    if (policy == BoundaryPolicy::Kill) return;
+
+    const float w = static_cast<float>(width);
+    const float h = static_cast<float>(height);
+    for (Particle* p = begin; p != end; ++p) {
+        p->x = resolve(p->x, w, policy);
+        p->y = resolve(p->y, h, policy);
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef BOUNDARY_H
+#define BOUNDARY_H
+
+#include <vector>
+#include "Particle.h"
+
+// What happens to particles that move outside [0,width)x[0,height).
+enum class BoundaryPolicy {
+    Kill,     // Leave them outside; they are recycled or compacted away.
+    Clamp,    // Pin them to the nearest edge.
+    Reflect,  // Mirror them back across the edge they crossed.
+    Wrap      // Bring them in through the opposite edge.
+};
+
+// Returns a printable name for the policy.
+const char* boundaryPolicyName(BoundaryPolicy policy);
+
+// Applies the policy to every particle outside the window.
+void applyBoundary(std::vector<Particle>& particles, int width, int height, BoundaryPolicy policy);
+
+// Applies the policy to a range of particles on the calling thread, for
+// callers that already run in parallel.
+void applyBoundary(Particle* begin, Particle* end, int width, int height, BoundaryPolicy policy);
+
+#endif // BOUNDARY_H
@@ -0,0 +1,62 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Blocking queue of limited size between pipeline stages. push waits while
+// the queue is full and pop waits while it is empty, so a slow stage holds
+// back the stages before it instead of losing items.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity = 1) : capacity(capacity) {}
+
+    // Waits for room. Returns false if the queue was closed.
+    bool push(const T& value) {
+        std::unique_lock<std::mutex> guard(lock);
+        notFull.wait(guard, [this] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(value);
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Waits for an item. Returns false once the queue is closed and drained.
+    bool pop(T& value) {
+        std::unique_lock<std::mutex> guard(lock);
+        notEmpty.wait(guard, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        value = items.front();
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Wakes every waiter; queued items can still be popped.
+    void close() {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    // Empties the queue and makes it usable again after close.
+    void reset(size_t newCapacity) {
+        std::lock_guard<std::mutex> guard(lock);
+        capacity = newCapacity;
+        closed = false;
+        items.clear();
+    }
+
+private:
+    size_t capacity;
+    std::mutex lock;
+    std::condition_variable notFull, notEmpty;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,172 @@
+#include "CircularPlate.h"
+
+#include <algorithm>
+#include <cmath>
+#include "Simulation.h"
+
+// List of circular plate modes, in rising frequency.
+std::vector<CircularMode> circularModes = {
+        {0, 1}, {1, 1}, {2, 1}, {0, 2}, {3, 1}, {1, 2}, {4, 1}, {2, 2}, {0, 3}, {5, 1},
+          {3, 2}, {6, 1}, {1, 3}, {4, 2}
+};
+
+// Bessel function of the first kind from its integral form,
+//   J_n(x) = 1/pi * integral over [0, pi] of cos(n t - x sin t) dt.
+// The integrand is smooth and periodic, so the trapezoid rule converges
+// geometrically once there are a few more points than x + n.
+static double besselJ(int n, double x) {
+    const int points = 32 + 2 * static_cast<int>(x + n);
+    double sum = 0.5 * (1.0 + std::cos(n * PI));
+    for (int k = 1; k < points; ++k) {
+        const double t = PI * k / points;
+        sum += std::cos(n * t - x * std::sin(t));
+    }
+    return sum / points;
+}
+
+// The s-th positive zero of J_n, bracketed by a scan and refined by bisection.
+static double besselZero(int n, int s) {
+    const double step = 0.05;
+    // J_n has no zeros below n, where it is too small for the scan to be reliable.
+    double a = std::max(step, static_cast<double>(n)), fa = besselJ(n, a);
+    int found = 0;
+    while (true) {
+        const double b = a + step;
+        const double fb = besselJ(n, b);
+        if ((fa < 0) != (fb < 0) && ++found == s) {
+            double lo = a, hi = b, flo = fa;
+            for (int i = 0; i < 50; ++i) {
+                const double mid = 0.5 * (lo + hi);
+                const double fm = besselJ(n, mid);
+                if ((fm < 0) == (flo < 0)) {
+                    lo = mid;
+                    flo = fm;
+                } else {
+                    hi = mid;
+                }
+            }
+            return 0.5 * (lo + hi);
+        }
+        a = b;
+        fa = fb;
+    }
+}
+
+// Returns the frequency in Hz of the mode on a steel disc inscribed in the square plate.
+float circularFrequency(const CircularMode& mode) {
+    const double thickness = PLATE_THICKNESS;
+    const double rigidity = PLATE_YOUNGS_MODULUS * thickness * thickness * thickness /
+                            (12.0 * (1.0 - PLATE_POISSON_RATIO * PLATE_POISSON_RATIO));
+    const double kappa = std::sqrt(rigidity / (PLATE_DENSITY * thickness));
+    const double k = besselZero(mode.n, mode.s) / (0.5 * PLATE_SIDE);
+    return static_cast<float>(kappa * k * k / (2.0 * PI));
+}
+
+// Fills table with J_n(k r) from the centre to the rim, normalised to a peak
+// of 1, with one spare entry for interpolation.
+static void fillRadialTable(const CircularMode& mode, int samples, std::vector<float>& table) {
+    const double zero = besselZero(mode.n, mode.s);
+    table.resize(samples + 2);
+    float peak = 0;
+    for (int i = 0; i <= samples; ++i) {
+        table[i] = static_cast<float>(besselJ(mode.n, zero * i / samples));
+        peak = std::max(peak, std::abs(table[i]));
+    }
+    table[samples + 1] = table[samples];
+    const float norm = peak > 0 ? 1.0f / peak : 0.0f;
+    for (float& v : table) v *= norm;
+}
+
+// Radial table of a mode, built on first use.
+const std::vector<float>& CircularPlate::radialTable(const CircularMode& mode) {
+    std::vector<float>& table = radialTables[std::make_pair(mode.n, mode.s)];
+    if (table.empty()) fillRadialTable(mode, radialSamples, table);
+    return table;
+}
+
+// cos(n theta) once around the circle, with one spare entry for interpolation.
+const std::vector<float>& CircularPlate::angularTable(int n) {
+    std::vector<float>& table = angularTables[n];
+    if (!table.empty()) return table;
+
+    table.resize(angularSamples + 2);
+    for (int i = 0; i <= angularSamples + 1; ++i) {
+        table[i] = static_cast<float>(std::cos(n * 2.0 * PI * i / angularSamples));
+    }
+    return table;
+}
+
+// Builds the tables of every mode up front, in parallel.
+void CircularPlate::precompute(const std::vector<CircularMode>& modes) {
+    // Create the map entries first so the parallel loop only fills them in.
+    std::vector<std::vector<float>*> slots;
+    std::vector<CircularMode> missing;
+    for (const CircularMode& mode : modes) {
+        std::vector<float>& table = radialTables[std::make_pair(mode.n, mode.s)];
+        if (table.empty() && std::find(slots.begin(), slots.end(), &table) == slots.end()) {
+            slots.push_back(&table);
+            missing.push_back(mode);
+        }
+        angularTable(mode.n);
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int m = 0; m < static_cast<int>(missing.size()); ++m) {
+        fillRadialTable(missing[m], radialSamples, *slots[m]);
+    }
+}
+
+// Caches every pixel's radial and angular table position for this grid size.
+void CircularPlate::updateGeometry(int width, int height) {
+    if (width == geometryWidth && height == geometryHeight) return;
+    geometryWidth = width;
+    geometryHeight = height;
+
+    const size_t cells = static_cast<size_t>(width) * height;
+    radialPosition.resize(cells);
+    angularPosition.resize(cells);
+    const float cx = 0.5f * width, cy = 0.5f * height;
+    const float radius = 0.5f * std::min(width, height);
+    const float radialScale = radialSamples / radius;
+    const float angularScale = static_cast<float>(angularSamples / (2.0 * PI));
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const float dx = x + 0.5f - cx, dy = y + 0.5f - cy;
+            const float r = std::sqrt(dx * dx + dy * dy);
+            float theta = std::atan2(dy, dx);
+            if (theta < 0) theta += static_cast<float>(2.0 * PI);
+            const size_t k = static_cast<size_t>(y) * width + x;
+            radialPosition[k] = r <= radius ? r * radialScale : -1.0f;
+            angularPosition[k] = std::min(theta * angularScale, static_cast<float>(angularSamples));
+        }
+    }
+}
+
+// Fills out with |J_n(k r) cos(n theta)| normalised to [0, 1].
+void CircularPlate::sampleMode(const CircularMode& mode, std::vector<float>& out, int width, int height) {
+    updateGeometry(width, height);
+    const float* radial = radialTable(mode).data();
+    const float* angular = angularTable(mode.n).data();
+    const float* rPos = radialPosition.data();
+    const float* aPos = angularPosition.data();
+    out.resize(static_cast<size_t>(width) * height);
+    float* field = out.data();
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        const size_t row = static_cast<size_t>(y) * width;
+        #pragma omp simd
+        for (int x = 0; x < width; ++x) {
+            const size_t k = row + x;
+            const float rp = std::max(rPos[k], 0.0f);
+            const int ri = static_cast<int>(rp);
+            const float rv = radial[ri] + (radial[ri + 1] - radial[ri]) * (rp - ri);
+            const float ap = aPos[k];
+            const int ai = static_cast<int>(ap);
+            const float av = angular[ai] + (angular[ai + 1] - angular[ai]) * (ap - ai);
+            field[k] = rPos[k] < 0 ? 1.0f : std::abs(rv * av);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef CIRCULARPLATE_H
+#define CIRCULARPLATE_H
+
+#include <map>
+#include <utility>
+#include <vector>
+
+// Mode of a circular plate: n nodal diameters and the s-th zero of J_n on the rim.
+struct CircularMode {
+    int n, s;
+    CircularMode(int n, int s) : n(n), s(s) {}
+};
+
+// List of circular plate modes, in rising frequency.
+extern std::vector<CircularMode> circularModes;
+
+// Returns the frequency in Hz of the mode on a steel disc inscribed in the square plate.
+float circularFrequency(const CircularMode& mode);
+
+// Field engine for circular plates.
+// A mode is J_n(k r) * cos(n theta) with k chosen so the rim is a nodal circle.
+// Bessel values come from a radial table per mode and cos(n theta) from an
+// angular table per n, both built once. Each pixel's table positions depend
+// only on the window size and are cached too, so building a field is two
+// interpolated lookups per pixel, no more than the square cos*cos field.
+class CircularPlate {
+public:
+    int radialSamples = 4096;   // Table entries from the centre to the rim.
+    int angularSamples = 4096;  // Table entries around the circle.
+
+    // Builds the tables of every mode up front, in parallel.
+    void precompute(const std::vector<CircularMode>& modes);
+
+    // Fills out with |J_n(k r) cos(n theta)| normalised to [0, 1] on the disc
+    // inscribed in a width x height grid. Cells off the disc are set to 1 so
+    // particles are pushed off them.
+    void sampleMode(const CircularMode& mode, std::vector<float>& out, int width, int height);
+
+private:
+    const std::vector<float>& radialTable(const CircularMode& mode);
+    const std::vector<float>& angularTable(int n);
+    void updateGeometry(int width, int height);
+
+    std::map<std::pair<int, int>, std::vector<float> > radialTables; // Keyed by (n, s), normalised to a peak of 1.
+    std::map<int, std::vector<float> > angularTables;                 // Keyed by n.
+
+    // Table positions of every pixel for the current grid size.
+    int geometryWidth = 0, geometryHeight = 0;
+    std::vector<float> radialPosition;   // Negative off the disc.
+    std::vector<float> angularPosition;
+};
+
+#endif // CIRCULARPLATE_H
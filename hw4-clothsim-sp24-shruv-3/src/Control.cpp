@@ -0,0 +1,290 @@
+#include "Control.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Queue depths. Commands are drained every frame, so these only need to absorb bursts.
+static const size_t COMMAND_QUEUE_SIZE = 1024;
+static const size_t SNAPSHOT_QUEUE_SIZE = 16;
+
+// Snapshot buffers kept for reuse; more would hold memory for bursts that rarely come.
+static const size_t SPARE_SNAPSHOT_BUFFERS = 2;
+
+ControlServer::ControlServer()
+    : commands(COMMAND_QUEUE_SIZE), snapshots(SNAPSHOT_QUEUE_SIZE), spareBuffers(SPARE_SNAPSHOT_BUFFERS) {}
+
+ControlServer::~ControlServer() {
+    stop();
+}
+
+// Render thread: takes the next command.
+bool ControlServer::nextCommand(Command& command) {
+    return commands.pop(command);
+}
+
+// Render thread: hands a copy of the particles back for a Snapshot command.
+void ControlServer::completeSnapshot(const Command& command, const std::vector<Particle>& particles) {
+    Snapshot snapshot;
+    snapshot.client = command.client;
+    if (!spareBuffers.pop(snapshot.particles)) snapshot.particles = std::make_shared<std::vector<Particle> >();
+    snapshot.particles->assign(particles.begin(), particles.end());
+    std::memcpy(snapshot.path, command.path, sizeof(snapshot.path));
+    // Never full: the server refuses snapshots beyond the queue's size.
+    snapshots.push(snapshot);
+    wake();
+}
+
+#ifdef _WIN32
+
+bool ControlServer::start(const std::string& path, std::string& error) {
+    error = "Unix-domain sockets are not supported on this platform";
+    return false;
+}
+
+void ControlServer::stop() {}
+
+void ControlServer::wake() {}
+
+#else
+
+// Sends MSG_NOSIGNAL where available so a vanished client cannot kill the process.
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+static void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+// Listens on the socket path.
+bool ControlServer::start(const std::string& path, std::string& error) {
+    stop();
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        error = "socket path too long";
+        return false;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 16) < 0 ||
+        pipe(wakeFds) < 0) {
+        error = std::strerror(errno);
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    setNonBlocking(listenFd);
+    setNonBlocking(wakeFds[0]);
+    setNonBlocking(wakeFds[1]);
+
+    socketPath = path;
+    stopping = false;
+    thread = std::thread(&ControlServer::serve, this);
+    return true;
+}
+
+// Stops the server thread and closes every connection.
+void ControlServer::stop() {
+    if (!thread.joinable()) return;
+    stopping = true;
+    wake();
+    thread.join();
+    for (auto& entry : clientFds) close(entry.second);
+    clientFds.clear();
+    clients.clear();
+    close(listenFd);
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    listenFd = wakeFds[0] = wakeFds[1] = -1;
+    unlink(socketPath.c_str());
+}
+
+// Interrupts the server thread's poll.
+void ControlServer::wake() {
+    if (wakeFds[1] < 0) return;
+    const char byte = 0;
+    ssize_t written = write(wakeFds[1], &byte, 1);
+    (void)written;   // A full pipe already guarantees a wake-up.
+}
+
+// Writes finished snapshots and queues their replies.
+void ControlServer::writeSnapshots() {
+    Snapshot snapshot;
+    while (snapshots.pop(snapshot)) {
+        std::ofstream file(snapshot.path, std::ios::binary);
+        const std::vector<Particle>& particles = *snapshot.particles;
+        for (const Particle& p : particles) {
+            file.write(reinterpret_cast<const char*>(&p.x), sizeof(float));
+            file.write(reinterpret_cast<const char*>(&p.y), sizeof(float));
+        }
+        char reply[320];
+        if (file) {
+            snprintf(reply, sizeof(reply), "ok snapshot %d %s\n", static_cast<int>(particles.size()), snapshot.path);
+        } else {
+            snprintf(reply, sizeof(reply), "error cannot write %s\n", snapshot.path);
+        }
+        auto client = clients.find(snapshot.client);
+        if (client != clients.end()) client->second.output += reply;
+        --pendingSnapshots;
+        spareBuffers.push(snapshot.particles);   // Freed instead if both spares are taken.
+    }
+}
+
+// Parses text that is exactly a positive integer.
+static bool parsePositive(const std::string& text, int& value) {
+    std::istringstream in(text);
+    return in >> value && value > 0 && (in >> std::ws).eof();
+}
+
+// Parses one command line and answers it.
+void ControlServer::handleLine(int client, const std::string& line) {
+    std::istringstream in(line);
+    std::string name;
+    in >> name;
+    if (name.empty()) return;
+    ++commandsReceived;
+
+    Command command;
+    command.client = client;
+    std::string reply = "ok\n";
+    bool queue = true;
+    if (name == "ping") {
+        reply = "ok pong\n";
+        queue = false;
+    } else if (name == "metrics") {
+        char text[256];
+        snprintf(text, sizeof(text), "ok frame=%lld fps=%.1f particles=%lld pattern=%d patterns=%d frequency=%.2f running=%d\n",
+                 metrics.frame.load(), metrics.fps.load(), metrics.particles.load(), metrics.pattern.load(),
+                 metrics.patternCount.load(), metrics.frequency.load(), metrics.running.load() ? 1 : 0);
+        reply = text;
+        queue = false;
+    } else if (name == "mode") {
+        command.type = CommandType::SetMode;
+        if (!(in >> command.pattern) || command.pattern < 0 || command.pattern >= metrics.patternCount.load()) {
+            reply = "error mode out of range\n";
+            queue = false;
+        }
+    } else if (name == "spawn") {
+        command.type = CommandType::Spawn;
+        command.count = 500;
+        // A count, if given, must be a positive integer; a bad one would spawn nothing yet answer ok.
+        std::string count;
+        if (!(in >> command.x >> command.y) || ((in >> count) && !parsePositive(count, command.count))) {
+            reply = "error usage: spawn <x> <y> [count]\n";
+            queue = false;
+        }
+    } else if (name == "pause") {
+        command.type = CommandType::Pause;
+    } else if (name == "resume") {
+        command.type = CommandType::Resume;
+    } else if (name == "snapshot") {
+        command.type = CommandType::Snapshot;
+        std::string path;
+        if (!(in >> path) || path.size() >= sizeof(command.path)) {
+            reply = "error usage: snapshot <path>\n";
+            queue = false;
+        } else if (pendingSnapshots >= static_cast<int>(SNAPSHOT_QUEUE_SIZE)) {
+            reply = "error busy\n";
+            queue = false;
+        } else {
+            std::strcpy(command.path, path.c_str());
+            reply.clear();   // Answered once the file is written.
+        }
+    } else {
+        reply = "error unknown command " + name + "\n";
+        queue = false;
+    }
+
+    if (queue && !commands.push(command)) {
+        reply = "error busy\n";
+    } else if (queue && command.type == CommandType::Snapshot) {
+        ++pendingSnapshots;
+    }
+    if (reply.compare(0, 5, "error") == 0) ++commandsRejected;
+    clients[client].output += reply;
+}
+
+// Server thread: accepts connections and handles their lines until stopped.
+void ControlServer::serve() {
+    std::vector<pollfd> fds;
+    std::vector<int> ids;
+    char buffer[4096];
+    while (!stopping) {
+        fds.clear();
+        ids.clear();
+        fds.push_back(pollfd{wakeFds[0], POLLIN, 0});
+        fds.push_back(pollfd{listenFd, POLLIN, 0});
+        for (auto& entry : clientFds) {
+            const short events = POLLIN | (clients[entry.first].output.empty() ? 0 : POLLOUT);
+            fds.push_back(pollfd{entry.second, events, 0});
+            ids.push_back(entry.first);
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) continue;
+
+        if (fds[0].revents & POLLIN) {
+            while (read(wakeFds[0], buffer, sizeof(buffer)) > 0) {}
+            writeSnapshots();
+        }
+        if (fds[1].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listenFd, nullptr, nullptr)) >= 0) {
+                setNonBlocking(fd);
+                clientFds[nextClient] = fd;
+                clients[nextClient] = Client();
+                ++nextClient;
+            }
+        }
+
+        for (size_t i = 0; i < ids.size(); ++i) {
+            const int id = ids[i];
+            const int fd = fds[i + 2].fd;
+            Client& client = clients[id];
+            bool closed = (fds[i + 2].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+
+            if (fds[i + 2].revents & POLLIN) {
+                ssize_t got;
+                while ((got = recv(fd, buffer, sizeof(buffer), 0)) > 0) client.input.append(buffer, got);
+                if (got == 0) closed = true;
+                size_t start = 0, end;
+                while ((end = client.input.find('\n', start)) != std::string::npos) {
+                    handleLine(id, client.input.substr(start, end - start));
+                    start = end + 1;
+                }
+                client.input.erase(0, start);
+            }
+            // Answer straight away rather than waiting for the next POLLOUT round.
+            if (!client.output.empty()) {
+                const ssize_t sent = send(fd, client.output.data(), client.output.size(), SEND_FLAGS);
+                if (sent > 0) client.output.erase(0, sent);
+            }
+            if (closed) {
+                close(fd);
+                clientFds.erase(id);
+                clients.erase(id);
+            }
+        }
+    }
+}
+
+#endif
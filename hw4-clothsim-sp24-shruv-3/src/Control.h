@@ -0,0 +1,114 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Particle.h"
+#include "SpscQueue.h"
+
+// Commands the render thread carries out for the control server.
+enum class CommandType {
+    SetMode,    // Crossfade to pattern.
+    Spawn,      // Spawn count particles around (x, y).
+    Pause,
+    Resume,
+    Snapshot    // Copy the particles for the server to write to path.
+};
+
+struct Command {
+    CommandType type = CommandType::Pause;
+    int client = 0;         // Connection that sent it, for snapshot replies.
+    int pattern = 0;
+    float x = 0, y = 0;
+    int count = 0;
+    char path[256] = {0};
+};
+
+// State published by the render thread once per frame and read by the server
+// thread without locking, so metrics queries never wait for a frame.
+struct ControlMetrics {
+    std::atomic<long long> frame{0};
+    std::atomic<float> fps{0};
+    std::atomic<long long> particles{0};
+    std::atomic<int> pattern{0};
+    std::atomic<int> patternCount{0};
+    std::atomic<float> frequency{0};
+    std::atomic<bool> running{false};
+};
+
+// Line-based command protocol on a Unix-domain socket.
+// A server thread accepts connections, parses commands and answers each line
+// at once: metrics are read from ControlMetrics, other commands are validated,
+// pushed on a lock-free queue and acknowledged with "ok". The render thread
+// drains the queue between frames, so it never blocks on a socket. Snapshot
+// copies come back through a second queue and are written to disk by the
+// server thread, which then hands the copy's buffer back for reuse.
+// A full queue is answered with "error busy".
+//
+// Commands, one per line:
+//   ping                  -> ok pong
+//   metrics               -> ok frame=... fps=... particles=... pattern=... patterns=... frequency=... running=...
+//   mode <pattern>        -> ok
+//   spawn <x> <y> [count] -> ok
+//   pause | resume        -> ok
+//   snapshot <path>       -> ok snapshot <count> <path>, once the file is written as
+//                            raw little-endian float32 (x, y) pairs
+// Errors are answered with "error <reason>".
+class ControlServer {
+public:
+    ControlServer();
+    ~ControlServer();
+
+    // Listens on the socket path, replacing a stale socket file. Returns false
+    // and fills error on failure, or on platforms without Unix-domain sockets.
+    bool start(const std::string& path, std::string& error);
+    void stop();
+
+    // Render thread: takes the next command. Returns false if there is none.
+    bool nextCommand(Command& command);
+
+    // Render thread: hands a copy of the particles back for a Snapshot command.
+    // The copy goes into a buffer of an earlier snapshot, so after the first
+    // one it costs a memcpy and no allocation.
+    void completeSnapshot(const Command& command, const std::vector<Particle>& particles);
+
+    ControlMetrics metrics;
+
+    // Statistics.
+    std::atomic<long long> commandsReceived{0};
+    std::atomic<long long> commandsRejected{0};   // Malformed, out of range or queue full.
+
+private:
+    struct Client {
+        std::string input, output;
+    };
+    struct Snapshot {
+        int client = 0;
+        std::shared_ptr<std::vector<Particle> > particles;
+        char path[256] = {0};
+    };
+
+    void serve();
+    void handleLine(int client, const std::string& line);
+    void writeSnapshots();
+    void wake();
+
+    SpscQueue<Command> commands;
+    SpscQueue<Snapshot> snapshots;
+    SpscQueue<std::shared_ptr<std::vector<Particle> > > spareBuffers;   // Written snapshots, back to the render thread.
+    int pendingSnapshots = 0;    // Server thread: snapshots queued and not yet written.
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+    std::string socketPath;
+    int listenFd = -1;
+    int wakeFds[2] = {-1, -1};   // Self-pipe that interrupts poll for snapshots and stop.
+    std::map<int, int> clientFds; // Client id -> socket.
+    std::map<int, Client> clients;
+    int nextClient = 1;
+};
+
+#endif // CONTROL_H
@@ -0,0 +1,467 @@
+#include "FieldExr.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#define TINYEXR_IMPLEMENTATION
+#include "CGL/tinyexr.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// OpenEXR constants. Multi-byte values in the file are little-endian, as on every platform this builds on.
+static const unsigned char EXR_MAGIC[4] = {0x76, 0x2f, 0x31, 0x01};
+static const int EXR_TILED_FLAG = 0x200;
+static const unsigned char EXR_NO_COMPRESSION = 0;
+static const unsigned char EXR_ZIPS_COMPRESSION = 2;
+static const unsigned char EXR_ZIP_COMPRESSION = 3;
+static const int EXR_PIXEL_UINT = 0;
+static const int EXR_PIXEL_HALF = 1;
+static const int EXR_PIXEL_FLOAT = 2;
+
+// Channels as laid out in the file; EXR keeps them in alphabetical order.
+enum { CHANNEL_DX, CHANNEL_DY, CHANNEL_VIBRATION, CHANNEL_COUNT };
+static const char* const channelNames[CHANNEL_COUNT] = {"dx", "dy", "vibration"};
+
+template <typename T>
+static void append(std::vector<unsigned char>& out, T value) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// Moves to an absolute position in files past 2 GB.
+static bool seekTo(FILE* file, long long offset) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+// Compresses a block the way OpenEXR's ZIP compressor does, like tinyexr's
+// CompressZip but at a chosen deflate level. Returns the compressed size.
+static size_t deflateBlock(std::vector<unsigned char>& out, std::vector<unsigned char>& scratch,
+                           const std::vector<unsigned char>& raw, int level) {
+    // Split even and odd bytes, then store differences, so float exponents line up.
+    scratch.resize(raw.size());
+    const size_t half = (raw.size() + 1) / 2;
+    for (size_t i = 0; i < raw.size(); ++i) {
+        scratch[(i & 1) ? half + i / 2 : i / 2] = raw[i];
+    }
+    for (size_t i = scratch.size() - 1; i > 0; --i) {
+        scratch[i] = static_cast<unsigned char>(scratch[i] - scratch[i - 1] + 128);
+    }
+    miniz::mz_ulong length = miniz::mz_compressBound(static_cast<miniz::mz_ulong>(raw.size()));
+    out.resize(length);
+    if (miniz::mz_compress2(out.data(), &length, scratch.data(), static_cast<miniz::mz_ulong>(scratch.size()),
+                            level) != miniz::MZ_OK) {
+        return raw.size();
+    }
+    return length;
+}
+
+// Header of a tiled single-part file holding the three field channels.
+static std::vector<unsigned char> fieldHeader(int width, int height, int tileSize) {
+    std::vector<unsigned char> header(EXR_MAGIC, EXR_MAGIC + 4);
+    append<int>(header, 2 | EXR_TILED_FLAG);
+
+    std::vector<ChannelInfo> channels(CHANNEL_COUNT);
+    for (int c = 0; c < CHANNEL_COUNT; ++c) {
+        channels[c].name = channelNames[c];
+        channels[c].pixelType = EXR_PIXEL_FLOAT;
+        channels[c].pLinear = 0;
+        channels[c].xSampling = channels[c].ySampling = 1;
+    }
+    std::vector<unsigned char> data;
+    WriteChannelInfo(data, channels);
+    WriteAttributeToMemory(header, "channels", "chlist", data.data(), static_cast<int>(data.size()));
+    WriteAttributeToMemory(header, "compression", "compression", &EXR_ZIP_COMPRESSION, 1);
+
+    const int window[4] = {0, 0, width - 1, height - 1};
+    const unsigned char* windowBytes = reinterpret_cast<const unsigned char*>(window);
+    WriteAttributeToMemory(header, "dataWindow", "box2i", windowBytes, sizeof(window));
+    WriteAttributeToMemory(header, "displayWindow", "box2i", windowBytes, sizeof(window));
+
+    const unsigned char increasingY = 0;
+    WriteAttributeToMemory(header, "lineOrder", "lineOrder", &increasingY, 1);
+    const float aspect = 1.0f, center[2] = {0.0f, 0.0f};
+    WriteAttributeToMemory(header, "pixelAspectRatio", "float", reinterpret_cast<const unsigned char*>(&aspect), 4);
+    WriteAttributeToMemory(header, "screenWindowCenter", "v2f", reinterpret_cast<const unsigned char*>(center), 8);
+    WriteAttributeToMemory(header, "screenWindowWidth", "float", reinterpret_cast<const unsigned char*>(&aspect), 4);
+
+    // One level, rounding down: xSize, ySize, then mode.
+    std::vector<unsigned char> tiles;
+    append<unsigned>(tiles, tileSize);
+    append<unsigned>(tiles, tileSize);
+    tiles.push_back(0);
+    WriteAttributeToMemory(header, "tiles", "tiledesc", tiles.data(), static_cast<int>(tiles.size()));
+    header.push_back(0);
+    return header;
+}
+
+// Writes a width x height field pulled tile by tile from source.
+bool FieldExrWriter::write(const std::string& filename, int width, int height, const FieldTileSource& source,
+                           std::string& error) {
+    tiles = fileBytes = rawBytes = 0;
+    peakBufferedBytes = 0;
+    if (width <= 0 || height <= 0 || tileSize <= 0) {
+        error = "empty field";
+        return false;
+    }
+    FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        error = std::strerror(errno);
+        return false;
+    }
+
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+    const std::vector<unsigned char> header = fieldHeader(width, height, tileSize);
+    std::vector<unsigned long long> offsets(static_cast<size_t>(tilesX) * tilesY, 0);
+    bool ok = std::fwrite(header.data(), 1, header.size(), file) == header.size();
+    // The offset table is filled in once every tile's position is known.
+    ok = ok && std::fwrite(offsets.data(), sizeof(unsigned long long), offsets.size(), file) == offsets.size();
+    long long position = static_cast<long long>(header.size() + offsets.size() * sizeof(unsigned long long));
+
+    const size_t tileSamples = static_cast<size_t>(tileSize) * tileSize;
+    const size_t scratchBytes = tileSamples * CHANNEL_COUNT * sizeof(float) * 3;
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    std::vector<std::vector<unsigned char> > chunks(tilesX);
+
+    for (int ty = 0; ty < tilesY && ok; ++ty) {
+        #pragma omp parallel
+        {
+            std::vector<float> samples[CHANNEL_COUNT];
+            std::vector<unsigned char> raw, packed, scratch;
+
+            #pragma omp for schedule(dynamic)
+            for (int tx = 0; tx < tilesX; ++tx) {
+                const int x0 = tx * tileSize, y0 = ty * tileSize;
+                const int w = std::min(tileSize, width - x0), h = std::min(tileSize, height - y0);
+                for (int c = 0; c < CHANNEL_COUNT; ++c) samples[c].resize(static_cast<size_t>(w) * h);
+                source(x0, y0, w, h, samples[CHANNEL_VIBRATION].data(), samples[CHANNEL_DX].data(),
+                       samples[CHANNEL_DY].data());
+
+                // Within a tile each line holds every channel in turn.
+                const size_t lineBytes = static_cast<size_t>(w) * sizeof(float);
+                raw.resize(lineBytes * CHANNEL_COUNT * h);
+                for (int y = 0; y < h; ++y) {
+                    for (int c = 0; c < CHANNEL_COUNT; ++c) {
+                        std::memcpy(&raw[(static_cast<size_t>(y) * CHANNEL_COUNT + c) * lineBytes],
+                                    &samples[c][static_cast<size_t>(y) * w], lineBytes);
+                    }
+                }
+                const size_t packedSize = deflateBlock(packed, scratch, raw, compressionLevel);
+                // Blocks that do not shrink are stored as they are.
+                const bool compressed = packedSize < raw.size();
+                const unsigned char* data = compressed ? packed.data() : raw.data();
+                const int dataSize = static_cast<int>(compressed ? packedSize : raw.size());
+
+                std::vector<unsigned char>& chunk = chunks[tx];
+                chunk.clear();
+                append<int>(chunk, tx);
+                append<int>(chunk, ty);
+                append<int>(chunk, 0);
+                append<int>(chunk, 0);
+                append<int>(chunk, dataSize);
+                chunk.insert(chunk.end(), data, data + dataSize);
+            }
+        }
+
+        size_t buffered = scratchBytes * threads;
+        for (int tx = 0; tx < tilesX && ok; ++tx) {
+            const std::vector<unsigned char>& chunk = chunks[tx];
+            buffered += chunk.capacity();
+            offsets[static_cast<size_t>(ty) * tilesX + tx] = position;
+            ok = std::fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size();
+            position += static_cast<long long>(chunk.size());
+        }
+        peakBufferedBytes = std::max(peakBufferedBytes, buffered);
+    }
+    rawBytes = static_cast<long long>(width) * height * CHANNEL_COUNT * sizeof(float);
+
+    ok = ok && seekTo(file, static_cast<long long>(header.size()));
+    ok = ok && std::fwrite(offsets.data(), sizeof(unsigned long long), offsets.size(), file) == offsets.size();
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok) {
+        error = "cannot write " + filename;
+        return false;
+    }
+    tiles = static_cast<long long>(offsets.size());
+    fileBytes = position;
+    return true;
+}
+
+// Writes the simulation's current field and gradients, top row first as on screen.
+bool FieldExrWriter::write(const std::string& filename, const Simulation& sim, std::string& error) {
+    const size_t cells = static_cast<size_t>(sim.width) * sim.height;
+    if (sim.vibrationValues.size() != cells || sim.gradients.size() != cells) {
+        error = "field has not been computed";
+        return false;
+    }
+    FieldTileSource source = [&sim](int x0, int y0, int w, int h, float* vibration, float* dx, float* dy) {
+        for (int y = 0; y < h; ++y) {
+            // The simulation's rows run bottom to top.
+            const size_t row = static_cast<size_t>(sim.height - 1 - (y0 + y)) * sim.width + x0;
+            for (int x = 0; x < w; ++x) {
+                const size_t i = static_cast<size_t>(y) * w + x;
+                vibration[i] = sim.vibrationValues[row + x];
+                dx[i] = sim.gradients[row + x].dx;
+                dy[i] = sim.gradients[row + x].dy;
+            }
+        }
+    };
+    return write(filename, sim.width, sim.height, source, error);
+}
+
+// The named channel, or nullptr.
+const std::vector<float>* ExrField::channel(const std::string& name) const {
+    for (size_t c = 0; c < channelNames.size(); ++c) {
+        if (channelNames[c] == name) return &channels[c];
+    }
+    return nullptr;
+}
+
+// Bounds-checked reading of the header and chunks.
+struct ExrCursor {
+    const unsigned char* data;
+    size_t size, position;
+
+    bool string(std::string& out) {
+        const void* end = std::memchr(data + position, 0, size - position);
+        if (!end) return false;
+        const size_t length = static_cast<const unsigned char*>(end) - (data + position);
+        out.assign(reinterpret_cast<const char*>(data + position), length);
+        position += length + 1;
+        return true;
+    }
+
+    template <typename T>
+    bool value(T& out) {
+        if (size - position < sizeof(T)) return false;
+        std::memcpy(&out, data + position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+};
+
+// Float from an IEEE half.
+static float halfToFloat(unsigned short half) {
+    const unsigned sign = (half >> 15) & 1, exponent = (half >> 10) & 0x1f, mantissa = half & 0x3ff;
+    float value;
+    if (exponent == 0) {
+        value = std::ldexp(static_cast<float>(mantissa), -24);
+    } else if (exponent == 31) {
+        value = mantissa ? NAN : INFINITY;
+    } else {
+        value = std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+    }
+    return sign ? -value : value;
+}
+
+// Inflates a ZIP block and undoes the predictor and byte interleaving, as
+// tinyexr's DecompressZip does, but reports corrupt data instead of asserting.
+static bool inflateBlock(std::vector<unsigned char>& out, const unsigned char* data, size_t size) {
+    std::vector<unsigned char> buffer(out.size());
+    miniz::mz_ulong length = static_cast<miniz::mz_ulong>(buffer.size());
+    if (miniz::mz_uncompress(buffer.data(), &length, data, static_cast<miniz::mz_ulong>(size)) != miniz::MZ_OK ||
+        length != buffer.size()) {
+        return false;
+    }
+    for (size_t i = 1; i < buffer.size(); ++i) {
+        buffer[i] = static_cast<unsigned char>(buffer[i - 1] + buffer[i] - 128);
+    }
+    const size_t half = (buffer.size() + 1) / 2;
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        out[i] = (i & 1) ? buffer[half + i / 2] : buffer[i / 2];
+    }
+    return true;
+}
+
+// Reads a tiled, single-level EXR with float, half or uint channels.
+bool readTiledExr(const std::string& filename, ExrField& field, std::string& error) {
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in) {
+        error = "cannot open " + filename;
+        return false;
+    }
+    std::vector<unsigned char> file(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(file.data()), file.size())) {
+        error = "cannot read " + filename;
+        return false;
+    }
+    ExrCursor cursor = {file.data(), file.size(), 0};
+
+    int version = 0;
+    if (file.size() < 8 || std::memcmp(file.data(), EXR_MAGIC, 4) != 0) {
+        error = "not an OpenEXR file";
+        return false;
+    }
+    cursor.position = 4;
+    cursor.value(version);
+    if ((version & 0xff) != 2 || !(version & EXR_TILED_FLAG) || (version & ~(0xff | EXR_TILED_FLAG))) {
+        error = "not a single-part tiled OpenEXR file";
+        return false;
+    }
+
+    struct Channel {
+        std::string name;
+        int pixelType;
+    };
+    std::vector<Channel> channels;
+    int window[4] = {0, 0, -1, -1};
+    unsigned tileWidth = 0, tileHeight = 0;
+    unsigned char compression = 255, tileMode = 0;
+    for (;;) {
+        std::string name, type;
+        int size = 0;
+        if (!cursor.string(name)) {
+            error = "truncated header";
+            return false;
+        }
+        if (name.empty()) break;
+        if (!cursor.string(type) || !cursor.value(size) || size < 0 ||
+            static_cast<size_t>(size) > cursor.size - cursor.position) {
+            error = "truncated header";
+            return false;
+        }
+        ExrCursor attribute = {file.data(), cursor.position + size, cursor.position};
+        if (name == "channels") {
+            Channel channel;
+            while (attribute.string(channel.name) && !channel.name.empty()) {
+                int sampling[2];
+                unsigned char linearAndReserved[4];
+                if (!attribute.value(channel.pixelType) || !attribute.value(linearAndReserved) ||
+                    !attribute.value(sampling)) {
+                    break;
+                }
+                if (sampling[0] != 1 || sampling[1] != 1) {
+                    error = "subsampled channels are not supported";
+                    return false;
+                }
+                channels.push_back(channel);
+            }
+        } else if (name == "compression") {
+            attribute.value(compression);
+        } else if (name == "dataWindow") {
+            attribute.value(window);
+        } else if (name == "tiles") {
+            attribute.value(tileWidth);
+            attribute.value(tileHeight);
+            attribute.value(tileMode);
+        }
+        cursor.position += size;
+    }
+
+    const int width = window[2] - window[0] + 1, height = window[3] - window[1] + 1;
+    if (channels.empty() || width <= 0 || height <= 0 || tileWidth == 0 || tileHeight == 0) {
+        error = "missing channels, data window or tile description";
+        return false;
+    }
+    if ((tileMode & 0xf) != 0) {
+        error = "only single-level tiled files are supported";
+        return false;
+    }
+    if (compression != EXR_NO_COMPRESSION && compression != EXR_ZIPS_COMPRESSION &&
+        compression != EXR_ZIP_COMPRESSION) {
+        error = "only uncompressed and ZIP-compressed files are supported";
+        return false;
+    }
+    size_t pixelBytes = 0;
+    for (const Channel& channel : channels) {
+        if (channel.pixelType != EXR_PIXEL_UINT && channel.pixelType != EXR_PIXEL_HALF &&
+            channel.pixelType != EXR_PIXEL_FLOAT) {
+            error = "unknown pixel type";
+            return false;
+        }
+        pixelBytes += channel.pixelType == EXR_PIXEL_HALF ? 2 : 4;
+    }
+
+    const int tilesX = (width + tileWidth - 1) / tileWidth;
+    const int tilesY = (height + tileHeight - 1) / tileHeight;
+    const size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+    if ((file.size() - cursor.position) / sizeof(unsigned long long) < tileCount) {
+        error = "truncated offset table";
+        return false;
+    }
+    std::vector<unsigned long long> offsets(tileCount);
+    std::memcpy(offsets.data(), file.data() + cursor.position, tileCount * sizeof(unsigned long long));
+
+    field.width = width;
+    field.height = height;
+    field.channelNames.clear();
+    field.channels.assign(channels.size(), std::vector<float>(static_cast<size_t>(width) * height));
+    for (const Channel& channel : channels) field.channelNames.push_back(channel.name);
+
+    std::atomic<bool> ok(true);
+    #pragma omp parallel
+    {
+        std::vector<unsigned char> block;
+
+        #pragma omp for schedule(dynamic)
+        for (long t = 0; t < static_cast<long>(tileCount); ++t) {
+            if (!ok) continue;
+            ExrCursor chunk = {file.data(), file.size(), static_cast<size_t>(offsets[t])};
+            int header[5];
+            if (offsets[t] >= file.size() || !chunk.value(header) || header[0] < 0 || header[0] >= tilesX ||
+                header[1] < 0 || header[1] >= tilesY || header[4] < 0 ||
+                static_cast<size_t>(header[4]) > file.size() - chunk.position) {
+                ok = false;
+                continue;
+            }
+            const int x0 = header[0] * tileWidth, y0 = header[1] * tileHeight;
+            const int w = std::min<int>(tileWidth, width - x0), h = std::min<int>(tileHeight, height - y0);
+            block.resize(pixelBytes * w * h);
+            const unsigned char* data = file.data() + chunk.position;
+            if (static_cast<size_t>(header[4]) < block.size()) {
+                if (compression == EXR_NO_COMPRESSION || !inflateBlock(block, data, header[4])) {
+                    ok = false;
+                    continue;
+                }
+            } else if (static_cast<size_t>(header[4]) == block.size()) {
+                std::memcpy(block.data(), data, block.size());
+            } else {
+                ok = false;
+                continue;
+            }
+
+            const unsigned char* p = block.data();
+            for (int y = 0; y < h; ++y) {
+                for (size_t c = 0; c < channels.size(); ++c) {
+                    float* out = &field.channels[c][static_cast<size_t>(y0 + y) * width + x0];
+                    for (int x = 0; x < w; ++x) {
+                        if (channels[c].pixelType == EXR_PIXEL_FLOAT) {
+                            std::memcpy(&out[x], p, 4);
+                            p += 4;
+                        } else if (channels[c].pixelType == EXR_PIXEL_HALF) {
+                            unsigned short half;
+                            std::memcpy(&half, p, 2);
+                            out[x] = halfToFloat(half);
+                            p += 2;
+                        } else {
+                            unsigned value;
+                            std::memcpy(&value, p, 4);
+                            out[x] = static_cast<float>(value);
+                            p += 4;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (!ok) {
+        error = "corrupt tile in " + filename;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef FIELDEXR_H
+#define FIELDEXR_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "Simulation.h"
+
+// Fills the samples of one tile: pixels [x0, x0 + w) x [y0, y0 + h) in image
+// coordinates, row 0 at the top. Each channel receives w * h values, row by
+// row. Called from several threads at once for different tiles.
+typedef std::function<void(int x0, int y0, int w, int h, float* vibration, float* dx, float* dy)> FieldTileSource;
+
+// Writes vibration and gradient fields as the float channels vibration, dx
+// and dy of a tiled, ZIP-compressed OpenEXR file.
+// Tiles are produced and compressed one row of tiles at a time, in parallel
+// over the tiles of the row, and written in order. Only that row is ever
+// buffered, so the field behind the source is never copied as a whole and
+// fields far larger than memory can be written from a procedural source.
+// Deflate and the attribute encoding come from the bundled tinyexr.
+class FieldExrWriter {
+public:
+    // Writes a width x height field pulled tile by tile from source.
+    bool write(const std::string& filename, int width, int height, const FieldTileSource& source, std::string& error);
+
+    // Writes the simulation's current field and gradients, top row first as on screen.
+    bool write(const std::string& filename, const Simulation& sim, std::string& error);
+
+    int tileSize = 64;
+    int compressionLevel = 1;   // Deflate level, 1 (fast) to 9; float fields gain little from higher levels.
+
+    // Statistics of the last write.
+    long long tiles = 0;
+    long long fileBytes = 0;
+    long long rawBytes = 0;          // Uncompressed sample bytes.
+    size_t peakBufferedBytes = 0;    // Largest row of tiles held at once, raw and compressed.
+};
+
+// A field read back from an EXR file, channels in image order (row 0 at the top).
+struct ExrField {
+    int width = 0, height = 0;
+    std::vector<std::string> channelNames;
+    std::vector<std::vector<float> > channels;
+
+    // The named channel, or nullptr.
+    const std::vector<float>* channel(const std::string& name) const;
+};
+
+// Reads a tiled, single-level EXR with float channels, uncompressed or ZIP, as
+// FieldExrWriter writes them. Tiles are decompressed in parallel.
+bool readTiledExr(const std::string& filename, ExrField& field, std::string& error);
+
+#endif // FIELDEXR_H
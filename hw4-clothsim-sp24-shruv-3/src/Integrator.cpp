@@ -0,0 +1,88 @@
+#include "Integrator.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Particles per block of the inertial step; the block's arrays stay in L1.
+static const size_t INTEGRATOR_BLOCK = 256;
+
+// Returns a printable name for the integrator.
+const char* integratorName(IntegratorKind kind) {
+    return kind == IntegratorKind::Inertial ? "inertial" : "jitter";
+}
+
+// Returns a printable name for the anneal mode.
+const char* annealModeName(AnnealMode mode) {
+    switch (mode) {
+        case AnnealMode::Fixed: return "fixed";
+        case AnnealMode::Global: return "global";
+        case AnnealMode::Local: return "local";
+    }
+    return "fixed";
+}
+
+// Jitter shared by every particle, steps after the field last changed.
+float JitterSchedule::globalScale(long long steps) const {
+    if (mode != AnnealMode::Global) return 1.0f;
+    return std::max(floor, std::exp2(-static_cast<float>(steps) / halfLife));
+}
+
+// Moves particles [begin, end) one step by the positional random walk.
+void jitterStep(Particle* particles, size_t begin, size_t end, const Gradient* gradients, const float* amplitude,
+                int width, int height, float slowFactor, const JitterSchedule& schedule, float scale, uint32_t seed) {
+    const bool local = schedule.mode == AnnealMode::Local;
+    const float perAmplitude = 1.0f / schedule.fullAmplitude;
+    for (size_t i = begin; i < end; ++i) {
+        Particle& p = particles[i];
+        if (p.x < 0 || p.x >= width || p.y < 0 || p.y >= height) continue;
+        const int index = static_cast<int>(p.y) * width + static_cast<int>(p.x);
+        const Gradient& grad = gradients[index];
+        const uint32_t h = particleHash(seed ^ static_cast<uint32_t>(i) * 0x9e3779b9U);
+        const float jitter = local ? std::min(1.0f, std::max(schedule.floor, amplitude[index] * perAmplitude)) : scale;
+        p.x += grad.dx * slowFactor + hashJitter(h) * jitter;
+        p.y += grad.dy * slowFactor + hashJitter(particleHash(h)) * jitter;
+    }
+}
+
+// Moves particles [begin, end) one step with damped inertial motion.
+void InertialIntegrator::step(Particle* particles, ParticleVelocities& velocities, size_t begin, size_t end,
+                              const float* amplitude, const Gradient* gradients, int width, int height,
+                              uint32_t seed) const {
+    float forceX[INTEGRATOR_BLOCK], forceY[INTEGRATOR_BLOCK], live[INTEGRATOR_BLOCK];
+    float* vx = velocities.x.data();
+    float* vy = velocities.y.data();
+    const float damp = damping, limit = maxSpeed;
+
+    for (size_t blockBegin = begin; blockBegin < end; blockBegin += INTEGRATOR_BLOCK) {
+        const size_t count = std::min(INTEGRATOR_BLOCK, end - blockBegin);
+        Particle* p = particles + blockBegin;
+
+        // Gather: drift plus amplitude-scaled kick per particle; particles off the grid get live = 0 and stay put.
+        for (size_t k = 0; k < count; ++k) {
+            const float x = p[k].x, y = p[k].y;
+            if (x < 0 || x >= width || y < 0 || y >= height) {
+                forceX[k] = forceY[k] = live[k] = 0.0f;
+                continue;
+            }
+            const int index = static_cast<int>(y) * width + static_cast<int>(x);
+            const uint32_t h = particleHash(seed ^ static_cast<uint32_t>(blockBegin + k) * 0x9e3779b9U);
+            const float shake = kick * amplitude[index];
+            forceX[k] = gradients[index].dx * drift + hashJitter(h) * shake;
+            forceY[k] = gradients[index].dy * drift + hashJitter(particleHash(h)) * shake;
+            live[k] = 1.0f;
+        }
+
+        // Integrate: no branches or lookups, so this loop vectorizes.
+        float* bx = vx + blockBegin;
+        float* by = vy + blockBegin;
+        #pragma omp simd
+        for (size_t k = 0; k < count; ++k) {
+            const float nx = std::min(limit, std::max(-limit, bx[k] * damp + forceX[k]));
+            const float ny = std::min(limit, std::max(-limit, by[k] * damp + forceY[k]));
+            bx[k] = live[k] * nx + (1.0f - live[k]) * bx[k];
+            by[k] = live[k] * ny + (1.0f - live[k]) * by[k];
+            p[k].x += live[k] * nx;
+            p[k].y += live[k] * ny;
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Particle.h"
+#include "Simulation.h"
+
+// How particles move each step.
+enum class IntegratorKind {
+    Jitter,    // Positional random walk: a fraction of the gradient plus uniform jitter.
+    Inertial   // Damped velocity, pushed down the gradient and kicked by the local amplitude.
+};
+
+// Returns a printable name for the integrator, as written in a run spec.
+const char* integratorName(IntegratorKind kind);
+
+// How the jitter of the random walk shrinks as a pattern forms.
+enum class AnnealMode {
+    Fixed,    // Full jitter forever.
+    Global,   // Every particle's jitter decays with the steps since the field last changed.
+    Local     // Each particle's jitter follows the vibration amplitude under it.
+};
+
+// Returns a printable name for the anneal mode, as written in a run spec.
+const char* annealModeName(AnnealMode mode);
+
+// Annealing schedule of the random walk's jitter, as a share of the full
+// +-0.5 px. Constant jitter keeps shaking particles off the nodal lines they
+// reached, so patterns stay fuzzy; shrinking it lets them settle. Global
+// annealing cools the whole plate after each change of the field and heats
+// it again with the next change. Local annealing needs no clock: particles
+// over antinodes keep their full jitter and those on nodal lines almost none,
+// so newly spawned particles and new patterns are handled alike.
+struct JitterSchedule {
+    AnnealMode mode = AnnealMode::Fixed;
+    float halfLife = 40.0f;        // Global: steps in which the jitter halves.
+    float floor = 0.1f;            // Least jitter, so particles never freeze off a line.
+    float fullAmplitude = 0.25f;   // Local: amplitude from which the jitter is full.
+
+    // Jitter shared by every particle, steps after the field last changed.
+    // 1 unless the mode is Global.
+    float globalScale(long long steps) const;
+};
+
+// Hash of a 32-bit value with good avalanche, for per-particle random numbers
+// that need no shared generator.
+inline uint32_t particleHash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+// Uniform value in [-0.5, 0.5) from a hash.
+inline float hashJitter(uint32_t h) {
+    return (h >> 8) * (1.0f / 16777216.0f) - 0.5f;
+}
+
+// Moves particles [begin, end) one step by the random walk updateParticles
+// always used: slowFactor of the gradient plus jitter in [-0.5, 0.5) per axis,
+// scaled by scale, or for Local annealing by the amplitude under the particle.
+// The jitter of particle i comes from a hash of seed and i, so ranges may run
+// concurrently and a run is reproducible from its seeds. Particles outside
+// the width x height grid are left alone.
+void jitterStep(Particle* particles, size_t begin, size_t end, const Gradient* gradients, const float* amplitude,
+                int width, int height, float slowFactor, const JitterSchedule& schedule, float scale, uint32_t seed);
+
+// Damped inertial motion. Each step a particle's velocity keeps `damping` of
+// itself, gains `drift` along the gradient toward lower amplitude, and gets a
+// random kick scaled by the vibration amplitude under it. Sand on a real plate
+// is thrown about by the antinodes and comes to rest where the plate does not
+// move; here likewise a particle on a nodal line gets no kick and its
+// velocity dies away, while the random walk keeps jittering it off the line.
+// Momentum also carries particles across flat stretches where the gradient
+// step alone only diffuses.
+//
+// Steps run over blocks of particles: a gather pass reads the gradient and
+// amplitude under each particle and draws its random numbers, then a pass of
+// pure arithmetic over the block's arrays and the velocities updates the
+// particles, which the compiler vectorizes.
+class InertialIntegrator {
+public:
+    float damping = 0.8f;   // Share of the velocity kept per step.
+    float drift = 0.2f;     // Velocity gained per step along the gradient, in pixels.
+    float kick = 1.5f;      // Largest random velocity per step at full amplitude, in pixels.
+    float maxSpeed = 3.0f;  // Speed per axis is capped here, so a kick cannot carry a particle over a nodal line.
+
+    // Moves particles [begin, end) one step; velocities has an entry for each.
+    // Safe to call concurrently on disjoint ranges.
+    void step(Particle* particles, ParticleVelocities& velocities, size_t begin, size_t end, const float* amplitude,
+              const Gradient* gradients, int width, int height, uint32_t seed) const;
+};
+
+#endif // INTEGRATOR_H
@@ -0,0 +1,297 @@
+#include "Json.h"
+
+#include <cmath>
+#include <fstream>
+#include <locale>
+#include <sstream>
+
+// Nesting depth at which parsing gives up, so hostile files cannot exhaust the stack.
+static const int MAX_DEPTH = 256;
+
+// The member with the given key, or nullptr.
+const JsonValue* JsonValue::find(const std::string& key) const {
+    if (type != Type::Object) return nullptr;
+    for (const auto& member : members) {
+        if (member.first == key) return &member.second;
+    }
+    return nullptr;
+}
+
+// True for numbers without a fractional part that fit an int.
+bool JsonValue::isInteger() const {
+    return type == Type::Number && std::floor(number) == number && std::abs(number) <= 2147483647.0;
+}
+
+// Recursive-descent parser over the whole text.
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : text(text) {}
+
+    bool parse(JsonValue& value, std::string& error) {
+        bool ok = skipSpace() && parseValue(value, 0) && skipSpace();
+        if (ok && position != text.size()) ok = fail("unexpected text after the document");
+        if (!ok) error = message;
+        return ok;
+    }
+
+private:
+    const std::string& text;
+    size_t position = 0;
+    std::string message;
+
+    // Records an error at the current position; always returns false.
+    bool fail(const std::string& what) {
+        int line = 1, column = 1;
+        for (size_t i = 0; i < position && i < text.size(); ++i) {
+            if (text[i] == '\n') {
+                ++line;
+                column = 1;
+            } else {
+                ++column;
+            }
+        }
+        std::ostringstream out;
+        out << "line " << line << ", column " << column << ": " << what;
+        message = out.str();
+        return false;
+    }
+
+    // Skips whitespace and comments. Fails on an unterminated block comment.
+    bool skipSpace() {
+        while (position < text.size()) {
+            const char c = text[position];
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                ++position;
+            } else if (text.compare(position, 2, "//") == 0) {
+                while (position < text.size() && text[position] != '\n') ++position;
+            } else if (text.compare(position, 2, "/*") == 0) {
+                const size_t end = text.find("*/", position + 2);
+                if (end == std::string::npos) return fail("unterminated comment");
+                position = end + 2;
+            } else {
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool literal(const char* word, size_t length) {
+        if (text.compare(position, length, word) != 0) return fail("invalid literal");
+        position += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value, int depth) {
+        if (depth > MAX_DEPTH) return fail("nesting too deep");
+        if (position >= text.size()) return fail("unexpected end of input");
+        switch (text[position]) {
+            case '{':
+                return parseObject(value, depth);
+            case '[':
+                return parseArray(value, depth);
+            case '"':
+                value.type = JsonValue::Type::String;
+                return parseString(value.string);
+            case 't':
+                value.type = JsonValue::Type::Bool;
+                value.boolean = true;
+                return literal("true", 4);
+            case 'f':
+                value.type = JsonValue::Type::Bool;
+                value.boolean = false;
+                return literal("false", 5);
+            case 'n':
+                value.type = JsonValue::Type::Null;
+                return literal("null", 4);
+            default:
+                return parseNumber(value);
+        }
+    }
+
+    bool parseObject(JsonValue& value, int depth) {
+        value.type = JsonValue::Type::Object;
+        ++position;
+        if (!skipSpace()) return false;
+        if (position < text.size() && text[position] == '}') {
+            ++position;
+            return true;
+        }
+        for (;;) {
+            if (position >= text.size() || text[position] != '"') return fail("expected a member name");
+            std::string key;
+            if (!parseString(key)) return false;
+            if (value.find(key)) return fail("duplicate member \"" + key + "\"");
+            if (!skipSpace()) return false;
+            if (position >= text.size() || text[position] != ':') return fail("expected ':'");
+            ++position;
+            value.members.push_back(std::make_pair(key, JsonValue()));
+            if (!skipSpace() || !parseValue(value.members.back().second, depth + 1) || !skipSpace()) return false;
+            if (position < text.size() && text[position] == ',') {
+                ++position;
+                if (!skipSpace()) return false;
+                continue;
+            }
+            if (position < text.size() && text[position] == '}') {
+                ++position;
+                return true;
+            }
+            return fail("expected ',' or '}'");
+        }
+    }
+
+    bool parseArray(JsonValue& value, int depth) {
+        value.type = JsonValue::Type::Array;
+        ++position;
+        if (!skipSpace()) return false;
+        if (position < text.size() && text[position] == ']') {
+            ++position;
+            return true;
+        }
+        for (;;) {
+            value.items.push_back(JsonValue());
+            if (!parseValue(value.items.back(), depth + 1) || !skipSpace()) return false;
+            if (position < text.size() && text[position] == ',') {
+                ++position;
+                if (!skipSpace()) return false;
+                continue;
+            }
+            if (position < text.size() && text[position] == ']') {
+                ++position;
+                return true;
+            }
+            return fail("expected ',' or ']'");
+        }
+    }
+
+    // Four hex digits of a \u escape.
+    bool hex4(unsigned& code) {
+        if (position + 4 > text.size()) return fail("truncated \\u escape");
+        code = 0;
+        for (int i = 0; i < 4; ++i) {
+            const char c = text[position++];
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return fail("invalid \\u escape");
+        }
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, unsigned code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xc0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xe0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+            out += static_cast<char>(0xf0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        }
+    }
+
+    bool parseString(std::string& out) {
+        ++position;
+        out.clear();
+        while (position < text.size()) {
+            const char c = text[position++];
+            if (c == '"') return true;
+            if (static_cast<unsigned char>(c) < 0x20) return fail("control character in string");
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (position >= text.size()) break;
+            const char escape = text[position++];
+            switch (escape) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned code;
+                    if (!hex4(code)) return false;
+                    // A high surrogate must be followed by a low one.
+                    if (code >= 0xd800 && code < 0xdc00) {
+                        unsigned low;
+                        if (text.compare(position, 2, "\\u") != 0) return fail("unpaired surrogate");
+                        position += 2;
+                        if (!hex4(low)) return false;
+                        if (low < 0xdc00 || low >= 0xe000) return fail("unpaired surrogate");
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    } else if (code >= 0xdc00 && code < 0xe000) {
+                        return fail("unpaired surrogate");
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default:
+                    return fail("invalid escape");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    bool parseNumber(JsonValue& value) {
+        // Validate the JSON number grammar, then convert in the C locale, whatever the user's decimal point.
+        const size_t start = position;
+        if (position < text.size() && text[position] == '-') ++position;
+        auto digits = [this]() {
+            const size_t first = position;
+            while (position < text.size() && text[position] >= '0' && text[position] <= '9') ++position;
+            return position - first;
+        };
+        const size_t integerStart = position;
+        const size_t integerDigits = digits();
+        if (integerDigits == 0) return fail("unexpected character");
+        if (integerDigits > 1 && text[integerStart] == '0') return fail("leading zero in number");
+        if (position < text.size() && text[position] == '.') {
+            ++position;
+            if (digits() == 0) return fail("expected digits after '.'");
+        }
+        if (position < text.size() && (text[position] == 'e' || text[position] == 'E')) {
+            ++position;
+            if (position < text.size() && (text[position] == '+' || text[position] == '-')) ++position;
+            if (digits() == 0) return fail("expected digits in exponent");
+        }
+        value.type = JsonValue::Type::Number;
+        std::istringstream digitsIn(text.substr(start, position - start));
+        digitsIn.imbue(std::locale::classic());
+        digitsIn >> value.number;
+        if (!digitsIn) return fail("number out of range");
+        return true;
+    }
+};
+
+// Parses a complete JSON document.
+bool parseJson(const std::string& text, JsonValue& value, std::string& error) {
+    value = JsonValue();
+    JsonParser parser(text);
+    return parser.parse(value, error);
+}
+
+// Reads and parses a JSON file.
+bool loadJsonFile(const std::string& filename, JsonValue& value, std::string& error) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        error = "cannot open " + filename;
+        return false;
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    if (!parseJson(contents.str(), value, error)) {
+        error = filename + ": " + error;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// A parsed JSON value. Objects keep their members in file order.
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> items;                              // Array elements.
+    std::vector<std::pair<std::string, JsonValue> > members;   // Object members.
+
+    // The member with the given key, or nullptr if absent or not an object.
+    const JsonValue* find(const std::string& key) const;
+
+    // True for numbers without a fractional part that fit an int.
+    bool isInteger() const;
+};
+
+// Parses a complete JSON document: RFC 8259 plus // and /* */ comments.
+// Returns false and fills error with the line and column on failure.
+bool parseJson(const std::string& text, JsonValue& value, std::string& error);
+
+// Reads and parses a JSON file.
+bool loadJsonFile(const std::string& filename, JsonValue& value, std::string& error);
+
+#endif // JSON_H
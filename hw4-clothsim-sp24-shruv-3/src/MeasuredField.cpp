@@ -0,0 +1,371 @@
+#include "MeasuredField.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include "CGL/lodepng.h"
+#include "CGL/tinyexr.h"
+#include "FieldExr.h"
+#include "Simulation.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// EXR channels tried in order before falling back to the first one.
+static const char* const preferredChannels[] = {"vibration", "amplitude", "Y", "R"};
+
+// Values scale so this fraction of the valid samples lies below 1.
+static const double SCALE_PERCENTILE = 0.999;
+
+// At most this many samples are looked at to find the percentile.
+static const size_t PERCENTILE_SAMPLES = size_t(1) << 20;
+
+// Lobes of the Lanczos window.
+static const int LANCZOS_LOBES = 3;
+
+// Index of the channel a scan is taken from.
+static int pickChannel(const std::vector<std::string>& names) {
+    for (const char* preferred : preferredChannels) {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == preferred) return static_cast<int>(i);
+        }
+    }
+    return names.empty() ? -1 : 0;
+}
+
+// Turns raw values, top row first, into the scan's amplitudes: flipped so row
+// 0 is at the bottom, made absolute and scaled to [0, 1]. Non-finite values
+// are dropouts.
+static void finishScan(const std::vector<float>& raw, int width, int height, MeasuredScan& scan) {
+    scan.width = width;
+    scan.height = height;
+    scan.amplitude.resize(raw.size());
+
+    const size_t count = raw.size();
+    const size_t stride = std::max<size_t>(1, count / PERCENTILE_SAMPLES);
+    std::vector<float> samples;
+    samples.reserve(count / stride + 1);
+    for (size_t i = 0; i < count; i += stride) {
+        if (std::isfinite(raw[i])) samples.push_back(std::abs(raw[i]));
+    }
+    float scale = 0;
+    if (!samples.empty()) {
+        std::vector<float>::iterator nth = samples.begin() + static_cast<size_t>(SCALE_PERCENTILE * (samples.size() - 1));
+        std::nth_element(samples.begin(), nth, samples.end());
+        scale = *nth;
+    }
+    const float norm = scale > 0 ? 1.0f / scale : 0.0f;
+
+    int invalid = 0;
+    #pragma omp parallel for schedule(static) reduction(+ : invalid)
+    for (int y = 0; y < height; ++y) {
+        const float* src = &raw[static_cast<size_t>(height - 1 - y) * width];
+        float* dst = &scan.amplitude[static_cast<size_t>(y) * width];
+        for (int x = 0; x < width; ++x) {
+            if (std::isfinite(src[x])) {
+                dst[x] = std::min(1.0f, std::abs(src[x]) * norm);
+            } else {
+                dst[x] = 1.0f;
+                ++invalid;
+            }
+        }
+    }
+    scan.invalidSamples = invalid;
+}
+
+// Loads a scanline EXR through tinyexr; half channels are widened to float.
+static bool loadScanlineExr(const std::vector<unsigned char>& file, std::vector<float>& raw, int& width, int& height,
+                            std::string& channel, std::string& error) {
+    EXRImage image;
+    InitEXRImage(&image);
+    const char* message = nullptr;
+    if (ParseMultiChannelEXRHeaderFromMemory(&image, file.data(), &message) != 0) {
+        error = message ? message : "cannot parse the EXR header";
+        return false;
+    }
+    for (int c = 0; c < image.num_channels; ++c) {
+        if (image.pixel_types[c] == TINYEXR_PIXELTYPE_HALF) image.requested_pixel_types[c] = TINYEXR_PIXELTYPE_FLOAT;
+    }
+    if (LoadMultiChannelEXRFromMemory(&image, file.data(), &message) != 0) {
+        error = message ? message : "cannot decode the EXR image";
+        FreeEXRImage(&image);
+        return false;
+    }
+
+    std::vector<std::string> names(image.channel_names, image.channel_names + image.num_channels);
+    const int c = pickChannel(names);
+    if (c < 0) {
+        error = "the EXR file has no channels";
+        FreeEXRImage(&image);
+        return false;
+    }
+    width = image.width;
+    height = image.height;
+    channel = names[c];
+    raw.resize(static_cast<size_t>(width) * height);
+    if (image.pixel_types[c] == TINYEXR_PIXELTYPE_UINT) {
+        const unsigned int* values = reinterpret_cast<const unsigned int*>(image.images[c]);
+        for (size_t i = 0; i < raw.size(); ++i) raw[i] = static_cast<float>(values[i]);
+    } else {
+        std::memcpy(raw.data(), image.images[c], raw.size() * sizeof(float));
+    }
+    FreeEXRImage(&image);
+    return true;
+}
+
+// Loads the luminance of a PNG at 16 bits, so 16-bit scans keep their precision.
+// Transparent pixels are dropouts.
+static bool loadPngLuminance(const std::vector<unsigned char>& file, std::vector<float>& raw, int& width, int& height,
+                             std::string& error) {
+    std::vector<unsigned char> rgba;
+    unsigned w = 0, h = 0;
+    unsigned status = lodepng::decode(rgba, w, h, file, LCT_RGBA, 16);
+    if (status) {
+        error = lodepng_error_text(status);
+        return false;
+    }
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    raw.resize(static_cast<size_t>(width) * height);
+
+    // Samples are big-endian.
+    const long long count = static_cast<long long>(raw.size());
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < count; ++i) {
+        const unsigned char* p = &rgba[8 * i];
+        const float r = (p[0] << 8) | p[1];
+        const float g = (p[2] << 8) | p[3];
+        const float b = (p[4] << 8) | p[5];
+        const int a = (p[6] << 8) | p[7];
+        raw[i] = a > 32767 ? (0.299f * r + 0.587f * g + 0.114f * b) / 65535.0f : NAN;
+    }
+    return true;
+}
+
+// Loads a scan from EXR or PNG, told apart by their signatures.
+bool loadMeasuredScan(const std::string& filename, MeasuredScan& scan, std::string& error) {
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in) {
+        error = "cannot open " + filename;
+        return false;
+    }
+    const std::streamoff fileSize = in.tellg();
+    std::vector<unsigned char> file(static_cast<size_t>(std::min<std::streamoff>(fileSize, 8)));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(file.data()), file.size());
+
+    static const unsigned char exrMagic[4] = {0x76, 0x2f, 0x31, 0x01};
+    static const unsigned char pngMagic[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    const bool exr = file.size() >= 8 && std::memcmp(file.data(), exrMagic, 4) == 0;
+    const bool png = file.size() >= 8 && std::memcmp(file.data(), pngMagic, 8) == 0;
+    const bool tiled = exr && (file[5] & 0x02) != 0;
+
+    // The tiled reader opens the file itself; everything else is decoded from memory.
+    if ((exr && !tiled) || png) {
+        file.resize(static_cast<size_t>(fileSize));
+        in.seekg(0);
+        if (!in.read(reinterpret_cast<char*>(file.data()), fileSize)) {
+            error = "cannot read " + filename;
+            return false;
+        }
+    }
+    in.close();
+
+    std::vector<float> raw;
+    int width = 0, height = 0;
+    if (exr) {
+        if (tiled) {
+            // Tiled files, such as our own field dumps, go through the tiled reader.
+            ExrField field;
+            if (!readTiledExr(filename, field, error)) return false;
+            const int c = pickChannel(field.channelNames);
+            if (c < 0) {
+                error = "the EXR file has no channels";
+                return false;
+            }
+            width = field.width;
+            height = field.height;
+            scan.channel = field.channelNames[c];
+            raw.swap(field.channels[c]);
+        } else if (!loadScanlineExr(file, raw, width, height, scan.channel, error)) {
+            return false;
+        }
+    } else if (png) {
+        if (!loadPngLuminance(file, raw, width, height, error)) return false;
+        scan.channel = "luminance";
+    } else {
+        error = "not an OpenEXR or PNG file";
+        return false;
+    }
+    if (width <= 0 || height <= 0) {
+        error = "the scan is empty";
+        return false;
+    }
+    finishScan(raw, width, height, scan);
+    return true;
+}
+
+// Taps of a separable filter along one axis: for every target sample, the
+// source indices it reads (clamped to the edge) and their normalised weights.
+struct FilterTaps {
+    int taps = 0;
+    std::vector<int> index;       // taps per target sample.
+    std::vector<float> weight;
+};
+
+// Lanczos window of LANCZOS_LOBES lobes.
+static float lanczos(float d) {
+    d = std::abs(d);
+    if (d < 1e-6f) return 1.0f;
+    if (d >= LANCZOS_LOBES) return 0.0f;
+    const float p = PI * d;
+    return LANCZOS_LOBES * std::sin(p) * std::sin(p / LANCZOS_LOBES) / (p * p);
+}
+
+// Taps that map source samples onto target samples at cell centres.
+static FilterTaps computeTaps(int source, int target, ResampleFilter filter) {
+    const float scale = float(source) / target;
+    // Shrinking widens the kernel so it averages instead of skipping samples.
+    const float stretch = filter == ResampleFilter::Lanczos3 ? std::max(1.0f, scale) : 1.0f;
+    const float support = (filter == ResampleFilter::Lanczos3 ? LANCZOS_LOBES : 1) * stretch;
+
+    FilterTaps taps;
+    taps.taps = static_cast<int>(std::ceil(2 * support)) + 1;
+    taps.index.resize(static_cast<size_t>(target) * taps.taps);
+    taps.weight.resize(taps.index.size());
+    for (int i = 0; i < target; ++i) {
+        const float center = (i + 0.5f) * scale - 0.5f;
+        const int first = static_cast<int>(std::floor(center - support)) + 1;
+        float sum = 0;
+        for (int t = 0; t < taps.taps; ++t) {
+            const float d = (first + t - center) / stretch;
+            const float w = filter == ResampleFilter::Lanczos3 ? lanczos(d) : std::max(0.0f, 1.0f - std::abs(d));
+            const size_t k = static_cast<size_t>(i) * taps.taps + t;
+            taps.index[k] = std::min(std::max(first + t, 0), source - 1);
+            taps.weight[k] = w;
+            sum += w;
+        }
+        for (int t = 0; t < taps.taps; ++t) taps.weight[static_cast<size_t>(i) * taps.taps + t] /= sum;
+    }
+    return taps;
+}
+
+// Resamples rows first, then columns, each pass parallel over rows.
+void resampleScan(const MeasuredScan& scan, ResampleFilter filter, std::vector<float>& out, int width, int height) {
+    out.assign(static_cast<size_t>(width) * height, 1.0f);
+    if (scan.width <= 0 || scan.height <= 0 || width <= 0 || height <= 0) return;
+
+    const FilterTaps columns = computeTaps(scan.width, width, filter);
+    const FilterTaps rows = computeTaps(scan.height, height, filter);
+
+    // Only the scan rows some output row reads are resampled horizontally.
+    std::vector<unsigned char> needed(scan.height, 0);
+    for (size_t k = 0; k < rows.index.size(); ++k) {
+        if (rows.weight[k] != 0) needed[rows.index[k]] = 1;
+    }
+
+    std::vector<float> horizontal(static_cast<size_t>(scan.height) * width);
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < scan.height; ++y) {
+        if (!needed[y]) continue;
+        const float* src = &scan.amplitude[static_cast<size_t>(y) * scan.width];
+        float* dst = &horizontal[static_cast<size_t>(y) * width];
+        for (int x = 0; x < width; ++x) {
+            const int* index = &columns.index[static_cast<size_t>(x) * columns.taps];
+            const float* weight = &columns.weight[static_cast<size_t>(x) * columns.taps];
+            float sum = 0;
+            for (int t = 0; t < columns.taps; ++t) sum += weight[t] * src[index[t]];
+            dst[x] = sum;
+        }
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        float* dst = &out[static_cast<size_t>(y) * width];
+        std::fill(dst, dst + width, 0.0f);
+        for (int t = 0; t < rows.taps; ++t) {
+            const size_t k = static_cast<size_t>(y) * rows.taps + t;
+            const float weight = rows.weight[k];
+            if (weight == 0) continue;
+            const float* src = &horizontal[static_cast<size_t>(rows.index[k]) * width];
+            for (int x = 0; x < width; ++x) dst[x] += weight * src[x];
+        }
+        // Lanczos rings around sharp edges; amplitudes stay in [0, 1].
+        for (int x = 0; x < width; ++x) dst[x] = std::min(1.0f, std::max(0.0f, dst[x]));
+    }
+}
+
+// Modification time and size of a file, or false if it cannot be examined.
+static bool fileStamp(const std::string& filename, long long& modified, long long& size) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) return false;
+#if defined(__linux__)
+    modified = static_cast<long long>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    modified = static_cast<long long>(info.st_mtimespec.tv_sec) * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+    modified = static_cast<long long>(info.st_mtime);
+#endif
+    size = static_cast<long long>(info.st_size);
+    return true;
+}
+
+// The cached scan if its file is unchanged, else a freshly decoded one.
+std::shared_ptr<const MeasuredScan> MeasuredFieldCache::load(const std::string& filename, std::string& error) {
+    long long modified = 0, size = 0;
+    if (!fileStamp(filename, modified, size)) {
+        error = "cannot open " + filename;
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::map<std::string, Entry>::iterator found = entries.find(filename);
+        if (found != entries.end() && found->second.modified == modified && found->second.size == size) {
+            found->second.lastUse = ++useCount;
+            ++hits;
+            return found->second.scan;
+        }
+    }
+
+    // Decode outside the lock; another thread may look up other scans meanwhile.
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<MeasuredScan> scan = std::make_shared<MeasuredScan>();
+    if (!loadMeasuredScan(filename, *scan, error)) return nullptr;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> guard(lock);
+    ++misses;
+    decodeSeconds += seconds;
+    Entry& entry = entries[filename];
+    if (entry.scan) cachedBytes -= entry.scan->amplitude.size() * sizeof(float);
+    entry.modified = modified;
+    entry.size = size;
+    entry.lastUse = ++useCount;
+    entry.scan = scan;
+    cachedBytes += scan->amplitude.size() * sizeof(float);
+
+    // Drop the least recently used scans, never the one just loaded.
+    while (cachedBytes > maxBytes && entries.size() > 1) {
+        std::map<std::string, Entry>::iterator oldest = entries.end();
+        for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+            if (it->first != filename && (oldest == entries.end() || it->second.lastUse < oldest->second.lastUse)) {
+                oldest = it;
+            }
+        }
+        cachedBytes -= oldest->second.scan->amplitude.size() * sizeof(float);
+        entries.erase(oldest);
+    }
+    return scan;
+}
+
+// Forgets every cached scan.
+void MeasuredFieldCache::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    entries.clear();
+    cachedBytes = 0;
+}
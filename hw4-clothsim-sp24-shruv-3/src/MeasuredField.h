@@ -0,0 +1,70 @@
+#ifndef MEASUREDFIELD_H
+#define MEASUREDFIELD_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A measured displacement map of a real plate, e.g. a laser-vibrometer scan.
+struct MeasuredScan {
+    int width = 0, height = 0;
+    std::vector<float> amplitude;   // |displacement| scaled to [0, 1], row-major, row 0 at the bottom.
+    std::string channel;            // EXR channel the values came from, or "luminance" for PNG.
+    int invalidSamples = 0;         // Dropouts (NaN, infinite or transparent), stored as 1.
+};
+
+// Filter used to resample a scan onto the simulation grid.
+enum class ResampleFilter {
+    Bilinear,   // Fastest; aliases when shrinking a scan by more than 2x.
+    Lanczos3    // Windowed sinc, widened when shrinking so every scan sample contributes.
+};
+
+// Loads a scan from an OpenEXR file, tiled or scanline, or from an 8- or
+// 16-bit PNG. EXR files use the channel vibration, amplitude, Y or R,
+// whichever comes first, else their first channel; PNG files their
+// luminance. Values are made absolute and scaled by their 99.9th percentile,
+// so isolated hot pixels do not flatten the pattern. Dropouts become 1, so
+// particles are pushed off them as off the rim of a masked plate.
+// Returns false and fills error if the file cannot be decoded.
+bool loadMeasuredScan(const std::string& filename, MeasuredScan& scan, std::string& error);
+
+// Resamples a scan onto a width x height grid, sampling at cell centres.
+// Separable, with the filter taps computed once per column and row; both
+// passes run in parallel over rows.
+void resampleScan(const MeasuredScan& scan, ResampleFilter filter, std::vector<float>& out, int width, int height);
+
+// Decoded scans by path. A scan is decoded again only when the modification
+// time or size of its file changes, so rebuilding the patterns after a resize
+// or a field source change only resamples. Least recently used scans are
+// dropped beyond maxBytes. Safe to share between threads.
+class MeasuredFieldCache {
+public:
+    // The scan of filename, or nullptr with error filled if it cannot be loaded.
+    std::shared_ptr<const MeasuredScan> load(const std::string& filename, std::string& error);
+
+    void clear();
+
+    size_t maxBytes = size_t(512) << 20;
+
+    // Statistics.
+    long long hits = 0;
+    long long misses = 0;
+    double decodeSeconds = 0;   // Time spent decoding on misses.
+
+private:
+    struct Entry {
+        long long modified = 0;
+        long long size = 0;
+        unsigned long long lastUse = 0;
+        std::shared_ptr<const MeasuredScan> scan;
+    };
+
+    std::map<std::string, Entry> entries;
+    size_t cachedBytes = 0;
+    unsigned long long useCount = 0;
+    std::mutex lock;
+};
+
+#endif // MEASUREDFIELD_H
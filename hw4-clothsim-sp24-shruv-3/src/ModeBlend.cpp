@@ -0,0 +1,147 @@
+#include "ModeBlend.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Drops every cached field and shows the given pattern.
+void ModeBlender::reset(const Builder& newBuilder, int patternCount, int pattern) {
+    builder = newBuilder;
+    patterns = std::max(1, patternCount);
+    components.assign(patterns, std::vector<float>());
+    lastUse.assign(patterns, 0);
+    stored.assign(patterns, 0);
+    position = target = pattern;
+    sweeping = false;
+    dirty = true;
+}
+
+// Starts a crossfade to the pattern after or before the target.
+void ModeBlender::step(int direction) {
+    sweeping = false;
+    target = std::floor(target + 0.5) + direction;
+}
+
+// Starts a crossfade to the given pattern, the short way round the list.
+void ModeBlender::crossfadeTo(int pattern) {
+    sweeping = false;
+    const double current = std::floor(target + 0.5);
+    double offset = std::fmod(pattern - current, static_cast<double>(patterns));
+    if (offset > 0.5 * patterns) offset -= patterns;
+    if (offset < -0.5 * patterns) offset += patterns;
+    target = current + offset;
+}
+
+// Starts or stops the continuous sweep.
+void ModeBlender::toggleSweep() {
+    sweeping = !sweeping;
+    if (!sweeping) target = std::ceil(position);
+}
+
+// Keeps a field built elsewhere.
+void ModeBlender::store(int pattern, std::vector<float>& field) {
+    components[pattern].swap(field);
+    field.clear();
+    stored[pattern] = 1;
+    lastUse[pattern] = ++uses;
+}
+
+// Returns the cached field of a pattern, building it on first use.
+const std::vector<float>& ModeBlender::component(int pattern) {
+    lastUse[pattern] = ++uses;
+    std::vector<float>& field = components[pattern];
+    if (!field.empty()) return field;
+    builder(pattern, field);
+
+    // Over the limit, drop the least recently used field that may go.
+    if (residentLimit > 0) {
+        int resident = 0;
+        for (const std::vector<float>& component : components) resident += !component.empty();
+        while (resident > residentLimit) {
+            int oldest = -1;
+            for (int i = 0; i < patterns; ++i) {
+                if (components[i].empty() || stored[i] || i == pattern || i == base || i == nextPattern()) continue;
+                if (oldest < 0 || lastUse[i] < lastUse[oldest]) oldest = i;
+            }
+            if (oldest < 0) break;
+            std::vector<float>().swap(components[oldest]);
+            --resident;
+        }
+    }
+    return field;
+}
+
+// Advances the blend by dt seconds.
+bool ModeBlender::update(Simulation& sim, float dt) {
+    if (sweeping) {
+        position += sweepRate * dt;
+        target = position;
+    } else if (position != target) {
+        const double distance = dt / crossfadeSeconds;
+        if (std::abs(target - position) <= distance) {
+            position = target;
+        } else {
+            position += target > position ? distance : -distance;
+        }
+    } else if (!dirty) {
+        return false;
+    }
+    dirty = false;
+
+    // Keep the positions near [0, patterns) so they never lose precision.
+    const double wrap = std::floor(position / patterns) * patterns;
+    position -= wrap;
+    target -= wrap;
+
+    base = std::min(static_cast<int>(position), patterns - 1);
+    const float t = static_cast<float>(position - base);
+    weight = t * t * (3.0f - 2.0f * t);   // Smoothstep, so particles ease in and out of each pattern.
+
+    const std::vector<float>& a = component(base);
+    if (weight == 0.0f) {
+        sim.vibrationValues = a;
+    } else {
+        const std::vector<float>& b = component(nextPattern());
+        const int cells = static_cast<int>(a.size());
+        sim.vibrationValues.resize(cells);
+        float* out = sim.vibrationValues.data();
+        const float* pa = a.data();
+        const float* pb = b.data();
+        const float w = weight;
+        #pragma omp parallel for simd schedule(static)
+        for (int i = 0; i < cells; ++i) {
+            out[i] = pa[i] + (pb[i] - pa[i]) * w;
+        }
+    }
+    sim.computeGradients();
+    return true;
+}
+
+// Writes the normalised weighted sum of any number of cached patterns.
+bool ModeBlender::compose(Simulation& sim, const std::vector<float>& weights) {
+    const int count = std::min(static_cast<int>(weights.size()), patterns);
+    float total = 0;
+    for (int i = 0; i < count; ++i) total += std::max(weights[i], 0.0f);
+    if (total <= 0) return false;
+
+    bool first = true;
+    for (int i = 0; i < count; ++i) {
+        if (weights[i] < 1e-3f * total) continue;
+        const std::vector<float>& field = component(i);
+        const int cells = static_cast<int>(field.size());
+        sim.vibrationValues.resize(cells);
+        float* out = sim.vibrationValues.data();
+        const float* in = field.data();
+        const float w = weights[i] / total;
+        if (first) {
+            #pragma omp parallel for simd schedule(static)
+            for (int k = 0; k < cells; ++k) out[k] = in[k] * w;
+            first = false;
+        } else {
+            #pragma omp parallel for simd schedule(static)
+            for (int k = 0; k < cells; ++k) out[k] += in[k] * w;
+        }
+    }
+    sim.computeGradients();
+    dirty = false;
+    return true;
+}
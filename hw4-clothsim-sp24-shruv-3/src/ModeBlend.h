@@ -0,0 +1,79 @@
+#ifndef MODEBLEND_H
+#define MODEBLEND_H
+
+#include <functional>
+#include <vector>
+#include "Simulation.h"
+
+// Time-varying blend of precomputed mode fields.
+// The shown pattern is a fractional position along the pattern list. Each
+// frame the position moves toward its target (or sweeps forward), and the
+// field is rebuilt as a weighted sum of the cached fields of the two
+// neighbouring patterns, followed by a gradient pass. No pattern is computed
+// more than once per reset, so particles can migrate between patterns at
+// frame rate without being respawned.
+class ModeBlender {
+public:
+    // Fills out with the vibration field of a pattern at the current grid size.
+    typedef std::function<void(int pattern, std::vector<float>& out)> Builder;
+
+    float crossfadeSeconds = 1.0f;   // Time to move one pattern after UP/DOWN.
+    float sweepRate = 0.25f;         // Patterns per second while sweeping.
+    bool sweeping = false;
+
+    // Drops every cached field and shows the given pattern, e.g. after a resize
+    // or a change of field source. The next update rebuilds the field.
+    void reset(const Builder& builder, int patternCount, int pattern);
+
+    // Hands over a field built elsewhere, e.g. precomputed in parallel, and
+    // keeps it cached for good. field is left empty.
+    void store(int pattern, std::vector<float>& field);
+
+    bool cached(int pattern) const { return !components[pattern].empty(); }
+
+    // Most fields cached at once, 0 for no limit. Beyond it the least recently
+    // used field is dropped, never a stored one or one of the two being blended.
+    int residentLimit = 0;
+
+    // Starts a crossfade to the pattern after (+1) or before (-1) the target.
+    void step(int direction);
+
+    // Starts a crossfade to the given pattern, the short way round the list.
+    void crossfadeTo(int pattern);
+
+    // Starts or stops the continuous sweep. Stopping settles on the next pattern.
+    void toggleSweep();
+
+    // Advances the blend by dt seconds and writes the field and gradients of
+    // sim when they changed. Returns true if they did.
+    bool update(Simulation& sim, float dt);
+
+    // Writes sum(weights[i] * pattern i) / sum(weights) and its gradients to sim,
+    // for any number of patterns. Weights below a thousandth of the total are
+    // skipped. Returns false and leaves sim alone if all weights are zero.
+    bool compose(Simulation& sim, const std::vector<float>& weights);
+
+    // Blend currently shown: (1 - mix) * basePattern + mix * nextPattern.
+    int basePattern() const { return base; }
+    int nextPattern() const { return (base + 1) % patterns; }
+    float mix() const { return weight; }
+
+    // Pattern the blend is closest to.
+    int nearestPattern() const { return weight < 0.5f ? base : nextPattern(); }
+
+private:
+    const std::vector<float>& component(int pattern);
+
+    Builder builder;
+    int patterns = 1;
+    std::vector<std::vector<float> > components;  // Cached field per pattern, empty until first used.
+    std::vector<unsigned long long> lastUse;       // Use counter value when each field was last read.
+    std::vector<char> stored;                      // Fields handed over by store, never dropped.
+    unsigned long long uses = 0;
+    double position = 0, target = 0;               // Fractional pattern positions, not wrapped.
+    int base = 0;
+    float weight = 0;
+    bool dirty = true;                             // Field must be rebuilt even if the position is unchanged.
+};
+
+#endif // MODEBLEND_H
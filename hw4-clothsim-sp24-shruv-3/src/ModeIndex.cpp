@@ -0,0 +1,70 @@
+#include "ModeIndex.h"
+
+#include <algorithm>
+#include "Simulation.h"
+
+// Indexes every square-plate mode up to maxOrder.
+void ModeIndex::build(int maxOrder) {
+    entries.clear();
+    for (int n = 2; n <= maxOrder; ++n) {
+        for (int m = 1; m < n; ++m) {
+            IndexedMode mode;
+            mode.m = m;
+            mode.n = n;
+            mode.frequency = calculateFrequency(ChladniParams(m, n, L2));
+            mode.pattern = -1;
+            entries.push_back(mode);
+        }
+    }
+    for (size_t i = 0; i < chladniParams.size(); ++i) {
+        const ChladniParams& params = chladniParams[i];
+        for (IndexedMode& mode : entries) {
+            if (mode.m == std::min(params.m, params.n) && mode.n == std::max(params.m, params.n)) {
+                mode.pattern = static_cast<int>(i);
+            }
+        }
+    }
+    sort();
+}
+
+// Indexes arbitrary patterns by their frequencies.
+void ModeIndex::build(const std::vector<float>& patternFrequencies) {
+    entries.resize(patternFrequencies.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i].frequency = patternFrequencies[i];
+        entries[i].m = entries[i].n = -1;
+        entries[i].pattern = static_cast<int>(i);
+    }
+    sort();
+}
+
+// Sorts the entries and lays out their frequencies for searching.
+void ModeIndex::sort() {
+    std::stable_sort(entries.begin(), entries.end(), [](const IndexedMode& a, const IndexedMode& b) {
+        return a.frequency < b.frequency;
+    });
+    frequencies.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) frequencies[i] = entries[i].frequency;
+}
+
+// Position of the mode whose frequency is nearest.
+int ModeIndex::nearest(float frequency) const {
+    if (frequencies.empty()) return -1;
+    const int above = static_cast<int>(std::lower_bound(frequencies.begin(), frequencies.end(), frequency) -
+                                       frequencies.begin());
+    if (above == 0) return 0;
+    if (above == static_cast<int>(frequencies.size())) return above - 1;
+    return frequency - frequencies[above - 1] <= frequencies[above] - frequency ? above - 1 : above;
+}
+
+// Range of modes degenerate with the given mode.
+std::pair<int, int> ModeIndex::degenerate(int mode) const {
+    const float f = frequencies[mode];
+    const float low = f * (1.0f - degeneracyTolerance);
+    const float high = f * (1.0f + degeneracyTolerance);
+    const int first = static_cast<int>(std::lower_bound(frequencies.begin(), frequencies.begin() + mode, low) -
+                                       frequencies.begin());
+    const int last = static_cast<int>(std::upper_bound(frequencies.begin() + mode, frequencies.end(), high) -
+                                      frequencies.begin());
+    return std::make_pair(first, last);
+}
@@ -0,0 +1,49 @@
+#ifndef MODEINDEX_H
+#define MODEINDEX_H
+
+#include <utility>
+#include <vector>
+
+// One entry of a ModeIndex.
+struct IndexedMode {
+    float frequency;   // Resonant frequency in Hz.
+    int m, n;          // Mode numbers of a square-plate mode, -1 for other patterns.
+    int pattern;       // Pattern number of the field source, or -1 if it has none.
+};
+
+// Modes sorted by frequency, for the inverse of calculateFrequency.
+// Finding the mode nearest to a frequency is a binary search, and modes with
+// the same frequency (e.g. (1,8) and (4,7), since only m^2 + n^2 matters)
+// sit next to each other, so the degenerate set of a mode is a contiguous range.
+class ModeIndex {
+public:
+    // Relative frequency difference below which modes are degenerate. Square
+    // modes are exactly degenerate; neighbouring m^2 + n^2 at order 200 still
+    // differ by 6e-6.
+    float degeneracyTolerance = 1e-6f;
+
+    // Indexes every square-plate mode (m, n) with 1 <= m < n <= maxOrder by
+    // calculateFrequency. Modes that appear in chladniParams carry their
+    // position there as their pattern number. m == n is left out because the
+    // Chladni field of such a mode vanishes everywhere.
+    void build(int maxOrder);
+
+    // Indexes arbitrary patterns by their frequencies, e.g. mask or circular modes.
+    void build(const std::vector<float>& frequencies);
+
+    // Position in modes() of the mode whose frequency is nearest, or -1 if empty. O(log N).
+    int nearest(float frequency) const;
+
+    // Range [first, last) of modes() degenerate with the given mode, itself included. O(log N).
+    std::pair<int, int> degenerate(int mode) const;
+
+    const std::vector<IndexedMode>& modes() const { return entries; }
+
+private:
+    void sort();
+
+    std::vector<IndexedMode> entries;   // Ascending frequency.
+    std::vector<float> frequencies;     // Frequencies of entries, contiguous for the binary search.
+};
+
+#endif // MODEINDEX_H
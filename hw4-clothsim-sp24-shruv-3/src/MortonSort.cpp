@@ -0,0 +1,146 @@
+#include "MortonSort.h"
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Spreads the low 16 bits of v so that there is a zero bit between each of them.
+static uint32_t spreadBits(uint32_t v) {
+    v &= 0x0000FFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+// Interleaves the bits of a cell's x and y coordinates into a Z-order key.
+uint32_t mortonKey(uint32_t x, uint32_t y) {
+    return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+// Advances the sorter by one frame, running radix passes when one is due.
+bool MortonSorter::update(std::vector<Particle>& particles, int width, int height, ParticleVelocities* velocities) {
+    ++frames;
+    ++framesSinceSort;
+
+    // Spawned or removed particles invalidate the keys of a sort in progress.
+    if (passesLeft > 0 && keys.size() != particles.size()) {
+        passesLeft = 0;
+    }
+    if (passesLeft == 0 && framesSinceSort < interval) return false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (passesLeft == 0) {
+        // Number of bits needed per axis, plus one more key bit for off-screen particles.
+        int axisBits = 0;
+        while ((1 << axisBits) < std::max(width, height) && axisBits < 15) ++axisBits;
+        const uint32_t offscreenKey = 1u << (2 * axisBits);
+        const int numParticles = static_cast<int>(particles.size());
+
+        keys.resize(numParticles);
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < numParticles; ++i) {
+            const Particle& p = particles[i];
+            if (p.x < 0 || p.x >= width || p.y < 0 || p.y >= height) {
+                keys[i] = offscreenKey;
+            } else {
+                keys[i] = mortonKey(static_cast<uint32_t>(p.x), static_cast<uint32_t>(p.y));
+            }
+        }
+        passesLeft = (2 * axisBits + 1 + 7) / 8;
+        nextShift = 0;
+        framesSinceSort = 0;
+    }
+
+    if (velocities && velocities->size() != particles.size()) velocities = nullptr;
+    for (int pass = 0; pass < passesPerFrame && passesLeft > 0; ++pass) {
+        radixPass(particles, velocities, nextShift);
+        nextShift += 8;
+        if (--passesLeft == 0) ++sortsDone;
+    }
+
+    totalSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+// Stable counting sort of the particles (and their keys) on one byte of the key.
+// Same layout as SpatialGrid::build: per-thread histograms over contiguous
+// slices, converted to per-thread offsets, then a scatter of each slice.
+void MortonSorter::radixPass(std::vector<Particle>& particles, ParticleVelocities* velocities, int shift) {
+    const int numBuckets = 256;
+    const int numParticles = static_cast<int>(particles.size());
+
+    int maxThreads = 1;
+#ifdef _OPENMP
+    maxThreads = omp_get_max_threads();
+#endif
+    threadCounts.assign(static_cast<size_t>(maxThreads) * numBuckets, 0);
+    keysScratch.resize(numParticles);
+    // Match the caller's capacity so the swap below never shrinks it.
+    particlesScratch.reserve(particles.capacity());
+    particlesScratch.resize(numParticles, Particle(0, 0));
+    if (velocities) {
+        velocitiesScratch.x.reserve(velocities->x.capacity());
+        velocitiesScratch.y.reserve(velocities->y.capacity());
+        velocitiesScratch.resize(numParticles);
+    }
+
+    #pragma omp parallel
+    {
+        int thread = 0, numThreads = 1;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+        numThreads = omp_get_num_threads();
+#endif
+        const int begin = static_cast<int>(static_cast<long long>(numParticles) * thread / numThreads);
+        const int end = static_cast<int>(static_cast<long long>(numParticles) * (thread + 1) / numThreads);
+        int* counts = &threadCounts[thread * numBuckets];
+
+        for (int i = begin; i < end; ++i) {
+            counts[(keys[i] >> shift) & 0xFF]++;
+        }
+        #pragma omp barrier
+
+        #pragma omp single
+        {
+            int running = 0;
+            for (int b = 0; b < numBuckets; ++b) {
+                for (int t = 0; t < numThreads; ++t) {
+                    int n = threadCounts[t * numBuckets + b];
+                    threadCounts[t * numBuckets + b] = running;
+                    running += n;
+                }
+            }
+        }
+
+        for (int i = begin; i < end; ++i) {
+            int slot = counts[(keys[i] >> shift) & 0xFF]++;
+            keysScratch[slot] = keys[i];
+            particlesScratch[slot] = particles[i];
+            if (velocities) {
+                velocitiesScratch.x[slot] = velocities->x[i];
+                velocitiesScratch.y[slot] = velocities->y[i];
+            }
+        }
+    }
+
+    keys.swap(keysScratch);
+    particles.swap(particlesScratch);
+    if (velocities) {
+        velocities->x.swap(velocitiesScratch.x);
+        velocities->y.swap(velocitiesScratch.y);
+    }
+}
+
+// Prints sort count, cost per sort and cost amortized over every frame.
+void MortonSorter::report(std::ostream& out) const {
+    if (frames == 0) return;
+    out << "Morton sort: " << sortsDone << " sorts over " << frames << " frames, "
+        << (sortsDone > 0 ? totalSeconds * 1000.0 / sortsDone : 0.0) << " ms per sort, "
+        << totalSeconds * 1000.0 / frames << " ms per frame amortized" << std::endl;
+}
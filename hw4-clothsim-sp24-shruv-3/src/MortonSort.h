@@ -0,0 +1,46 @@
+#ifndef MORTONSORT_H
+#define MORTONSORT_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "Particle.h"
+
+// Interleaves the bits of a cell's x and y coordinates into a Z-order key.
+uint32_t mortonKey(uint32_t x, uint32_t y);
+
+// Keeps the particle vector in Z-order of the pixel each particle sits on, so
+// gradient lookups in updateParticles walk the grid almost sequentially.
+// Every `interval` frames a least-significant-digit radix sort is started on the
+// current keys; its byte passes are spread over the following frames, so no
+// single frame pays for the whole sort. Off-screen particles sort to the end.
+class MortonSorter {
+public:
+    int interval = 120;      // Frames between the start of two sorts.
+    int passesPerFrame = 1;  // Radix passes run per frame while a sort is in progress.
+
+    // Advances the sorter by one frame, running radix passes when one is due.
+    // Velocities, if given and as many as the particles, move with them.
+    // Returns true when the particles were reordered.
+    bool update(std::vector<Particle>& particles, int width, int height, ParticleVelocities* velocities = nullptr);
+
+    // Prints sort count, cost per sort and cost amortized over every frame.
+    void report(std::ostream& out) const;
+
+    long long frames = 0;      // Frames seen by update.
+    long long sortsDone = 0;   // Completed sorts.
+    double totalSeconds = 0;   // Time spent in key generation and radix passes.
+
+private:
+    void radixPass(std::vector<Particle>& particles, ParticleVelocities* velocities, int shift);
+
+    int passesLeft = 0;     // Remaining passes of the sort in progress.
+    int nextShift = 0;      // Bit offset of the next digit to sort on.
+    int framesSinceSort = 0;
+    std::vector<uint32_t> keys, keysScratch;
+    std::vector<Particle> particlesScratch;
+    ParticleVelocities velocitiesScratch;
+    std::vector<int> threadCounts;
+};
+
+#endif // MORTONSORT_H
@@ -0,0 +1,642 @@
+#include "Multigrid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "Simulation.h"
+
+// The fine grid is rounded up to a multiple of this many intervals so it can be coarsened.
+static const int INTERVAL_MULTIPLE = 32;
+
+// Largest -shift a coarse grid may have, in its own units. Beyond it the
+// flexural wave has fewer than about five nodes per wavelength.
+static const double MAX_COARSE_SHIFT = 2.0;
+
+// Krylov vectors kept before GMRES restarts.
+static const int GMRES_RESTART = 30;
+
+// Smallest grid worth coarsening to.
+static const int MIN_COARSE_NODES = 5;
+
+// Probe spacing for assembling the fine operator. Two probes this far apart
+// never reach the same node, even through the halo.
+static const int PROBE_SPACING = 9;
+
+// 13-point biharmonic stencil in grid units, on a field with a two-node halo.
+static inline double biharmonic(const double* w, int k, int s) {
+    return 20.0 * w[k]
+        - 8.0 * (w[k - 1] + w[k + 1] + w[k - s] + w[k + s])
+        + 2.0 * (w[k - s - 1] + w[k - s + 1] + w[k + s - 1] + w[k + s + 1])
+        + (w[k - 2] + w[k + 2] + w[k - 2 * s] + w[k + 2 * s]);
+}
+
+// Fills the two-node halo of an n x n field with the same edge conditions as PlateSolver::applyEdge.
+static void fillHalo(double* w, int n, PlateEdge edge) {
+    const int s = n + 4;
+    auto ghosts = [edge](double e, double i1, double i2, double& g1, double& g2) {
+        switch (edge) {
+            case PlateEdge::Free:
+                g1 = 2 * e - i1;
+                g2 = i2 - 2 * i1 + 2 * g1;
+                break;
+            case PlateEdge::SimplySupported:
+                g1 = -i1;
+                g2 = -i2;
+                break;
+            case PlateEdge::Clamped:
+                g1 = i1;
+                g2 = i2;
+                break;
+        }
+    };
+
+    for (int j = 2; j < n + 2; ++j) {
+        double* row = w + j * s;
+        ghosts(row[2], row[3], row[4], row[1], row[0]);
+        ghosts(row[n + 1], row[n], row[n - 1], row[n + 2], row[n + 3]);
+    }
+    for (int i = 0; i < s; ++i) {
+        double* col = w + i;
+        ghosts(col[2 * s], col[3 * s], col[4 * s], col[1 * s], col[0]);
+        ghosts(col[(n + 1) * s], col[n * s], col[(n - 1) * s], col[(n + 2) * s], col[(n + 3) * s]);
+    }
+}
+
+// Builds compressed rows from per-row entry lists, merging duplicate columns.
+static void compress(std::vector<std::vector<std::pair<int, std::complex<double> > > >& rows,
+                     std::vector<int>& rowStart, std::vector<int>& cols,
+                     std::vector<std::complex<double> >& values) {
+    rowStart.assign(rows.size() + 1, 0);
+    cols.clear();
+    values.clear();
+    for (size_t r = 0; r < rows.size(); ++r) {
+        std::sort(rows[r].begin(), rows[r].end(),
+                  [](const std::pair<int, std::complex<double> >& a, const std::pair<int, std::complex<double> >& b) {
+                      return a.first < b.first;
+                  });
+        for (size_t e = 0; e < rows[r].size(); ++e) {
+            if (!cols.empty() && static_cast<int>(cols.size()) > rowStart[r] && cols.back() == rows[r][e].first) {
+                values.back() += rows[r][e].second;
+            } else {
+                cols.push_back(rows[r][e].first);
+                values.push_back(rows[r][e].second);
+            }
+        }
+        rowStart[r + 1] = static_cast<int>(cols.size());
+    }
+}
+
+// Whether a node is an unknown. Constrained edges hold their nodes at zero.
+bool PlateMultigrid::active(int n, int i, int j) const {
+    if (edge == PlateEdge::Free) return true;
+    return i > 0 && j > 0 && i < n - 1 && j < n - 1;
+}
+
+// Assembles the fine operator, edge conditions included, by applying the
+// stencil to unit displacements spaced far enough apart not to interact.
+void PlateMultigrid::assembleFine(Level& level, double shiftRe, double shiftIm) const {
+    const int n = level.n;
+    const int s = n + 4;
+    std::vector<std::vector<std::pair<int, Complex> > > rows(static_cast<size_t>(n) * n);
+    std::vector<double> probe(static_cast<size_t>(s) * s);
+
+    for (int oj = 0; oj < PROBE_SPACING; ++oj) {
+        for (int oi = 0; oi < PROBE_SPACING; ++oi) {
+            std::fill(probe.begin(), probe.end(), 0.0);
+            for (int pj = oj; pj < n; pj += PROBE_SPACING) {
+                for (int pi = oi; pi < n; pi += PROBE_SPACING) {
+                    if (active(n, pi, pj)) probe[(pj + 2) * s + pi + 2] = 1.0;
+                }
+            }
+            fillHalo(probe.data(), n, edge);
+
+            for (int pj = oj; pj < n; pj += PROBE_SPACING) {
+                for (int pi = oi; pi < n; pi += PROBE_SPACING) {
+                    if (!active(n, pi, pj)) continue;
+                    for (int j = std::max(0, pj - 4); j <= std::min(n - 1, pj + 4); ++j) {
+                        for (int i = std::max(0, pi - 4); i <= std::min(n - 1, pi + 4); ++i) {
+                            if (!active(n, i, j)) continue;
+                            double v = biharmonic(probe.data(), (j + 2) * s + i + 2, s);
+                            if (v != 0.0) rows[j * n + i].push_back(std::make_pair(pj * n + pi, Complex(v, 0.0)));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < n; ++i) {
+            const int node = j * n + i;
+            rows[node].push_back(std::make_pair(node, active(n, i, j) ? Complex(shiftRe, shiftIm) : Complex(1.0, 0.0)));
+        }
+    }
+    compress(rows, level.a.rowStart, level.a.cols, level.a.values);
+}
+
+// Cubic interpolation weights along one axis: the coarse nodes that fine node
+// i draws from. Cubic rather than linear, because a fourth-order operator
+// needs interpolation plus restriction of more than fourth order between them
+// for the coarse correction to work. Near the ends the stencil turns one-sided.
+static int cubicWeights(int i, int coarseN, int* nodes, double* weights) {
+    const int c = i / 2;
+    if ((i & 1) == 0) {
+        nodes[0] = c;
+        weights[0] = 1.0;
+        return 1;
+    }
+    static const double centred[4] = {-1.0 / 16, 9.0 / 16, 9.0 / 16, -1.0 / 16};
+    static const double first[4] = {5.0 / 16, 15.0 / 16, -5.0 / 16, 1.0 / 16};
+    static const double last[4] = {1.0 / 16, -5.0 / 16, 15.0 / 16, 5.0 / 16};
+    int start = c - 1;
+    const double* w = centred;
+    if (start < 0) {
+        start = c;
+        w = first;
+    } else if (c + 2 > coarseN - 1) {
+        start = c - 2;
+        w = last;
+    }
+    for (int k = 0; k < 4; ++k) {
+        nodes[k] = start + k;
+        weights[k] = w[k];
+    }
+    return 4;
+}
+
+// Interpolation from the next coarser grid, one row per fine node.
+void PlateMultigrid::buildProlongation(Level& fine, int coarseN) const {
+    const int n = fine.n;
+    fine.prolongStart.assign(static_cast<size_t>(n) * n + 1, 0);
+    fine.prolongCols.clear();
+    fine.prolongValues.clear();
+
+    int nodesX[4], nodesY[4];
+    double weightsX[4], weightsY[4];
+    for (int j = 0; j < n; ++j) {
+        const int countY = cubicWeights(j, coarseN, nodesY, weightsY);
+        for (int i = 0; i < n; ++i) {
+            if (active(n, i, j)) {
+                const int countX = cubicWeights(i, coarseN, nodesX, weightsX);
+                for (int b = 0; b < countY; ++b) {
+                    for (int a = 0; a < countX; ++a) {
+                        // Constrained coarse nodes are zero, so their weight drops out.
+                        if (!active(coarseN, nodesX[a], nodesY[b])) continue;
+                        fine.prolongCols.push_back(nodesY[b] * coarseN + nodesX[a]);
+                        fine.prolongValues.push_back(weightsX[a] * weightsY[b]);
+                    }
+                }
+            }
+            fine.prolongStart[j * n + i + 1] = static_cast<int>(fine.prolongCols.size());
+        }
+    }
+}
+
+// Coarse operator P^T A P, so a coarse correction sees exactly the fine
+// operator restricted to smooth fields, edges included.
+void PlateMultigrid::galerkin(const Level& fine, Level& coarse) const {
+    const int nc = coarse.n;
+    const int coarseNodes = nc * nc;
+    const int fineNodes = fine.n * fine.n;
+
+    // Transpose of the prolongation: fine rows that touch each coarse node.
+    std::vector<std::vector<std::pair<int, double> > > restriction(coarseNodes);
+    for (int r = 0; r < fineNodes; ++r) {
+        for (int k = fine.prolongStart[r]; k < fine.prolongStart[r + 1]; ++k) {
+            restriction[fine.prolongCols[k]].push_back(std::make_pair(r, fine.prolongValues[k]));
+        }
+    }
+
+    std::vector<std::vector<std::pair<int, Complex> > > rows(coarseNodes);
+    #pragma omp parallel
+    {
+        std::vector<Complex> accumulator(coarseNodes, Complex(0.0, 0.0));
+        std::vector<int> touched;
+
+        #pragma omp for schedule(dynamic, 64)
+        for (int c = 0; c < coarseNodes; ++c) {
+            if (restriction[c].empty()) {
+                rows[c].push_back(std::make_pair(c, Complex(1.0, 0.0)));
+                continue;
+            }
+            touched.clear();
+            for (const std::pair<int, double>& rp : restriction[c]) {
+                const int r = rp.first;
+                for (int k = fine.a.rowStart[r]; k < fine.a.rowStart[r + 1]; ++k) {
+                    const int f = fine.a.cols[k];
+                    const Complex av = rp.second * fine.a.values[k];
+                    for (int q = fine.prolongStart[f]; q < fine.prolongStart[f + 1]; ++q) {
+                        const int cc = fine.prolongCols[q];
+                        if (accumulator[cc] == 0.0) touched.push_back(cc);
+                        accumulator[cc] += av * fine.prolongValues[q];
+                    }
+                }
+            }
+            for (int cc : touched) {
+                if (accumulator[cc] != 0.0) rows[c].push_back(std::make_pair(cc, accumulator[cc]));
+                accumulator[cc] = 0.0;
+            }
+        }
+    }
+    compress(rows, coarse.a.rowStart, coarse.a.cols, coarse.a.values);
+}
+
+// Builds the grid hierarchy and the drive for the given frequency.
+void PlateMultigrid::setup(float frequency) {
+    const int intervals = std::max(INTERVAL_MULTIPLE,
+        (resolution - 1 + INTERVAL_MULTIPLE - 1) / INTERVAL_MULTIPLE * INTERVAL_MULTIPLE);
+    resolution = intervals + 1;
+
+    const double thickness = PLATE_THICKNESS;
+    const double rigidity = PLATE_YOUNGS_MODULUS * thickness * thickness * thickness /
+                            (12.0 * (1.0 - PLATE_POISSON_RATIO * PLATE_POISSON_RATIO));
+    const double kappa = std::sqrt(rigidity / (PLATE_DENSITY * thickness));
+    const double omega = 2.0 * PI * frequency;
+    const double dx = PLATE_SIDE / intervals;
+    const double waveNumber = omega * dx * dx / kappa;
+    const double shift = waveNumber * waveNumber;
+
+    // Finest grid, then halve while the coarse grid still resolves the wave.
+    grids.assign(1, Level());
+    grids[0].n = resolution;
+    assembleFine(grids[0], -shift, shift / qualityFactor);
+    double coarseShift = shift;
+    while (true) {
+        const int n = grids.back().n;
+        coarseShift *= 16.0;
+        if ((n - 1) % 2 != 0 || (n - 1) / 2 + 1 < MIN_COARSE_NODES || coarseShift > MAX_COARSE_SHIFT) break;
+        Level coarse;
+        coarse.n = (n - 1) / 2 + 1;
+        buildProlongation(grids.back(), coarse.n);
+        galerkin(grids.back(), coarse);
+        grids.push_back(coarse);
+    }
+    levels = static_cast<int>(grids.size());
+
+    for (Level& level : grids) {
+        const int nodes = level.n * level.n;
+        level.u.assign(nodes, Complex(0.0, 0.0));
+        level.f.assign(nodes, Complex(0.0, 0.0));
+        level.r.assign(nodes, Complex(0.0, 0.0));
+        level.inverseDiagonal.assign(nodes, Complex(1.0, 0.0));
+        level.a.reach = 0;
+        for (int row = 0; row < nodes; ++row) {
+            for (int k = level.a.rowStart[row]; k < level.a.rowStart[row + 1]; ++k) {
+                const int col = level.a.cols[k];
+                if (col == row) level.inverseDiagonal[row] = 1.0 / level.a.values[k];
+                level.a.reach = std::max(level.a.reach, std::max(std::abs(col % level.n - row % level.n),
+                                                                 std::abs(col / level.n - row / level.n)));
+            }
+        }
+    }
+
+    // Point force at the driver. A prescribed displacement there, as in
+    // PlateSolver, gives the same field up to a complex scale.
+    const int n0 = grids[0].n;
+    int driveI = std::min(n0 - 1, std::max(0, static_cast<int>(std::round(driveX * (n0 - 1)))));
+    int driveJ = std::min(n0 - 1, std::max(0, static_cast<int>(std::round(driveY * (n0 - 1)))));
+    if (!active(n0, driveI, driveJ)) {
+        driveI = std::min(n0 - 2, std::max(1, driveI));
+        driveJ = std::min(n0 - 2, std::max(1, driveJ));
+    }
+    grids[0].f[driveJ * n0 + driveI] = 1.0;
+}
+
+// Multicolour Gauss-Seidel. Nodes whose indices agree modulo reach + 1 on
+// both axes never share a row of the operator, so each colour is updated in parallel.
+void PlateMultigrid::smooth(Level& level, int sweeps) const {
+    const int n = level.n;
+    const int m = level.a.reach + 1;
+    const Matrix& a = level.a;
+
+    for (int sweep = 0; sweep < sweeps; ++sweep) {
+        for (int color = 0; color < m * m; ++color) {
+            const int ci = color % m, cj = color / m;
+            #pragma omp parallel for schedule(static)
+            for (int j = cj; j < n; j += m) {
+                for (int i = ci; i < n; i += m) {
+                    const int row = j * n + i;
+                    Complex residual = level.f[row];
+                    for (int k = a.rowStart[row]; k < a.rowStart[row + 1]; ++k) {
+                        residual -= a.values[k] * level.u[a.cols[k]];
+                    }
+                    level.u[row] += level.inverseDiagonal[row] * residual;
+                }
+            }
+        }
+    }
+}
+
+// r = f - A u. Returns the residual norm.
+double PlateMultigrid::computeResidual(Level& level) const {
+    const int nodes = level.n * level.n;
+    const Matrix& a = level.a;
+    double total = 0;
+    #pragma omp parallel for schedule(static) reduction(+:total)
+    for (int row = 0; row < nodes; ++row) {
+        Complex residual = level.f[row];
+        for (int k = a.rowStart[row]; k < a.rowStart[row + 1]; ++k) {
+            residual -= a.values[k] * level.u[a.cols[k]];
+        }
+        level.r[row] = residual;
+        total += std::norm(residual);
+    }
+    return std::sqrt(total);
+}
+
+// LU-factors the coarsest operator as a dense matrix with partial pivoting.
+void PlateMultigrid::factorCoarsest() {
+    const Level& level = grids.back();
+    const int size = level.n * level.n;
+    coarseLu.assign(static_cast<size_t>(size) * size, Complex(0.0, 0.0));
+    coarsePivots.resize(size);
+    for (int r = 0; r < size; ++r) {
+        for (int k = level.a.rowStart[r]; k < level.a.rowStart[r + 1]; ++k) {
+            coarseLu[static_cast<size_t>(r) * size + level.a.cols[k]] = level.a.values[k];
+        }
+    }
+
+    for (int c = 0; c < size; ++c) {
+        int pivot = c;
+        for (int r = c + 1; r < size; ++r) {
+            if (std::abs(coarseLu[static_cast<size_t>(r) * size + c]) >
+                std::abs(coarseLu[static_cast<size_t>(pivot) * size + c])) pivot = r;
+        }
+        coarsePivots[c] = pivot;
+        if (pivot != c) {
+            std::swap_ranges(coarseLu.begin() + static_cast<size_t>(c) * size,
+                             coarseLu.begin() + static_cast<size_t>(c + 1) * size,
+                             coarseLu.begin() + static_cast<size_t>(pivot) * size);
+        }
+        const Complex inv = 1.0 / coarseLu[static_cast<size_t>(c) * size + c];
+        const Complex* top = &coarseLu[static_cast<size_t>(c) * size];
+        #pragma omp parallel for schedule(static)
+        for (int r = c + 1; r < size; ++r) {
+            Complex* row = &coarseLu[static_cast<size_t>(r) * size];
+            if (row[c] == 0.0) continue;
+            const Complex factor = row[c] * inv;
+            row[c] = factor;
+            for (int k = c + 1; k < size; ++k) row[k] -= factor * top[k];
+        }
+    }
+}
+
+// Solves the coarsest level exactly with the stored factors.
+void PlateMultigrid::solveCoarsest() {
+    Level& level = grids.back();
+    const int size = level.n * level.n;
+    std::vector<Complex>& x = level.u;
+    x = level.f;
+    // Whole rows, multipliers included, were swapped during factoring, so
+    // apply every swap before the forward substitution.
+    for (int c = 0; c < size; ++c) std::swap(x[c], x[coarsePivots[c]]);
+    for (int c = 0; c < size; ++c) {
+        for (int r = c + 1; r < size; ++r) x[r] -= coarseLu[static_cast<size_t>(r) * size + c] * x[c];
+    }
+    for (int c = size - 1; c >= 0; --c) {
+        for (int k = c + 1; k < size; ++k) x[c] -= coarseLu[static_cast<size_t>(c) * size + k] * x[k];
+        x[c] /= coarseLu[static_cast<size_t>(c) * size + c];
+    }
+}
+
+// One V-cycle starting at the given level.
+void PlateMultigrid::vCycle(int index) {
+    if (index == levels - 1) {
+        solveCoarsest();
+        return;
+    }
+    Level& fine = grids[index];
+    Level& coarse = grids[index + 1];
+    const int fineNodes = fine.n * fine.n;
+
+    smooth(fine, preSmooth);
+    computeResidual(fine);
+
+    // Restrict with P^T, the transpose of the interpolation.
+    std::fill(coarse.f.begin(), coarse.f.end(), Complex(0.0, 0.0));
+    for (int r = 0; r < fineNodes; ++r) {
+        for (int k = fine.prolongStart[r]; k < fine.prolongStart[r + 1]; ++k) {
+            coarse.f[fine.prolongCols[k]] += fine.prolongValues[k] * fine.r[r];
+        }
+    }
+    std::fill(coarse.u.begin(), coarse.u.end(), Complex(0.0, 0.0));
+    vCycle(index + 1);
+
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < fineNodes; ++r) {
+        Complex correction(0.0, 0.0);
+        for (int k = fine.prolongStart[r]; k < fine.prolongStart[r + 1]; ++k) {
+            correction += fine.prolongValues[k] * coarse.u[fine.prolongCols[k]];
+        }
+        fine.u[r] += correction;
+    }
+    smooth(fine, postSmooth);
+}
+
+// y = A x on the finest grid.
+void PlateMultigrid::multiply(const std::vector<Complex>& x, std::vector<Complex>& y) const {
+    const Matrix& a = grids[0].a;
+    const int nodes = grids[0].n * grids[0].n;
+    y.resize(nodes);
+    #pragma omp parallel for schedule(static)
+    for (int row = 0; row < nodes; ++row) {
+        Complex sum(0.0, 0.0);
+        for (int k = a.rowStart[row]; k < a.rowStart[row + 1]; ++k) sum += a.values[k] * x[a.cols[k]];
+        y[row] = sum;
+    }
+}
+
+// z = M^-1 r, one V-cycle from a zero guess.
+void PlateMultigrid::precondition(const std::vector<Complex>& r, std::vector<Complex>& z) {
+    grids[0].f = r;
+    std::fill(grids[0].u.begin(), grids[0].u.end(), Complex(0.0, 0.0));
+    if (levels > 1) {
+        vCycle(0);
+    } else {
+        smooth(grids[0], preSmooth + postSmooth);
+    }
+    z = grids[0].u;
+}
+
+// Complex inner product sum(conj(a) * b).
+static std::complex<double> dot(const std::vector<std::complex<double> >& a,
+                                const std::vector<std::complex<double> >& b) {
+    double re = 0, im = 0;
+    #pragma omp parallel for schedule(static) reduction(+:re, im)
+    for (int k = 0; k < static_cast<int>(a.size()); ++k) {
+        const std::complex<double> p = std::conj(a[k]) * b[k];
+        re += p.real();
+        im += p.imag();
+    }
+    return std::complex<double>(re, im);
+}
+
+// Restarted GMRES, right-preconditioned by one V-cycle per iteration.
+void PlateMultigrid::gmres(const std::vector<Complex>& rhs, std::vector<Complex>& x) {
+    const int nodes = static_cast<int>(rhs.size());
+    const double rhsNorm = std::sqrt(dot(rhs, rhs).real());
+    std::vector<std::vector<Complex> > v(GMRES_RESTART + 1), z(GMRES_RESTART);
+    std::vector<Complex> h(static_cast<size_t>(GMRES_RESTART + 1) * GMRES_RESTART);
+    std::vector<Complex> g(GMRES_RESTART + 1), sines(GMRES_RESTART);
+    std::vector<double> cosines(GMRES_RESTART);
+    std::vector<Complex> w;
+
+    while (cycles < maxCycles && residual > tolerance) {
+        // Restart from the true residual.
+        multiply(x, w);
+        v[0].resize(nodes);
+        for (int k = 0; k < nodes; ++k) v[0][k] = rhs[k] - w[k];
+        const double beta = std::sqrt(dot(v[0], v[0]).real());
+        residual = beta / rhsNorm;
+        if (residual <= tolerance) break;
+        for (Complex& e : v[0]) e /= beta;
+        std::fill(g.begin(), g.end(), Complex(0.0, 0.0));
+        g[0] = beta;
+
+        int j = 0;
+        for (; j < GMRES_RESTART && cycles < maxCycles && residual > tolerance; ++j) {
+            precondition(v[j], z[j]);
+            ++cycles;
+            multiply(z[j], w);
+
+            // Modified Gram-Schmidt against the basis so far.
+            for (int i = 0; i <= j; ++i) {
+                const Complex hij = dot(v[i], w);
+                h[static_cast<size_t>(i) * GMRES_RESTART + j] = hij;
+                for (int k = 0; k < nodes; ++k) w[k] -= hij * v[i][k];
+            }
+            const double norm = std::sqrt(dot(w, w).real());
+            h[static_cast<size_t>(j + 1) * GMRES_RESTART + j] = norm;
+            v[j + 1] = w;
+            if (norm > 0) {
+                for (Complex& e : v[j + 1]) e /= norm;
+            }
+
+            // Apply the earlier rotations to the new column, then zero its subdiagonal.
+            for (int i = 0; i < j; ++i) {
+                Complex& top = h[static_cast<size_t>(i) * GMRES_RESTART + j];
+                Complex& bottom = h[static_cast<size_t>(i + 1) * GMRES_RESTART + j];
+                const Complex t = cosines[i] * top + sines[i] * bottom;
+                bottom = -std::conj(sines[i]) * top + cosines[i] * bottom;
+                top = t;
+            }
+            Complex& diagonal = h[static_cast<size_t>(j) * GMRES_RESTART + j];
+            const double a = std::abs(diagonal);
+            const double rho = std::sqrt(a * a + norm * norm);
+            if (a == 0.0) {
+                cosines[j] = 0.0;
+                sines[j] = 1.0;
+            } else {
+                cosines[j] = a / rho;
+                sines[j] = (diagonal / a) * norm / rho;
+            }
+            diagonal = cosines[j] * diagonal + sines[j] * norm;
+            h[static_cast<size_t>(j + 1) * GMRES_RESTART + j] = 0.0;
+            g[j + 1] = -std::conj(sines[j]) * g[j];
+            g[j] = cosines[j] * g[j];
+            residual = std::abs(g[j + 1]) / rhsNorm;
+        }
+
+        // x += Z y, with y from the triangular system.
+        std::vector<Complex> y(j);
+        for (int i = j - 1; i >= 0; --i) {
+            Complex sum = g[i];
+            for (int k = i + 1; k < j; ++k) sum -= h[static_cast<size_t>(i) * GMRES_RESTART + k] * y[k];
+            y[i] = sum / h[static_cast<size_t>(i) * GMRES_RESTART + i];
+        }
+        for (int i = 0; i < j; ++i) {
+            for (int k = 0; k < nodes; ++k) x[k] += y[i] * z[i][k];
+        }
+    }
+}
+
+// Solves for the response at the given frequency in Hz.
+bool PlateMultigrid::solve(float frequency) {
+    auto start = std::chrono::steady_clock::now();
+    setup(frequency);
+    if (levels > 1) factorCoarsest();
+
+    residual = 1.0;
+    cycles = 0;
+    if (accelerate) {
+        const std::vector<Complex> rhs = grids[0].f;
+        std::vector<Complex> x(rhs.size(), Complex(0.0, 0.0));
+        gmres(rhs, x);
+        grids[0].f = rhs;
+        grids[0].u = x;
+        residual = computeResidual(grids[0]);
+    } else {
+        while (cycles < maxCycles && residual > tolerance) {
+            if (levels > 1) {
+                vCycle(0);
+            } else {
+                smooth(grids[0], preSmooth + postSmooth);
+            }
+            ++cycles;
+            // The drive is a unit force, so the residual norm is already relative.
+            residual = computeResidual(grids[0]);
+        }
+    }
+    convergenceRate = cycles > 0 ? std::pow(residual, 1.0 / cycles) : 0.0;
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return residual <= tolerance;
+}
+
+// Solves the same system by Gauss-Seidel sweeps on the fine grid alone.
+bool PlateMultigrid::relax(float frequency, int maxSweeps) {
+    auto start = std::chrono::steady_clock::now();
+    setup(frequency);
+    grids.resize(1);
+    levels = 1;
+
+    residual = 1.0;
+    cycles = 0;
+    while (cycles < maxSweeps && residual > tolerance) {
+        smooth(grids[0], 1);
+        ++cycles;
+        // The residual costs as much as a sweep, so only check it now and then.
+        if (cycles % 100 == 0 || cycles == maxSweeps) residual = computeResidual(grids[0]);
+    }
+    convergenceRate = cycles > 0 ? std::pow(residual, 1.0 / cycles) : 0.0;
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return residual <= tolerance;
+}
+
+// Resamples |W| onto a width x height grid, normalised so the largest amplitude is 1.
+void PlateMultigrid::sampleAmplitude(std::vector<float>& out, int width, int height) const {
+    out.resize(static_cast<size_t>(width) * height);
+    if (grids.empty()) {
+        std::fill(out.begin(), out.end(), 0.0f);
+        return;
+    }
+
+    const Level& fine = grids[0];
+    const int n = fine.n;
+    std::vector<float> amplitude(fine.u.size());
+    float peak = 0;
+    for (size_t k = 0; k < fine.u.size(); ++k) {
+        amplitude[k] = static_cast<float>(std::abs(fine.u[k]));
+        peak = std::max(peak, amplitude[k]);
+    }
+    const float norm = peak > 0 ? 1.0f / peak : 0.0f;
+    const float sx = width > 1 ? float(n - 1) / (width - 1) : 0.0f;
+    const float sy = height > 1 ? float(n - 1) / (height - 1) : 0.0f;
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        const float v = y * sy;
+        const int j = std::min(static_cast<int>(v), n - 2);
+        const float fy = v - j;
+        for (int x = 0; x < width; ++x) {
+            const float u = x * sx;
+            const int i = std::min(static_cast<int>(u), n - 2);
+            const float fx = u - i;
+            const float* a = &amplitude[static_cast<size_t>(j) * n + i];
+            const float top = a[0] + (a[1] - a[0]) * fx;
+            const float bottom = a[n] + (a[n + 1] - a[n]) * fx;
+            out[static_cast<size_t>(y) * width + x] = (top + (bottom - top) * fy) * norm;
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+#include <complex>
+#include <vector>
+#include "Plate.h"
+
+// Frequency-domain Kirchhoff-Love plate solver.
+// Solves  D*del^4(W) - rho*h*w^2*(1 - i/Q)*W = F  for the complex amplitude W
+// of the square steel plate of Simulation.h driven at one point, with the same
+// 13-point stencil and edge conditions as PlateSolver. Instead of stepping
+// thousands of periods to steady state, the system is solved directly with
+// geometric multigrid V-cycles: multicolour Gauss-Seidel smoothing, cubic
+// interpolation, Galerkin coarse operators (so every grid sees the fine edge
+// conditions) and a dense LU solve on the coarsest grid.
+// Coarsening stops once the flexural wave is no longer resolved, since
+// smoothing cannot handle the strongly indefinite coarse operators.
+class PlateMultigrid {
+public:
+    int resolution = 97;                // Nodes along each side; resolution - 1 should have many factors of two.
+    PlateEdge edge = PlateEdge::Free;
+    float driveX = 0.5f, driveY = 0.5f; // Driver position as a fraction of the plate side.
+    float qualityFactor = 10.0f;        // Damping expressed as the Q of a mode at the drive frequency.
+    int maxCycles = 30;                 // V-cycles before giving up.
+    double tolerance = 1e-6;            // Residual relative to the drive at which the solve stops.
+    int preSmooth = 2, postSmooth = 2;  // Gauss-Seidel sweeps before and after each coarse correction.
+    bool accelerate = true;             // Use the V-cycle to precondition GMRES rather than iterate it alone.
+
+    // Solves for the response at the given frequency in Hz with V-cycles.
+    // Near resonance the shifted operator is indefinite and a few error
+    // components are amplified by the V-cycle; GMRES removes those, so by
+    // default each cycle is one preconditioned GMRES step.
+    // Returns true if the residual fell below tolerance within maxCycles.
+    bool solve(float frequency);
+
+    // Same system solved by Gauss-Seidel sweeps on the fine grid alone, for
+    // comparison. Returns true if the residual fell below tolerance within maxSweeps.
+    bool relax(float frequency, int maxSweeps);
+
+    // Resamples |W| onto a width x height grid, normalised so the largest amplitude is 1.
+    void sampleAmplitude(std::vector<float>& out, int width, int height) const;
+
+    // Statistics of the last solve or relax.
+    int cycles = 0;              // V-cycles or sweeps performed.
+    int levels = 0;              // Grids in the hierarchy.
+    double residual = 0;         // Final relative residual.
+    double convergenceRate = 0;  // Mean residual reduction per cycle or sweep.
+    double seconds = 0;          // Wall time, including setup.
+
+private:
+    typedef std::complex<double> Complex;
+
+    // Sparse matrix in compressed row storage, over all n*n nodes of a grid.
+    struct Matrix {
+        std::vector<int> rowStart, cols;
+        std::vector<Complex> values;
+        int reach = 0;    // Largest node offset along either axis, which sets the colouring.
+    };
+
+    // One grid of the hierarchy. Nodes are row-major, n per side.
+    struct Level {
+        int n = 0;
+        Matrix a;                               // Operator; constrained nodes have identity rows.
+        std::vector<Complex> u, f, r;           // Solution, right-hand side and residual.
+        std::vector<Complex> inverseDiagonal;
+        std::vector<int> prolongStart, prolongCols;   // Interpolation from the next coarser grid.
+        std::vector<double> prolongValues;
+    };
+
+    void setup(float frequency);
+    bool active(int n, int i, int j) const;
+    void assembleFine(Level& level, double shiftRe, double shiftIm) const;
+    void buildProlongation(Level& fine, int coarseN) const;
+    void galerkin(const Level& fine, Level& coarse) const;
+    void smooth(Level& level, int sweeps) const;
+    double computeResidual(Level& level) const;
+    void factorCoarsest();
+    void solveCoarsest();
+    void vCycle(int level);
+    void multiply(const std::vector<Complex>& x, std::vector<Complex>& y) const;
+    void precondition(const std::vector<Complex>& r, std::vector<Complex>& z);
+    void gmres(const std::vector<Complex>& rhs, std::vector<Complex>& x);
+
+    std::vector<Level> grids;              // Finest first.
+    std::vector<Complex> coarseLu;         // Dense LU of the coarsest operator.
+    std::vector<int> coarsePivots;
+};
+
+#endif // MULTIGRID_H
@@ -0,0 +1,33 @@
+#ifndef PARTICLE_H
+#define PARTICLE_H
+
+#include <cstddef>
+#include <vector>
+
+// Particle structure for representing individual particles in the simulation.
+struct Particle {
+    float x, y;    // Position of the particle.
+    Particle(float x, float y) : x(x), y(y) {}
+};
+
+// Velocities of the particles with the same indices, for the inertial
+// integrator. Kept apart from the positions, one array per axis, so the
+// integrator's arithmetic runs on contiguous floats.
+struct ParticleVelocities {
+    std::vector<float> x, y;
+
+    // Keeps the first count velocities; new ones start at rest.
+    void resize(size_t count) {
+        x.resize(count, 0.0f);
+        y.resize(count, 0.0f);
+    }
+
+    void clear() {
+        x.clear();
+        y.clear();
+    }
+
+    size_t size() const { return x.size(); }
+};
+
+#endif // PARTICLE_H
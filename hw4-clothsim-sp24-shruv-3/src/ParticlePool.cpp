@@ -0,0 +1,151 @@
+#include "ParticlePool.h"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Far outside any window, so parked particles fail every bounds check.
+static const float PARKED = -1.0e9f;
+
+ParticlePool::ParticlePool(size_t capacity, unsigned seed) : gen(seed) {
+    particles.reserve(capacity);
+    velocities.x.reserve(capacity);
+    velocities.y.reserve(capacity);
+    freeSlots.reserve(capacity);
+    scratch.reserve(capacity);
+    velocityScratch.x.reserve(capacity);
+    velocityScratch.y.reserve(capacity);
+}
+
+// Removes every particle and forgets all free slots.
+void ParticlePool::reset() {
+    particles.clear();
+    velocities.clear();
+    invalidateFreeSlots();
+}
+
+// Spawns up to count particles scattered by +-spread around (posX, posY).
+int ParticlePool::spawn(int count, float posX, float posY, float spread) {
+    std::uniform_real_distribution<float> dis(-spread, spread);
+
+    // Particles added without the pool, e.g. by the initial scatter, start at rest too.
+    velocities.resize(particles.size());
+    int spawned = 0;
+    for (; spawned < count; ++spawned) {
+        float x = posX + dis(gen);
+        float y = posY + dis(gen);
+        if (!freeSlots.empty()) {
+            Particle& slot = particles[freeSlots.back()];
+            velocities.x[freeSlots.back()] = 0.0f;
+            velocities.y[freeSlots.back()] = 0.0f;
+            freeSlots.pop_back();
+            slot.x = x;
+            slot.y = y;
+        } else if (particles.size() < particles.capacity()) {
+            particles.emplace_back(x, y);
+            velocities.resize(particles.size());
+        } else {
+            break;
+        }
+    }
+    return spawned;
+}
+
+// Scans up to budget slots for particles that left the window and parks them.
+// The free list is rebuilt from scratch every full sweep, so a slot can never be
+// listed twice.
+void ParticlePool::reclaim(int width, int height, int budget) {
+    if (particles.empty()) return;
+
+    for (int i = 0; i < budget; ++i) {
+        if (sweepCursor >= particles.size()) {
+            sweepCursor = 0;
+            freeSlots.clear();
+        }
+        Particle& p = particles[sweepCursor];
+        if (p.x < 0 || p.x >= width || p.y < 0 || p.y >= height) {
+            p.x = PARKED;
+            p.y = PARKED;
+            freeSlots.push_back(static_cast<int>(sweepCursor));
+        }
+        ++sweepCursor;
+    }
+}
+
+// Drops the free list after the particles were reordered (e.g. sorted).
+void ParticlePool::invalidateFreeSlots() {
+    freeSlots.clear();
+    sweepCursor = 0;
+}
+
+// Removes every particle outside the window, keeping the survivors in order.
+// Each thread counts the survivors in its slice, an exclusive scan over the
+// counts gives every slice its output offset, and the slices are then copied
+// into the scratch buffer in parallel.
+int ParticlePool::compact(int width, int height) {
+    const int numParticles = static_cast<int>(particles.size());
+
+    int maxThreads = 1;
+#ifdef _OPENMP
+    maxThreads = omp_get_max_threads();
+#endif
+    threadOffsets.assign(maxThreads + 1, 0);
+    scratch.resize(numParticles, Particle(0, 0));
+    velocities.resize(numParticles);
+    velocityScratch.resize(numParticles);
+
+    int kept = 0;
+    #pragma omp parallel
+    {
+        int thread = 0, numThreads = 1;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+        numThreads = omp_get_num_threads();
+#endif
+        const int begin = static_cast<int>(static_cast<long long>(numParticles) * thread / numThreads);
+        const int end = static_cast<int>(static_cast<long long>(numParticles) * (thread + 1) / numThreads);
+
+        int count = 0;
+        for (int i = begin; i < end; ++i) {
+            const Particle& p = particles[i];
+            if (p.x >= 0 && p.x < width && p.y >= 0 && p.y < height) ++count;
+        }
+        threadOffsets[thread] = count;
+        #pragma omp barrier
+
+        #pragma omp single
+        {
+            int running = 0;
+            for (int t = 0; t < numThreads; ++t) {
+                int n = threadOffsets[t];
+                threadOffsets[t] = running;
+                running += n;
+            }
+            kept = running;
+        }
+
+        int out = threadOffsets[thread];
+        for (int i = begin; i < end; ++i) {
+            const Particle& p = particles[i];
+            if (p.x >= 0 && p.x < width && p.y >= 0 && p.y < height) {
+                velocityScratch.x[out] = velocities.x[i];
+                velocityScratch.y[out] = velocities.y[i];
+                scratch[out++] = p;
+            }
+        }
+    }
+
+    int removed = numParticles - kept;
+    if (removed > 0) {
+        scratch.resize(kept, Particle(0, 0));
+        particles.swap(scratch);
+        velocityScratch.resize(kept);
+        velocities.x.swap(velocityScratch.x);
+        velocities.y.swap(velocityScratch.y);
+    }
+    // Every slot index may have moved, and every parked slot is gone.
+    invalidateFreeSlots();
+    return removed;
+}
@@ -0,0 +1,54 @@
+#ifndef PARTICLEPOOL_H
+#define PARTICLEPOOL_H
+
+#include <cstddef>
+#include <random>
+#include <vector>
+#include "Particle.h"
+
+// Preallocated particle storage.
+// The particle vector reserves its full capacity up front, so adding particles
+// never reallocates. Particles that leave the window are parked and their slots
+// are handed back out by spawn before the vector grows.
+class ParticlePool {
+public:
+    std::vector<Particle> particles;   // Particle storage, reserved to capacity.
+    ParticleVelocities velocities;     // Velocity of each particle, reserved to capacity. Spawned particles start at rest.
+
+    // seed drives the scatter of spawned particles, so a seeded run spawns alike.
+    ParticlePool(size_t capacity, unsigned seed);
+
+    size_t capacity() const { return particles.capacity(); }
+
+    // Removes every particle and forgets all free slots.
+    void reset();
+
+    // Spawns up to count particles scattered by +-spread around (posX, posY).
+    // Reuses parked slots first, then appends while there is room. Returns the
+    // number of particles actually spawned.
+    int spawn(int count, float posX, float posY, float spread);
+
+    // Scans up to budget slots for particles that left the window and parks
+    // them on the free list. The scan resumes where the previous call stopped.
+    void reclaim(int width, int height, int budget);
+
+    // Drops the free list after the particles were reordered (e.g. sorted).
+    void invalidateFreeSlots();
+
+    // Removes every particle outside the window with a parallel prefix-sum
+    // stream compaction, keeping the survivors in order along with their
+    // velocities. Returns the number of particles removed.
+    int compact(int width, int height);
+
+    size_t freeSlotCount() const { return freeSlots.size(); }
+
+private:
+    std::vector<int> freeSlots;   // Indices of parked particles, reserved to capacity.
+    size_t sweepCursor = 0;       // Next slot reclaim looks at.
+    std::vector<Particle> scratch;   // Compaction target, reserved to capacity.
+    ParticleVelocities velocityScratch;
+    std::vector<int> threadOffsets;  // Survivor count, then output offset, of each thread's slice.
+    std::mt19937 gen;
+};
+
+#endif // PARTICLEPOOL_H
@@ -0,0 +1,225 @@
+#include "Plate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "Simulation.h"
+
+// Tile of nodes updated together, sized so the five rows the stencil touches stay in L1/L2.
+static const int BLOCK_X = 256;
+static const int BLOCK_Y = 16;
+
+// Demodulation samples taken per drive period.
+static const int SAMPLES_PER_PERIOD = 64;
+
+// Fraction of the stability limit used for the time step.
+static const double COURANT = 0.8;
+
+// Fills the two-node halo so the interior stencil sees the edge condition.
+// Columns are done first, then whole rows (halo columns included), which
+// also fills the corners.
+void PlateSolver::applyEdge(float* w) const {
+    const int n = resolution;
+    const int s = stride;
+
+    // Ghost values g1, g2 beyond edge node e, given the first two nodes inside.
+    auto ghosts = [this](float e, float i1, float i2, float& g1, float& g2) {
+        switch (edge) {
+            case PlateEdge::Free:
+                // Zero bending moment (w'' = 0) and zero shear (w''' = 0).
+                g1 = 2 * e - i1;
+                g2 = i2 - 2 * i1 + 2 * g1;
+                break;
+            case PlateEdge::SimplySupported:
+                g1 = -i1;
+                g2 = -i2;
+                break;
+            case PlateEdge::Clamped:
+                g1 = i1;
+                g2 = i2;
+                break;
+        }
+    };
+
+    for (int j = 2; j < n + 2; ++j) {
+        float* row = w + j * s;
+        ghosts(row[2], row[3], row[4], row[1], row[0]);
+        ghosts(row[n + 1], row[n], row[n - 1], row[n + 2], row[n + 3]);
+    }
+    for (int i = 0; i < s; ++i) {
+        float* col = w + i;
+        ghosts(col[2 * s], col[3 * s], col[4 * s], col[1 * s], col[0]);
+        ghosts(col[(n + 1) * s], col[n * s], col[(n - 1) * s], col[(n + 2) * s], col[(n + 3) * s]);
+    }
+}
+
+// Drives the plate at the given frequency in Hz until steady state.
+bool PlateSolver::solve(float frequency) {
+    const int n = std::max(resolution, 8);
+    resolution = n;
+    stride = n + 4;
+
+    // Plate stiffness and the resulting flexural wave constant.
+    const double thickness = PLATE_THICKNESS;
+    const double rigidity = PLATE_YOUNGS_MODULUS * thickness * thickness * thickness /
+                            (12.0 * (1.0 - PLATE_POISSON_RATIO * PLATE_POISSON_RATIO));
+    const double kappa = std::sqrt(rigidity / (PLATE_DENSITY * thickness));
+    const double dx = PLATE_SIDE / (n - 1);
+
+    // Largest stable step for the 13-point stencil is dx^2 / (4 kappa). Round the
+    // step down so a drive period is a whole number of demodulation samples.
+    const double period = 1.0 / frequency;
+    const double maxDt = COURANT * dx * dx / (4.0 * kappa);
+    const int sampleEvery = std::max(1, static_cast<int>(std::ceil(period / maxDt / SAMPLES_PER_PERIOD)));
+    const int stepsPerPeriod = sampleEvery * SAMPLES_PER_PERIOD;
+    const double dt = period / stepsPerPeriod;
+
+    const double omega = 2.0 * PI * frequency;
+    const float damping = static_cast<float>(0.5 * omega / qualityFactor * dt);
+    const float coef = static_cast<float>(kappa * kappa * dt * dt / (dx * dx * dx * dx));
+    const float keep = 1.0f - damping;
+    const float invScale = 1.0f / (1.0f + damping);
+
+    const size_t cells = static_cast<size_t>(stride) * stride;
+    for (int b = 0; b < 3; ++b) buffers[b].assign(cells, 0.0f);
+    inPhase.assign(cells, 0.0f);
+    quadrature.assign(cells, 0.0f);
+    amplitude.assign(cells, 0.0f);
+    std::vector<float> lastAmplitude(cells, 0.0f);
+
+    const int driveI = std::min(n - 1, std::max(0, static_cast<int>(std::round(driveX * (n - 1)))));
+    const int driveJ = std::min(n - 1, std::max(0, static_cast<int>(std::round(driveY * (n - 1)))));
+    const int driveIndex = (driveJ + 2) * stride + driveI + 2;
+
+    // Constrained edges keep their nodes at zero, so only the inside is stepped.
+    const int lo = edge == PlateEdge::Free ? 0 : 1;
+    const int hi = edge == PlateEdge::Free ? n : n - 1;
+    const int blocksX = (hi - lo + BLOCK_X - 1) / BLOCK_X;
+    const int blocksY = (hi - lo + BLOCK_Y - 1) / BLOCK_Y;
+
+    float* prev = buffers[0].data();
+    float* cur = buffers[1].data();
+    float* next = buffers[2].data();
+    float* sumI = inPhase.data();
+    float* sumQ = quadrature.data();
+    const int s = stride;
+
+    steps = 0;
+    periods = 0;
+    bool converged = false;
+    auto start = std::chrono::steady_clock::now();
+
+    while (periods < maxPeriods && !converged) {
+        std::fill(inPhase.begin(), inPhase.end(), 0.0f);
+        std::fill(quadrature.begin(), quadrature.end(), 0.0f);
+        const long long firstStep = steps;
+
+        #pragma omp parallel
+        {
+            for (int step = 0; step < stepsPerPeriod; ++step) {
+                #pragma omp single
+                applyEdge(cur);
+
+                const double t = (firstStep + step + 1) * dt;
+                const bool sample = (step + 1) % sampleEvery == 0;
+                const float c = static_cast<float>(std::cos(omega * t));
+                const float sn = static_cast<float>(std::sin(omega * t));
+
+                #pragma omp for collapse(2) schedule(static)
+                for (int by = 0; by < blocksY; ++by) {
+                    for (int bx = 0; bx < blocksX; ++bx) {
+                        const int j0 = lo + by * BLOCK_Y, j1 = std::min(hi, j0 + BLOCK_Y);
+                        const int i0 = lo + bx * BLOCK_X, i1 = std::min(hi, i0 + BLOCK_X);
+                        for (int j = j0; j < j1; ++j) {
+                            const int rowStart = (j + 2) * s + 2;
+                            #pragma omp simd
+                            for (int i = i0; i < i1; ++i) {
+                                const int k = rowStart + i;
+                                const float lap2 = 20.0f * cur[k]
+                                    - 8.0f * (cur[k - 1] + cur[k + 1] + cur[k - s] + cur[k + s])
+                                    + 2.0f * (cur[k - s - 1] + cur[k - s + 1] + cur[k + s - 1] + cur[k + s + 1])
+                                    + (cur[k - 2] + cur[k + 2] + cur[k - 2 * s] + cur[k + 2 * s]);
+                                const float w = (2.0f * cur[k] - keep * prev[k] - coef * lap2) * invScale;
+                                next[k] = w;
+                                if (sample) {
+                                    sumI[k] += w * c;
+                                    sumQ[k] += w * sn;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                #pragma omp single
+                {
+                    next[driveIndex] = static_cast<float>(std::sin(omega * t));
+                    float* oldest = prev;
+                    prev = cur;
+                    cur = next;
+                    next = oldest;
+                }
+            }
+        }
+        steps += stepsPerPeriod;
+        ++periods;
+
+        // Amplitude of the response at the drive frequency over this period.
+        double total = 0, change = 0;
+        const float scale = 2.0f / SAMPLES_PER_PERIOD;
+        for (size_t k = 0; k < cells; ++k) {
+            float a = scale * std::sqrt(sumI[k] * sumI[k] + sumQ[k] * sumQ[k]);
+            amplitude[k] = a;
+            total += a;
+            change += std::abs(a - lastAmplitude[k]);
+        }
+        amplitude[driveIndex] = 1.0f;
+        converged = periods > 1 && total > 0 && change < tolerance * total;
+        lastAmplitude.swap(amplitude);
+    }
+    amplitude.swap(lastAmplitude);
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return converged;
+}
+
+// Resamples the steady-state amplitude onto a width x height grid.
+void PlateSolver::sampleAmplitude(std::vector<float>& out, int width, int height) const {
+    out.resize(static_cast<size_t>(width) * height);
+    if (amplitude.empty()) {
+        std::fill(out.begin(), out.end(), 0.0f);
+        return;
+    }
+
+    const int n = resolution;
+    float peak = 0;
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < n; ++i) {
+            peak = std::max(peak, amplitude[(j + 2) * stride + i + 2]);
+        }
+    }
+    const float norm = peak > 0 ? 1.0f / peak : 0.0f;
+    const float sx = width > 1 ? float(n - 1) / (width - 1) : 0.0f;
+    const float sy = height > 1 ? float(n - 1) / (height - 1) : 0.0f;
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        const float v = y * sy;
+        const int j = std::min(static_cast<int>(v), n - 2);
+        const float fy = v - j;
+        for (int x = 0; x < width; ++x) {
+            const float u = x * sx;
+            const int i = std::min(static_cast<int>(u), n - 2);
+            const float fx = u - i;
+            const float* a = &amplitude[(j + 2) * stride + i + 2];
+            const float top = a[0] + (a[1] - a[0]) * fx;
+            const float bottom = a[stride] + (a[stride + 1] - a[stride]) * fx;
+            out[static_cast<size_t>(y) * width + x] = (top + (bottom - top) * fy) * norm;
+        }
+    }
+}
+
+// Node updates per second in the last solve.
+double PlateSolver::cellsPerSecond() const {
+    if (seconds <= 0) return 0;
+    return static_cast<double>(steps) * resolution * resolution / seconds;
+}
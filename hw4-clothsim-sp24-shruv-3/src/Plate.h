@@ -0,0 +1,54 @@
+#ifndef PLATE_H
+#define PLATE_H
+
+#include <vector>
+
+// Boundary condition on the outer edge of the plate.
+enum class PlateEdge {
+    Free,             // No moment or shear at the edge (a classic Chladni plate).
+    SimplySupported,  // Zero displacement and zero bending moment.
+    Clamped           // Zero displacement and zero slope.
+};
+
+// Time-domain Kirchhoff-Love plate solver.
+// Integrates  rho*h*w_tt + c*w_t + D*del^4(w) = 0  on the square steel plate of
+// Simulation.h with a finite-difference (13-point biharmonic) stencil and
+// central differences in time. The driver holds one node at A*sin(2*pi*f*t),
+// like the stem of a real Chladni plate. The plate is run until the amplitude
+// at the drive frequency stops changing from one period to the next, and that
+// amplitude is what replaces the analytic vibration field.
+class PlateSolver {
+public:
+    int resolution = 96;                // Nodes along each side of the solver grid.
+    PlateEdge edge = PlateEdge::Free;
+    float driveX = 0.5f, driveY = 0.5f; // Driver position as a fraction of the plate side.
+    float qualityFactor = 10.0f;        // Damping expressed as the Q of a mode at the drive frequency.
+    int maxPeriods = 40;                // Stop after this many drive periods even if not steady.
+    float tolerance = 0.01f;            // Relative amplitude change per period that counts as steady.
+
+    // Drives the plate at the given frequency in Hz until steady state.
+    // Returns true if the amplitude settled within maxPeriods.
+    bool solve(float frequency);
+
+    // Resamples the steady-state amplitude onto a width x height grid,
+    // normalised so the largest amplitude is 1.
+    void sampleAmplitude(std::vector<float>& out, int width, int height) const;
+
+    // Statistics of the last solve.
+    long long steps = 0;     // Time steps taken.
+    int periods = 0;         // Drive periods simulated.
+    double seconds = 0;      // Wall time spent stepping.
+
+    // Node updates per second in the last solve.
+    double cellsPerSecond() const;
+
+private:
+    void applyEdge(float* w) const;
+
+    int stride = 0;                   // Row length of the padded grids.
+    std::vector<float> buffers[3];    // Previous, current and next displacement, with a two-node halo.
+    std::vector<float> inPhase, quadrature; // Running demodulation sums at the drive frequency.
+    std::vector<float> amplitude;     // Amplitude per node from the last full period.
+};
+
+#endif // PLATE_H
@@ -0,0 +1,39 @@
+#include "PngDump.h"
+
+#include <cstring>
+#include "CGL/lodepng.h"
+
+// Encodes an RGBA8 image, top row first, into png.
+bool encodePng(std::vector<unsigned char>& png, const std::vector<uint8_t>& rgba, int width, int height, bool fast,
+               std::string& error) {
+    lodepng::State state;
+    if (fast) lodepng_compress_settings_init_fast(&state.encoder.zlibsettings);
+    // Frames are already RGBA8; skip the search for a smaller colour type.
+    state.encoder.auto_convert = 0;
+    png.clear();
+    unsigned status = lodepng::encode(png, rgba, width, height, state);
+    if (status) {
+        error = lodepng_error_text(status);
+        return false;
+    }
+    return true;
+}
+
+// Flips the frame to top row first, encodes it and saves it.
+bool writePng(const std::string& filename, const std::vector<uint8_t>& rgba, int width, int height, bool fast,
+              std::string& error) {
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> flipped(rgba.size());
+    for (int y = 0; y < height; ++y) {
+        std::memcpy(&flipped[static_cast<size_t>(y) * rowBytes], &rgba[static_cast<size_t>(height - 1 - y) * rowBytes],
+                    rowBytes);
+    }
+    std::vector<unsigned char> png;
+    if (!encodePng(png, flipped, width, height, fast, error)) return false;
+    unsigned status = lodepng::save_file(png, filename);
+    if (status) {
+        error = lodepng_error_text(status);
+        return false;
+    }
+    return true;
+}
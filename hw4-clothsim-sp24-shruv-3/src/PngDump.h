@@ -0,0 +1,18 @@
+#ifndef PNGDUMP_H
+#define PNGDUMP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes an RGBA8 frame as PNG, rows given bottom first as glReadPixels
+// returns them. fast uses lodepng's frame-dump preset: a shallow match search
+// and filtering and deflate spread over every OpenMP thread.
+bool writePng(const std::string& filename, const std::vector<uint8_t>& rgba, int width, int height, bool fast,
+              std::string& error);
+
+// Encodes an RGBA8 image, top row first, into png. Used by writePng and the benchmark.
+bool encodePng(std::vector<unsigned char>& png, const std::vector<uint8_t>& rgba, int width, int height, bool fast,
+               std::string& error);
+
+#endif // PNGDUMP_H
@@ -0,0 +1,450 @@
+#include "Regression.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <vector>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "CGL/lodepng.h"
+#include "CircularPlate.h"
+#include "Boundary.h"
+#include "FieldExr.h"
+#include "Integrator.h"
+#include "Json.h"
+#include "MortonSort.h"
+#include "Session.h"
+#include "Simulation.h"
+#include "SpatialGrid.h"
+#include "Superposition.h"
+
+// Grid, particles and frames of every case. Goldens made with other values are rejected.
+static const int REGRESSION_WIDTH = 640;
+static const int REGRESSION_HEIGHT = 480;
+static const int REGRESSION_PARTICLES = 20000;
+static const int REGRESSION_FRAMES = 300;
+
+// Repulsion of the app-path case, as main's defaults.
+static const float REGRESSION_RADIUS = 1.5f;
+static const float REGRESSION_REPULSION = 0.5f;
+
+// Timings are the fastest of this many runs of each stage, after one untimed run.
+static const int REGRESSION_REPEATS = 5;
+
+// Allowed slowdown written into a new baseline.
+static const double DEFAULT_THRESHOLD_PERCENT = 25.0;
+
+// Slowdowns smaller than this are timer noise, whatever their percentage.
+static const double TIMING_FLOOR_MS = 0.5;
+
+// Field tolerance: largest vibration difference, and share of cells whose gradient may point elsewhere.
+static const float FIELD_TOLERANCE = 1e-4f;
+static const double GRADIENT_TOLERANCE = 0.001;
+
+// Density images count particles in square cells of this side, scaled so the mean count is DENSITY_MEAN_LEVEL.
+static const int DENSITY_CELL = 4;
+static const float DENSITY_MEAN_LEVEL = 32.0f;
+
+// Density tolerance: mean absolute difference in levels, and share of cells differing by more than DENSITY_OUTLIER.
+static const double DENSITY_MEAN_TOLERANCE = 3.0;
+static const int DENSITY_OUTLIER = 48;
+static const double DENSITY_OUTLIER_TOLERANCE = 0.02;
+
+// Where a case's field comes from.
+enum class CaseSource { Analytic, Superposed, Circular };
+
+// One fixed regression case.
+struct RegressionCase {
+    const char* name;
+    CaseSource source;
+    std::vector<ChladniParams> modes;   // Square-plate modes, summed for Superposed.
+    CircularMode circular;              // Mode of the Circular case.
+    int seed;                           // Session id, which seeds the particles and their jitter.
+    bool appPath;                       // Step as main does: random walk, repulsion, boundary and Morton sort.
+};
+
+// The cases, spelled out so a change to the built-in mode lists cannot change them.
+static std::vector<RegressionCase> regressionCases() {
+    std::vector<RegressionCase> cases;
+    cases.push_back({"analytic_1_4", CaseSource::Analytic, {ChladniParams(1, 4, L2)}, CircularMode(0, 1), 1, false});
+    cases.push_back({"analytic_3_7", CaseSource::Analytic, {ChladniParams(3, 7, L2)}, CircularMode(0, 1), 2, false});
+    cases.push_back({"superposed_3", CaseSource::Superposed,
+                     {ChladniParams(2, 3, L2), ChladniParams(2, 4, L2), ChladniParams(1, 5, L2)}, CircularMode(0, 1), 3,
+                     false});
+    cases.push_back({"circular_2_2", CaseSource::Circular, {}, CircularMode(2, 2), 4, false});
+    cases.push_back({"app_path_2_5", CaseSource::Analytic, {ChladniParams(2, 5, L2)}, CircularMode(0, 1), 5, true});
+    return cases;
+}
+
+// What one case produced.
+struct CaseResult {
+    Simulation sim;
+    std::vector<Particle> particles;
+    std::vector<unsigned char> density;
+    uint64_t fieldChecksum = 0, gradientChecksum = 0, particleChecksum = 0;
+    double fieldMs = 0, gradientMs = 0, particleMs = 0;
+};
+
+// 64-bit FNV-1a over raw bytes.
+static uint64_t checksum(const void* data, size_t bytes) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < bytes; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string hex(uint64_t value) {
+    char text[20];
+    snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+    return text;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Builds the case's vibration field into sim.
+static void buildField(const RegressionCase& c, Simulation& sim) {
+    switch (c.source) {
+        case CaseSource::Analytic:
+            sim.computeVibrationValues(c.modes[0], 0.0f, 0.0f);
+            break;
+        case CaseSource::Superposed: {
+            ModeSuperposition superposition;
+            superposition.resize(sim.width, sim.height);
+            superposition.evaluate(c.modes, std::vector<float>(c.modes.size(), 1.0f), sim.vibrationValues);
+            break;
+        }
+        case CaseSource::Circular: {
+            CircularPlate plate;
+            plate.precompute(std::vector<CircularMode>(1, c.circular));
+            plate.sampleMode(c.circular, sim.vibrationValues, sim.width, sim.height);
+            break;
+        }
+    }
+}
+
+// Particle counts per cell, scaled so the mean cell sits at DENSITY_MEAN_LEVEL.
+static std::vector<unsigned char> densityImage(const std::vector<Particle>& particles, int width, int height) {
+    const int cellsX = width / DENSITY_CELL, cellsY = height / DENSITY_CELL;
+    std::vector<int> counts(static_cast<size_t>(cellsX) * cellsY, 0);
+    for (const Particle& p : particles) {
+        const int cx = static_cast<int>(p.x) / DENSITY_CELL, cy = static_cast<int>(p.y) / DENSITY_CELL;
+        if (p.x < 0 || p.y < 0 || cx >= cellsX || cy >= cellsY) continue;
+        ++counts[static_cast<size_t>(cy) * cellsX + cx];
+    }
+    const float mean = static_cast<float>(particles.size()) / counts.size();
+    std::vector<unsigned char> image(counts.size());
+    // Rows top first, as the PNG stores them.
+    for (int y = 0; y < cellsY; ++y) {
+        for (int x = 0; x < cellsX; ++x) {
+            const float level = counts[static_cast<size_t>(cellsY - 1 - y) * cellsX + x] * DENSITY_MEAN_LEVEL / mean;
+            image[static_cast<size_t>(y) * cellsX + x] = static_cast<unsigned char>(std::min(255.0f, level + 0.5f));
+        }
+    }
+    return image;
+}
+
+// Moves the particles through the steps main runs with collisions on and a
+// reflecting boundary, jitter seeded per frame from the case's seed.
+static void stepAppPath(const RegressionCase& c, const Simulation& sim, std::vector<Particle>& particles) {
+    SpatialGrid grid;
+    MortonSorter sorter;
+    const JitterSchedule schedule;
+    for (int frame = 0; frame < REGRESSION_FRAMES; ++frame) {
+        const uint32_t seed = particleHash(static_cast<uint32_t>(c.seed) * 0x9e3779b9U + static_cast<uint32_t>(frame));
+        jitterStep(particles.data(), 0, particles.size(), sim.gradients.data(), sim.vibrationValues.data(),
+                   sim.width, sim.height, 0.2f, schedule, 1.0f, seed);
+        grid.build(particles, sim.width, sim.height, REGRESSION_RADIUS);
+        applyRepulsion(particles, grid, REGRESSION_RADIUS, REGRESSION_REPULSION);
+        applyBoundary(particles, sim.width, sim.height, BoundaryPolicy::Reflect);
+        sorter.update(particles, sim.width, sim.height);
+    }
+}
+
+// Runs one case once, keeping the fastest time of each stage so far.
+static void runCase(const RegressionCase& c, CaseResult& result) {
+    result.sim.width = REGRESSION_WIDTH;
+    result.sim.height = REGRESSION_HEIGHT;
+    auto start = std::chrono::steady_clock::now();
+    buildField(c, result.sim);
+    result.fieldMs = std::min(result.fieldMs, millisecondsSince(start));
+
+    start = std::chrono::steady_clock::now();
+    result.sim.computeGradients();
+    result.gradientMs = std::min(result.gradientMs, millisecondsSince(start));
+
+    std::shared_ptr<ModeField> field(new ModeField);
+    field->width = result.sim.width;
+    field->height = result.sim.height;
+    field->vibrationValues = result.sim.vibrationValues;
+    field->gradients = result.sim.gradients;
+    PlateSession session(c.seed, REGRESSION_WIDTH, REGRESSION_HEIGHT, REGRESSION_PARTICLES);
+    session.field = field;
+    start = std::chrono::steady_clock::now();
+    if (c.appPath) {
+        stepAppPath(c, result.sim, session.particles);
+    } else {
+        for (int frame = 0; frame < REGRESSION_FRAMES; ++frame) {
+            session.update(0, session.particles.size());
+            ++session.frame;
+        }
+    }
+    result.particleMs = std::min(result.particleMs, millisecondsSince(start));
+    result.particles.swap(session.particles);
+}
+
+// Checksums and density image of a case's last run.
+static void summarizeCase(CaseResult& result) {
+    const std::vector<float>& values = result.sim.vibrationValues;
+    const std::vector<Gradient>& gradients = result.sim.gradients;
+    result.fieldChecksum = checksum(values.data(), values.size() * sizeof(float));
+    result.gradientChecksum = checksum(gradients.data(), gradients.size() * sizeof(Gradient));
+    result.particleChecksum = checksum(result.particles.data(), result.particles.size() * sizeof(Particle));
+    result.density = densityImage(result.particles, REGRESSION_WIDTH, REGRESSION_HEIGHT);
+}
+
+// Compares a field with its golden EXR. Returns a short verdict and sets failed.
+static std::string compareField(const CaseResult& result, const std::string& filename, bool& failed) {
+    ExrField golden;
+    std::string error;
+    if (!readTiledExr(filename, golden, error)) {
+        failed = true;
+        return "FAIL (" + error + ")";
+    }
+    const std::vector<float>* vibration = golden.channel("vibration");
+    const std::vector<float>* dx = golden.channel("dx");
+    const std::vector<float>* dy = golden.channel("dy");
+    const int width = result.sim.width, height = result.sim.height;
+    if (!vibration || !dx || !dy || golden.width != width || golden.height != height) {
+        failed = true;
+        return "FAIL (golden EXR has other channels or size)";
+    }
+
+    float largest = 0;
+    long long turned = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const size_t exrIndex = static_cast<size_t>(height - 1 - y) * width + x;
+            const size_t simIndex = static_cast<size_t>(y) * width + x;
+            largest = std::max(largest, std::abs((*vibration)[exrIndex] - result.sim.vibrationValues[simIndex]));
+            const Gradient& g = result.sim.gradients[simIndex];
+            turned += (*dx)[exrIndex] != g.dx || (*dy)[exrIndex] != g.dy;
+        }
+    }
+    const double turnedShare = static_cast<double>(turned) / (static_cast<double>(width) * height);
+    failed = !(largest <= FIELD_TOLERANCE) || turnedShare > GRADIENT_TOLERANCE;
+    char text[96];
+    snprintf(text, sizeof(text), "%s (max %.1e, %.2f%% turned)", failed ? "FAIL" : "close", largest, 100 * turnedShare);
+    return text;
+}
+
+// Compares a density image with its golden PNG. Returns a short verdict and sets failed.
+static std::string compareDensity(const std::vector<unsigned char>& density, const std::string& filename,
+                                  bool& failed) {
+    std::vector<unsigned char> golden;
+    unsigned w = 0, h = 0;
+    const unsigned status = lodepng::decode(golden, w, h, filename, LCT_GREY, 8);
+    if (status || golden.size() != density.size()) {
+        failed = true;
+        return status ? std::string("FAIL (") + lodepng_error_text(status) + ")" : "FAIL (golden PNG has another size)";
+    }
+    double total = 0;
+    long long outliers = 0;
+    for (size_t i = 0; i < density.size(); ++i) {
+        const int difference = std::abs(static_cast<int>(density[i]) - static_cast<int>(golden[i]));
+        total += difference;
+        outliers += difference > DENSITY_OUTLIER;
+    }
+    const double mean = total / density.size();
+    const double outlierShare = static_cast<double>(outliers) / density.size();
+    failed = mean > DENSITY_MEAN_TOLERANCE || outlierShare > DENSITY_OUTLIER_TOLERANCE;
+    char text[96];
+    snprintf(text, sizeof(text), "%s (mean %.2f, %.2f%% off)", failed ? "FAIL" : "close", mean, 100 * outlierShare);
+    return text;
+}
+
+// Creates the golden directory if it does not exist.
+static bool makeDirectory(const std::string& directory) {
+    struct stat info;
+    if (stat(directory.c_str(), &info) == 0) return true;
+#ifdef _WIN32
+    return _mkdir(directory.c_str()) == 0;
+#else
+    return mkdir(directory.c_str(), 0755) == 0;
+#endif
+}
+
+// A checksum string of a golden.json case, or "" if absent.
+static std::string goldenChecksum(const JsonValue* goldenCase, const char* key) {
+    const JsonValue* value = goldenCase ? goldenCase->find(key) : nullptr;
+    return value && value->type == JsonValue::Type::String ? value->string : "";
+}
+
+// Runs every case and checks it against the goldens, or rewrites them.
+bool runRegression(const std::string& directory, bool update, std::ostream& out) {
+    const std::string prefix = directory + "/";
+    const std::vector<RegressionCase> cases = regressionCases();
+    std::vector<CaseResult> results(cases.size());
+    // One untimed pass warms caches and clocks, then the repeats go round the
+    // cases so that a slow spell of the machine is shared between them.
+    for (size_t i = 0; i < cases.size(); ++i) runCase(cases[i], results[i]);
+    for (CaseResult& r : results) r.fieldMs = r.gradientMs = r.particleMs = 1e30;
+    for (int repeat = 0; repeat < REGRESSION_REPEATS; ++repeat) {
+        for (size_t i = 0; i < cases.size(); ++i) runCase(cases[i], results[i]);
+    }
+    for (CaseResult& r : results) summarizeCase(r);
+
+    // Stage timings in a fixed order.
+    std::vector<std::pair<std::string, double> > timings;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const std::string name = cases[i].name;
+        timings.push_back(std::make_pair(name + "/field", results[i].fieldMs));
+        timings.push_back(std::make_pair(name + "/gradients", results[i].gradientMs));
+        timings.push_back(std::make_pair(name + "/particles", results[i].particleMs));
+    }
+
+    JsonValue baseline;
+    std::string error;
+    const bool haveBaseline = loadJsonFile(prefix + "baseline.json", baseline, error);
+    double thresholdPercent = DEFAULT_THRESHOLD_PERCENT;
+    if (haveBaseline && baseline.find("threshold_percent") &&
+        baseline.find("threshold_percent")->type == JsonValue::Type::Number) {
+        thresholdPercent = baseline.find("threshold_percent")->number;
+    }
+
+    if (update) {
+        if (!makeDirectory(directory)) {
+            out << "Cannot create " << directory << std::endl;
+            return false;
+        }
+        std::ofstream golden(prefix + "golden.json");
+        golden << "{\n  \"grid\": [" << REGRESSION_WIDTH << ", " << REGRESSION_HEIGHT << "],\n  \"particles\": "
+               << REGRESSION_PARTICLES << ",\n  \"frames\": " << REGRESSION_FRAMES << ",\n  \"cases\": {\n";
+        for (size_t i = 0; i < cases.size(); ++i) {
+            const CaseResult& r = results[i];
+            golden << "    \"" << cases[i].name << "\": {\"field\": \"" << hex(r.fieldChecksum) << "\", \"gradients\": \""
+                   << hex(r.gradientChecksum) << "\", \"particles\": \"" << hex(r.particleChecksum) << "\"}"
+                   << (i + 1 < cases.size() ? "," : "") << "\n";
+
+            FieldExrWriter writer;
+            if (!writer.write(prefix + cases[i].name + ".exr", r.sim, error)) {
+                out << "Cannot write " << prefix << cases[i].name << ".exr: " << error << std::endl;
+                return false;
+            }
+            const unsigned status = lodepng::encode(prefix + cases[i].name + ".png", r.density,
+                                                    REGRESSION_WIDTH / DENSITY_CELL, REGRESSION_HEIGHT / DENSITY_CELL,
+                                                    LCT_GREY, 8);
+            if (status) {
+                out << "Cannot write " << prefix << cases[i].name << ".png: " << lodepng_error_text(status) << std::endl;
+                return false;
+            }
+        }
+        golden << "  }\n}\n";
+
+        std::ofstream timing(prefix + "baseline.json");
+        timing << "{\n  \"threshold_percent\": " << thresholdPercent << ",\n  \"stages_ms\": {\n";
+        for (size_t i = 0; i < timings.size(); ++i) {
+            char value[32];
+            snprintf(value, sizeof(value), "%.4f", timings[i].second);
+            timing << "    \"" << timings[i].first << "\": " << value << (i + 1 < timings.size() ? "," : "") << "\n";
+        }
+        timing << "  }\n}\n";
+        if (!golden || !timing) {
+            out << "Cannot write the goldens in " << directory << std::endl;
+            return false;
+        }
+        out << "Goldens and baseline written to " << directory << " (" << cases.size() << " cases)" << std::endl;
+        return true;
+    }
+
+    JsonValue golden;
+    if (!loadJsonFile(prefix + "golden.json", golden, error)) {
+        out << "No goldens: " << error << ". Run with --update to create them." << std::endl;
+        return false;
+    }
+    const JsonValue* grid = golden.find("grid");
+    const JsonValue* particles = golden.find("particles");
+    const JsonValue* frames = golden.find("frames");
+    if (!grid || grid->items.size() != 2 || grid->items[0].number != REGRESSION_WIDTH ||
+        grid->items[1].number != REGRESSION_HEIGHT || !particles || particles->number != REGRESSION_PARTICLES ||
+        !frames || frames->number != REGRESSION_FRAMES) {
+        out << "The goldens were made with another grid, particle count or frame count; run with --update." << std::endl;
+        return false;
+    }
+
+    bool passed = true;
+    out << "case            field                             particles" << std::endl;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const CaseResult& r = results[i];
+        const JsonValue* goldenCase = golden.find("cases") ? golden.find("cases")->find(cases[i].name) : nullptr;
+        if (!goldenCase) {
+            out << cases[i].name << ": no golden; run with --update" << std::endl;
+            passed = false;
+            continue;
+        }
+
+        bool fieldFailed = false, densityFailed = false;
+        std::string fieldVerdict = "identical";
+        if (goldenChecksum(goldenCase, "field") != hex(r.fieldChecksum) ||
+            goldenChecksum(goldenCase, "gradients") != hex(r.gradientChecksum)) {
+            fieldVerdict = compareField(r, prefix + cases[i].name + ".exr", fieldFailed);
+        }
+        std::string densityVerdict = "identical";
+        if (goldenChecksum(goldenCase, "particles") != hex(r.particleChecksum)) {
+            densityVerdict = compareDensity(r.density, prefix + cases[i].name + ".png", densityFailed);
+        }
+        passed = passed && !fieldFailed && !densityFailed;
+
+        char line[256];
+        snprintf(line, sizeof(line), "%-14s  %-32s  %s", cases[i].name, fieldVerdict.c_str(), densityVerdict.c_str());
+        out << line << std::endl;
+    }
+
+    // The goldens are committed but timings are machine-local, so a fresh
+    // checkout has no baseline: the timings are shown but not checked.
+    if (!haveBaseline) {
+        out << std::endl << "No timing baseline (" << error << "); timings are not checked. Run with --update"
+            << " to record one for this machine." << std::endl;
+    }
+    const JsonValue* stages = haveBaseline ? baseline.find("stages_ms") : nullptr;
+    out << std::endl << "stage                      baseline ms     now ms   change" << std::endl;
+    for (const std::pair<std::string, double>& timing : timings) {
+        const JsonValue* reference = stages ? stages->find(timing.first) : nullptr;
+        char line[256];
+        if (!haveBaseline) {
+            snprintf(line, sizeof(line), "%-25s  %11s  %9.3f", timing.first.c_str(), "-", timing.second);
+        } else if (!reference || reference->type != JsonValue::Type::Number) {
+            // A baseline without this stage is stale, so the stage cannot pass.
+            passed = false;
+            snprintf(line, sizeof(line), "%-25s  %11s  %9.3f   FAIL (no baseline; run with --update)",
+                     timing.first.c_str(), "-", timing.second);
+        } else {
+            const double change = 100.0 * (timing.second - reference->number) / reference->number;
+            const bool slower = change > thresholdPercent && timing.second - reference->number > TIMING_FLOOR_MS;
+            passed = passed && !slower;
+            snprintf(line, sizeof(line), "%-25s  %11.3f  %9.3f  %+6.1f%%%s", timing.first.c_str(), reference->number,
+                     timing.second, change, slower ? "  SLOWER" : "");
+        }
+        out << line << std::endl;
+    }
+    out << std::endl << (passed ? "PASS" : "FAIL");
+    if (haveBaseline) {
+        out << " (timings may be " << thresholdPercent << "% slower than baseline)" << std::endl;
+    } else {
+        out << " (timings unchecked)" << std::endl;
+    }
+    return passed;
+}
@@ -0,0 +1,36 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include <ostream>
+#include <string>
+
+// Golden-image and golden-state regression run.
+// A fixed set of cases (mode, field source, particle seed) is run headlessly.
+// Each case builds its field and gradients, then moves a seeded particle set
+// a fixed number of frames, and timings are taken per stage as the fastest
+// of several repeats. Most cases step with the deterministic PlateSession
+// update; one steps as the app does, with the random walk, repulsion on the
+// spatial grid, a reflecting boundary and the Morton sort. The inertial
+// integrator, annealing, spawning and compaction are not covered.
+//
+// Against the goldens in directory:
+//   golden.json     checksums of every field and particle state,
+//   <case>.exr      the field and gradients, as FieldExrWriter writes them,
+//   <case>.png      the particle density image,
+//   baseline.json   stage timings in ms and the allowed slowdown in percent.
+// The goldens for regress/ are committed; they are deterministic and catch a
+// change of any pattern. The baseline is machine-local and ignored by git.
+// A checksum that matches means the output is bit-identical. One that does
+// not is compared with tolerance: fields sample by sample against the EXR,
+// particles by their density image, since particle paths diverge at the
+// first rounding difference while the pattern they form does not. A stage
+// slower than its baseline by more than the allowed percentage fails too, as
+// does a stage missing from the baseline. Without baseline.json, as on a
+// fresh checkout, timings are printed but not checked.
+//
+// With update, the goldens and the baseline are rewritten from this run; the
+// allowed percentage of an existing baseline is kept.
+// Returns true if every check passed.
+bool runRegression(const std::string& directory, bool update, std::ostream& out);
+
+#endif // REGRESSION_H
@@ -0,0 +1,44 @@
+#include "Renderer.h"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cmath>
+
+// Fits the grid into the framebuffer, centred and undistorted.
+void ViewTransform::fit(int gridW, int gridH, int framebufferW, int framebufferH) {
+    gridWidth = std::max(gridW, 1);
+    gridHeight = std::max(gridH, 1);
+    framebufferWidth = std::max(framebufferW, 1);
+    framebufferHeight = std::max(framebufferH, 1);
+    scale = std::min(static_cast<float>(framebufferWidth) / gridWidth,
+                     static_cast<float>(framebufferHeight) / gridHeight);
+    viewportWidth = std::max(1, static_cast<int>(std::lround(gridWidth * scale)));
+    viewportHeight = std::max(1, static_cast<int>(std::lround(gridHeight * scale)));
+    viewportX = (framebufferWidth - viewportWidth) / 2;
+    viewportY = (framebufferHeight - viewportHeight) / 2;
+}
+
+// Grid position under a framebuffer pixel.
+bool ViewTransform::toGrid(double x, double y, float& gridX, float& gridY) const {
+    gridX = static_cast<float>((x - viewportX) * gridWidth / viewportWidth);
+    gridY = static_cast<float>((y - viewportY) * gridHeight / viewportHeight);
+    return gridX >= 0 && gridX < gridWidth && gridY >= 0 && gridY < gridHeight;
+}
+
+// Draws the particles inside the grid.
+void Renderer::draw(const std::vector<Particle>& particles) const {
+    glViewport(0, 0, view.framebufferWidth, view.framebufferHeight);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glViewport(view.viewportX, view.viewportY, view.viewportWidth, view.viewportHeight);
+
+    const float toX = 2.0f / view.gridWidth, toY = 2.0f / view.gridHeight;
+    glPointSize(std::max(1.0f, std::floor(view.scale)));
+    glBegin(GL_POINTS);
+    for (const auto& particle : particles) {
+        if (particle.x <= 0 || particle.x >= view.gridWidth || particle.y <= 0 || particle.y >= view.gridHeight) {
+            continue;
+        }
+        glVertex2f(particle.x * toX - 1.0f, particle.y * toY - 1.0f);
+    }
+    glEnd();
+}
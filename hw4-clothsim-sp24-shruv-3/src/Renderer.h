@@ -0,0 +1,36 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <vector>
+#include "Particle.h"
+
+// Maps the simulation grid onto the framebuffer. The grid keeps its aspect
+// ratio and is centred, leaving bars where the window's shape differs, so a
+// window of any size shows the whole plate undistorted. The grid never
+// follows the window: resizing changes only this transform.
+struct ViewTransform {
+    int gridWidth = 1, gridHeight = 1;
+    int framebufferWidth = 1, framebufferHeight = 1;
+    int viewportX = 0, viewportY = 0;           // Framebuffer pixel of the grid's lower left corner.
+    int viewportWidth = 1, viewportHeight = 1;  // Framebuffer pixels the grid covers.
+    float scale = 1;                            // Framebuffer pixels per grid cell.
+
+    // Fits a gridWidth x gridHeight grid into a framebufferWidth x framebufferHeight framebuffer.
+    void fit(int gridWidth, int gridHeight, int framebufferWidth, int framebufferHeight);
+
+    // Grid position under framebuffer pixel (x, y), y up. Returns false
+    // outside the grid, e.g. on a bar.
+    bool toGrid(double x, double y, float& gridX, float& gridY) const;
+};
+
+// Draws the particles of the grid through the view transform.
+class Renderer {
+public:
+    ViewTransform view;
+
+    // Clears the framebuffer, bars included, and draws the particles inside
+    // the grid as points of about one cell.
+    void draw(const std::vector<Particle>& particles) const;
+};
+
+#endif // RENDERER_H
@@ -0,0 +1,273 @@
+#include "RunSpec.h"
+
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <sstream>
+#include "Json.h"
+
+// Field sources a spec may name.
+static const char* const fieldSourceNames[] = {"analytic", "fdtd", "multigrid", "mask", "circular", "scan"};
+
+// Largest grid side accepted, to catch unit mistakes before allocating.
+static const int MAX_GRID_SIDE = 16384;
+
+// Reads typed members of one JSON object, naming the offending key in errors.
+class SpecReader {
+public:
+    SpecReader(const JsonValue& object, const std::string& path, std::string& error)
+        : object(object), path(path), error(error) {}
+
+    // Fails unless the value is an object whose keys are all in allowed.
+    bool check(std::initializer_list<const char*> allowed) {
+        if (object.type != JsonValue::Type::Object) return fail(path, "expected an object");
+        for (const auto& member : object.members) {
+            bool known = false;
+            for (const char* key : allowed) known = known || member.first == key;
+            if (!known) return fail(path + "." + member.first, "unknown key");
+        }
+        return true;
+    }
+
+    bool integer(const char* key, int& out, int low, int high) {
+        const JsonValue* value = object.find(key);
+        if (!value) return true;
+        if (!value->isInteger() || value->number < low || value->number > high) {
+            std::ostringstream range;
+            range << "expected an integer from " << low << " to " << high;
+            return fail(path + "." + key, range.str());
+        }
+        out = static_cast<int>(value->number);
+        return true;
+    }
+
+    bool number(const char* key, float& out, float low) {
+        const JsonValue* value = object.find(key);
+        if (!value) return true;
+        if (value->type != JsonValue::Type::Number || value->number < low) {
+            std::ostringstream range;
+            range << "expected a number of at least " << low;
+            return fail(path + "." + key, range.str());
+        }
+        out = static_cast<float>(value->number);
+        return true;
+    }
+
+    bool boolean(const char* key, bool& out) {
+        const JsonValue* value = object.find(key);
+        if (!value) return true;
+        if (value->type != JsonValue::Type::Bool) return fail(path + "." + key, "expected true or false");
+        out = value->boolean;
+        return true;
+    }
+
+    bool string(const char* key, std::string& out) {
+        const JsonValue* value = object.find(key);
+        if (!value) return true;
+        if (value->type != JsonValue::Type::String) return fail(path + "." + key, "expected a string");
+        out = value->string;
+        return true;
+    }
+
+    // The member if present, else nullptr.
+    const JsonValue* child(const char* key) const { return object.find(key); }
+
+    bool fail(const std::string& where, const std::string& what) {
+        error = where + ": " + what;
+        return false;
+    }
+
+private:
+    const JsonValue& object;
+    std::string path;
+    std::string& error;
+};
+
+static bool readGrid(const JsonValue& value, RunSpec& spec, std::string& error) {
+    SpecReader grid(value, "chladni.grid", error);
+    return grid.check({"width", "height"}) && grid.integer("width", spec.width, 16, MAX_GRID_SIDE) &&
+           grid.integer("height", spec.height, 16, MAX_GRID_SIDE);
+}
+
+static bool readField(const JsonValue& value, RunSpec& spec, std::string& error) {
+    SpecReader field(value, "chladni.field", error);
+    if (!field.check({"source", "modes", "mask", "mask_modes", "scans", "audio", "start_pattern", "sweep"}) ||
+        !field.string("source", spec.field) || !field.string("mask", spec.mask) ||
+        !field.integer("mask_modes", spec.maskModes, 1, 1000) || !field.string("audio", spec.audio) ||
+        !field.integer("start_pattern", spec.startPattern, 0, 1 << 20) || !field.boolean("sweep", spec.sweep)) {
+        return false;
+    }
+    if (std::find_if(std::begin(fieldSourceNames), std::end(fieldSourceNames), [&](const char* name) {
+            return spec.field == name;
+        }) == std::end(fieldSourceNames)) {
+        return field.fail("chladni.field.source", "expected analytic, fdtd, multigrid, mask, circular or scan");
+    }
+
+    if (const JsonValue* modes = field.child("modes")) {
+        if (modes->type != JsonValue::Type::Array || modes->items.empty()) {
+            return field.fail("chladni.field.modes", "expected a non-empty array");
+        }
+        spec.modes.clear();
+        for (size_t i = 0; i < modes->items.size(); ++i) {
+            SpecReader mode(modes->items[i], "chladni.field.modes[" + std::to_string(i) + "]", error);
+            int m = 1, n = 2;
+            float l = L2;
+            if (!mode.check({"m", "n", "l"}) || !mode.integer("m", m, 1, 1000) || !mode.integer("n", n, 1, 1000) ||
+                !mode.number("l", l, 0.0f)) {
+                return false;
+            }
+            spec.modes.push_back(ChladniParams(m, n, l));
+        }
+    }
+
+    if (const JsonValue* scans = field.child("scans")) {
+        if (scans->type != JsonValue::Type::Array) return field.fail("chladni.field.scans", "expected an array");
+        spec.scans.clear();
+        for (size_t i = 0; i < scans->items.size(); ++i) {
+            SpecReader scan(scans->items[i], "chladni.field.scans[" + std::to_string(i) + "]", error);
+            ScanSpec entry;
+            if (!scan.check({"file", "frequency"}) || !scan.string("file", entry.file) ||
+                !scan.number("frequency", entry.frequency, 0.0f)) {
+                return false;
+            }
+            if (entry.file.empty()) return scan.fail("chladni.field.scans[" + std::to_string(i) + "].file", "missing");
+            spec.scans.push_back(entry);
+        }
+    }
+    if (spec.field == "mask" && spec.mask.empty()) return field.fail("chladni.field.mask", "needed by the mask source");
+    if (spec.field == "scan" && spec.scans.empty()) return field.fail("chladni.field.scans", "needed by the scan source");
+    return true;
+}
+
+static bool readParticles(const JsonValue& value, RunSpec& spec, std::string& error) {
+    SpecReader particles(value, "chladni.particles", error);
+    int capacity = static_cast<int>(spec.particleCapacity);
+    if (!particles.check({"count", "capacity", "spawn", "integrator", "damping", "anneal", "anneal_half_life"}) ||
+        !particles.integer("capacity", capacity, 1, 1 << 28) ||
+        !particles.integer("count", spec.particleCount, 0, capacity) ||
+        !particles.integer("spawn", spec.spawnCount, 0, capacity) || !particles.string("integrator", spec.integrator) ||
+        !particles.number("damping", spec.damping, 0.0f) || !particles.string("anneal", spec.anneal) ||
+        !particles.number("anneal_half_life", spec.annealHalfLife, 1.0f)) {
+        return false;
+    }
+    if (spec.anneal != "fixed" && spec.anneal != "global" && spec.anneal != "local") {
+        return particles.fail("chladni.particles.anneal", "expected fixed, global or local");
+    }
+    if (spec.integrator != "jitter" && spec.integrator != "inertial") {
+        return particles.fail("chladni.particles.integrator", "expected jitter or inertial");
+    }
+    if (spec.damping >= 1.0f) return particles.fail("chladni.particles.damping", "expected a number below 1");
+    spec.particleCapacity = static_cast<size_t>(capacity);
+    return true;
+}
+
+static bool readPrecompute(const JsonValue& value, RunSpec& spec, std::string& error) {
+    SpecReader precompute(value, "chladni.precompute", error);
+    std::string policy = precomputePolicyName(spec.precompute);
+    if (!precompute.check({"policy", "resident_mb"}) || !precompute.string("policy", policy) ||
+        !precompute.integer("resident_mb", spec.residentMegabytes, 1, 1 << 20)) {
+        return false;
+    }
+    const PrecomputePolicy policies[] = {PrecomputePolicy::None, PrecomputePolicy::Start,
+                                         PrecomputePolicy::Neighbours, PrecomputePolicy::All};
+    for (PrecomputePolicy candidate : policies) {
+        if (policy == precomputePolicyName(candidate)) {
+            spec.precompute = candidate;
+            return true;
+        }
+    }
+    return precompute.fail("chladni.precompute.policy", "expected none, start, neighbours or all");
+}
+
+static bool readClock(const JsonValue& value, RunSpec& spec, std::string& error) {
+    SpecReader clock(value, "chladni.clock", error);
+    return clock.check({"substeps", "fast_forward", "render_every"}) &&
+           clock.integer("substeps", spec.substeps, 1, 1000) && clock.boolean("fast_forward", spec.fastForward) &&
+           clock.integer("render_every", spec.renderEvery, 0, 1 << 20);
+}
+
+static bool readOutputs(const JsonValue& value, RunSpec& spec, std::string& error) {
+    SpecReader outputs(value, "chladni.outputs", error);
+    return outputs.check({"video", "shm", "shm_particles", "control"}) && outputs.string("video", spec.video) &&
+           outputs.string("shm", spec.shm) && outputs.string("shm_particles", spec.shmParticles) &&
+           outputs.string("control", spec.control);
+}
+
+// Reads a run spec from a JSON file.
+bool loadRunSpec(const std::string& filename, RunSpec& spec, std::string& error) {
+    JsonValue document;
+    if (!loadJsonFile(filename, document, error)) return false;
+
+    RunSpec loaded;
+    SpecReader root(document, filename, error);
+    if (!root.check({"chladni"})) return false;
+    const JsonValue* chladni = root.child("chladni");
+    if (!chladni) return root.fail(filename, "missing \"chladni\"");
+
+    SpecReader run(*chladni, "chladni", error);
+    int seed = 0;
+    if (!run.check({"grid", "field", "particles", "seed", "precompute", "clock", "outputs"}) ||
+        !run.integer("seed", seed, 0, 2147483647)) {
+        return false;
+    }
+    loaded.seeded = run.child("seed") != nullptr;
+    loaded.seed = static_cast<unsigned>(seed);
+    if (run.child("grid") && !readGrid(*run.child("grid"), loaded, error)) return false;
+    if (run.child("field") && !readField(*run.child("field"), loaded, error)) return false;
+    if (run.child("particles") && !readParticles(*run.child("particles"), loaded, error)) return false;
+    if (run.child("precompute") && !readPrecompute(*run.child("precompute"), loaded, error)) return false;
+    if (run.child("clock") && !readClock(*run.child("clock"), loaded, error)) return false;
+    if (run.child("outputs") && !readOutputs(*run.child("outputs"), loaded, error)) return false;
+    spec = loaded;
+    return true;
+}
+
+// Plans which fields to build up front and how many to keep.
+FieldPlan planFields(const RunSpec& spec, int patternCount, int startPattern, int width, int height,
+                     const FieldCost& cost, bool usesEveryPattern) {
+    FieldPlan plan;
+    plan.fieldBytes = static_cast<size_t>(width) * height * sizeof(float);
+    if (patternCount <= 0) return plan;
+    startPattern = std::min(std::max(startPattern, 0), patternCount - 1);
+
+    // Order of need: the start, the patterns UP and DOWN crossfade to, then the rest.
+    std::vector<int> order(1, startPattern);
+    auto add = [&](int pattern) {
+        pattern = ((pattern % patternCount) + patternCount) % patternCount;
+        if (std::find(order.begin(), order.end(), pattern) == order.end()) order.push_back(pattern);
+    };
+    add(startPattern + 1);
+    add(startPattern - 1);
+    for (int i = 2; i < patternCount; ++i) add(startPattern + i);
+
+    const size_t budget = static_cast<size_t>(spec.residentMegabytes) << 20;
+    const int affordable = static_cast<int>(std::min<size_t>(budget / std::max<size_t>(plan.fieldBytes, 1), patternCount));
+    plan.residentLimit = std::max(2, affordable);
+    if (plan.residentLimit >= patternCount) plan.residentLimit = 0;
+    plan.budgetTooSmall = (usesEveryPattern || spec.sweep) && plan.residentLimit != 0;
+
+    size_t wanted = 0;
+    switch (spec.precompute) {
+        case PrecomputePolicy::None: wanted = 0; break;
+        case PrecomputePolicy::Start: wanted = 1; break;
+        case PrecomputePolicy::Neighbours: wanted = cost.expensive ? 1 : 3; break;
+        case PrecomputePolicy::All: wanted = order.size(); break;
+    }
+    if (usesEveryPattern && spec.precompute != PrecomputePolicy::None && !cost.expensive) wanted = order.size();
+    wanted = std::min(wanted, order.size());
+    if (plan.residentLimit > 0) wanted = std::min(wanted, static_cast<size_t>(plan.residentLimit));
+    plan.precompute.assign(order.begin(), order.begin() + wanted);
+    plan.parallel = cost.independent && plan.precompute.size() > 1;
+    return plan;
+}
+
+// Name of a precompute policy as written in a spec.
+const char* precomputePolicyName(PrecomputePolicy policy) {
+    switch (policy) {
+        case PrecomputePolicy::None: return "none";
+        case PrecomputePolicy::Start: return "start";
+        case PrecomputePolicy::Neighbours: return "neighbours";
+        case PrecomputePolicy::All: return "all";
+    }
+    return "neighbours";
+}
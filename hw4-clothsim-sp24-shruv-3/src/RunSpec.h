@@ -0,0 +1,104 @@
+#ifndef RUNSPEC_H
+#define RUNSPEC_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Simulation.h"
+
+// Which patterns are built before the first frame.
+enum class PrecomputePolicy {
+    None,         // Every pattern is built on first use.
+    Start,        // The starting pattern only.
+    Neighbours,   // The starting pattern and the two UP/DOWN crossfade to.
+    All           // Every pattern, as a sweep or an audio drive needs them all.
+};
+
+// A measured scan and the frequency it was driven at (0 if unknown).
+struct ScanSpec {
+    std::string file;
+    float frequency = 0;
+};
+
+// Everything a Chladni run needs, read from a JSON file such as
+// scene/chladni.json. The defaults reproduce a run without a spec.
+// Command-line options given alongside --spec override it.
+struct RunSpec {
+    // Field grid size, fixed for the run; the window opens at it and only rescales the view when resized.
+    int width = 640, height = 480;
+
+    // Field source: analytic, fdtd, multigrid, mask, circular or scan.
+    std::string field = "analytic";
+    std::vector<ChladniParams> modes;   // Replaces the built-in (m, n, l) list if not empty.
+    std::string mask;                   // Plate shape PNG for the mask source.
+    int maskModes = 10;
+    std::vector<ScanSpec> scans;
+    std::string audio;                  // WAV recording that drives the pattern weights.
+    int startPattern = 0;
+    bool sweep = false;                 // Start with the continuous sweep running.
+
+    // Particles.
+    int particleCount = 30000;
+    size_t particleCapacity = size_t(1) << 20;
+    int spawnCount = 500;               // Particles per mouse click.
+    std::string integrator = "jitter";  // jitter or inertial.
+    float damping = 0.8f;               // Share of the velocity kept per step by the inertial integrator.
+    std::string anneal = "fixed";       // Jitter annealing of the jitter integrator: fixed, global or local.
+    float annealHalfLife = 40.0f;       // Steps in which global annealing halves the jitter.
+
+    // Seed of the particle positions and jitter, the analytic pattern offset
+    // and the scatter of spawned particles. Runs with the same seed and the
+    // same input repeat exactly; without one each run differs.
+    bool seeded = false;
+    unsigned seed = 0;
+
+    // Precomputation.
+    PrecomputePolicy precompute = PrecomputePolicy::Neighbours;
+    int residentMegabytes = 256;        // Cached pattern fields kept at most.
+
+    // Pacing of the particle steps, see SimClock.
+    int substeps = 1;                   // Steps per 60th of a second in real time.
+    bool fastForward = false;           // Start in fast-forward.
+    int renderEvery = 16;               // Steps per drawn frame in fast-forward, 0 for none.
+
+    // Outputs; empty means off.
+    std::string video, shm, shmParticles, control;
+};
+
+// Reads a run spec: a JSON object with a "chladni" member, as the cloth
+// scenes in scene/ have a "cloth" member. Unknown keys are errors, so typos
+// do not silently fall back to defaults. Returns false and fills error,
+// naming the offending key, on failure.
+bool loadRunSpec(const std::string& filename, RunSpec& spec, std::string& error);
+
+// How the patterns of a field source are built.
+struct FieldCost {
+    bool independent;   // Builds share no state, so several may run at once.
+    bool expensive;     // A build is a solve taking seconds, not milliseconds.
+};
+
+// What to build before the first frame and how much to keep afterwards.
+struct FieldPlan {
+    std::vector<int> precompute;   // Patterns to build up front, in order of need.
+    bool parallel = false;         // Build them concurrently, one pattern per thread.
+    int residentLimit = 0;         // Fields the blender keeps at once, 0 for all.
+    size_t fieldBytes = 0;         // Size of one field.
+    bool budgetTooSmall = false;   // The run needs more fields at once than the budget holds.
+};
+
+// Plans the fields of a source with patternCount patterns on a width x height
+// grid. Patterns are needed in this order: the start, its crossfade
+// neighbours, then the rest from the start onwards. The precompute policy
+// picks a prefix of that order; expensive sources stop after the start unless
+// the policy is All, since a solve per pattern would delay the first frame by
+// minutes. The prefix is cut to the resident budget, of which at least the
+// two blended fields are always kept. A sweep or an audio drive uses every
+// pattern, so the budget must hold them all or the blender would rebuild
+// them constantly; budgetTooSmall reports that.
+FieldPlan planFields(const RunSpec& spec, int patternCount, int startPattern, int width, int height,
+                     const FieldCost& cost, bool usesEveryPattern);
+
+// Name of a precompute policy as written in a spec.
+const char* precomputePolicyName(PrecomputePolicy policy);
+
+#endif // RUNSPEC_H
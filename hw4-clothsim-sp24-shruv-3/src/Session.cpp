@@ -0,0 +1,125 @@
+#include "Session.h"
+
+#include <algorithm>
+#include "Integrator.h"
+#include "Superposition.h"
+
+// Returns the field of the mode at the given size, building it if no session holds it.
+std::shared_ptr<const ModeField> FieldCache::get(const ChladniParams& params, int width, int height) {
+    const Key key(params.m, params.n, params.l, width, height);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = fields.find(key);
+        if (found != fields.end()) {
+            std::shared_ptr<const ModeField> field = found->second.lock();
+            if (field) {
+                ++hits;
+                return field;
+            }
+        }
+    }
+
+    // Build outside the lock; the superposition of one mode is the analytic field without the random offset.
+    Simulation sim;
+    sim.width = width;
+    sim.height = height;
+    ModeSuperposition superposition;
+    superposition.resize(width, height);
+    superposition.evaluate(std::vector<ChladniParams>(1, params), std::vector<float>(1, 1.0f), sim.vibrationValues);
+    sim.computeGradients();
+    std::shared_ptr<ModeField> built(new ModeField);
+    built->width = width;
+    built->height = height;
+    built->vibrationValues.swap(sim.vibrationValues);
+    built->gradients.swap(sim.gradients);
+
+    // Another thread may have built the same field meanwhile; keep the first.
+    std::lock_guard<std::mutex> guard(lock);
+    std::weak_ptr<const ModeField>& slot = fields[key];
+    std::shared_ptr<const ModeField> existing = slot.lock();
+    if (existing) {
+        ++hits;
+        return existing;
+    }
+    ++misses;
+    slot = built;
+    return built;
+}
+
+// Fields currently held by at least one session. Forgets expired ones.
+int FieldCache::liveFields() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto it = fields.begin(); it != fields.end();) {
+        if (it->second.expired()) {
+            it = fields.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return static_cast<int>(fields.size());
+}
+
+PlateSession::PlateSession(int id, int width, int height, int particleCount)
+    : id(id), width(width), height(height) {
+    particles.reserve(particleCount);
+    const uint32_t seed = particleHash(static_cast<uint32_t>(id) + 1);
+    for (int i = 0; i < particleCount; ++i) {
+        const uint32_t h = particleHash(seed ^ static_cast<uint32_t>(i) * 2654435761U);
+        particles.emplace_back((hashJitter(h) + 0.5f) * width, (hashJitter(particleHash(h)) + 0.5f) * height);
+    }
+    velocities.resize(particles.size());
+}
+
+// Moves particles [begin, end) one frame along the field.
+void PlateSession::update(size_t begin, size_t end) {
+    if (!field) return;
+    const uint32_t frameSeed = particleHash(frame * 2654435761U ^ static_cast<uint32_t>(id));
+    if (integrator == IntegratorKind::Inertial) {
+        inertial.step(particles.data(), velocities, begin, end, field->vibrationValues.data(), field->gradients.data(),
+                      width, height, frameSeed);
+    } else {
+        jitterStep(particles.data(), begin, end, field->gradients.data(), field->vibrationValues.data(), width, height,
+                   slowFactor, schedule, schedule.globalScale(frame - fieldFrame), frameSeed);
+    }
+    applyBoundary(particles.data() + begin, particles.data() + end, width, height, boundary);
+}
+
+SessionManager::SessionManager(int threads) : pool(threads) {}
+
+// Adds a session and returns its id.
+int SessionManager::add(int width, int height, int particleCount) {
+    const int id = static_cast<int>(sessions.size());
+    sessions.push_back(std::unique_ptr<PlateSession>(new PlateSession(id, width, height, particleCount)));
+    return id;
+}
+
+// Shows a mode in a session.
+void SessionManager::setMode(int id, const ChladniParams& params) {
+    PlateSession& s = *sessions[id];
+    s.field = cache.get(params, s.width, s.height);
+    s.fieldFrame = s.frame;
+}
+
+// Total particles over every session.
+long long SessionManager::particleCount() const {
+    long long total = 0;
+    for (const std::unique_ptr<PlateSession>& s : sessions) total += static_cast<long long>(s->particles.size());
+    return total;
+}
+
+// Advances every session by one frame.
+void SessionManager::step() {
+    tasks.clear();
+    homes.clear();
+    for (const std::unique_ptr<PlateSession>& s : sessions) {
+        PlateSession* session = s.get();
+        const size_t count = session->particles.size();
+        for (size_t begin = 0; begin < count; begin += chunkSize) {
+            const size_t end = std::min(count, begin + chunkSize);
+            tasks.push_back([session, begin, end] { session->update(begin, end); });
+            homes.push_back(session->id);
+        }
+    }
+    pool.run(tasks, homes);
+    for (const std::unique_ptr<PlateSession>& s : sessions) ++s->frame;
+}
@@ -0,0 +1,104 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include "Boundary.h"
+#include "Integrator.h"
+#include "Particle.h"
+#include "Simulation.h"
+#include "WorkStealing.h"
+
+// Immutable vibration field and gradients of one mode at one grid size.
+struct ModeField {
+    int width = 0, height = 0;
+    std::vector<float> vibrationValues;
+    std::vector<Gradient> gradients;
+};
+
+// Mode fields shared read-only between sessions.
+// Fields are handed out as shared_ptr and remembered as weak_ptr, so a field
+// lives exactly as long as some session shows it, and sessions showing the
+// same mode at the same size share one copy.
+class FieldCache {
+public:
+    // Returns the field of the mode at the given size, building it if no session holds it.
+    std::shared_ptr<const ModeField> get(const ChladniParams& params, int width, int height);
+
+    // Fields currently held by at least one session.
+    int liveFields();
+
+    long long hits = 0, misses = 0;
+
+private:
+    typedef std::tuple<int, int, float, int, int> Key;   // (m, n, l, width, height).
+
+    std::mutex lock;
+    std::map<Key, std::weak_ptr<const ModeField> > fields;
+};
+
+// One independent plate display: a grid, a mode field and its particles.
+class PlateSession {
+public:
+    PlateSession(int id, int width, int height, int particleCount);
+
+    // Moves particles [begin, end) one frame along the field with the chosen
+    // integrator and applies the boundary policy. Ranges may run concurrently;
+    // random numbers come from a hash of the particle index and frame, so no
+    // generator is shared.
+    void update(size_t begin, size_t end);
+
+    const int id;
+    const int width, height;
+    std::vector<Particle> particles;
+    std::shared_ptr<const ModeField> field;
+    BoundaryPolicy boundary = BoundaryPolicy::Wrap;
+    float slowFactor = 0.2f;   // Fraction of the gradient step taken per frame, as in updateParticles.
+    IntegratorKind integrator = IntegratorKind::Jitter;
+    JitterSchedule schedule;         // Annealing of the jitter integrator.
+    uint32_t fieldFrame = 0;         // Frame the field was last set at, where global annealing restarts.
+    InertialIntegrator inertial;
+    ParticleVelocities velocities;   // One per particle, used by the inertial integrator.
+    uint32_t frame = 0;
+};
+
+// Hosts many independent sessions in one process.
+// Every frame the particles of all sessions are cut into chunks and run on a
+// work-stealing pool. Chunks start on the worker their session is pinned to,
+// so a session's particles stay in one core's cache, and idle workers steal
+// chunks from busier ones when sessions differ in size.
+class SessionManager {
+public:
+    // Uses threads workers; 0 uses every hardware thread.
+    explicit SessionManager(int threads = 0);
+
+    // Adds a session and returns its id.
+    int add(int width, int height, int particleCount);
+
+    // Shows a mode in a session, sharing its field with any session already showing it.
+    // Builds uncached fields with OpenMP, so call it from the thread that owns the manager.
+    void setMode(int session, const ChladniParams& params);
+
+    // Advances every session by one frame.
+    void step();
+
+    PlateSession& session(int id) { return *sessions[id]; }
+    int sessionCount() const { return static_cast<int>(sessions.size()); }
+    long long particleCount() const;
+
+    size_t chunkSize = 16384;   // Particles per task.
+
+    FieldCache cache;
+    WorkStealingPool pool;
+
+private:
+    std::vector<std::unique_ptr<PlateSession> > sessions;
+    std::vector<WorkStealingPool::Task> tasks;
+    std::vector<int> homes;
+};
+
+#endif // SESSION_H
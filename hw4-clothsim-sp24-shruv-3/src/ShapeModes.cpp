@@ -0,0 +1,641 @@
+#include "ShapeModes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+#include "CGL/lodepng.h"
+#include "Simulation.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Loads a mask from a PNG through lodepng. Bright, opaque pixels are plate.
+bool PlateMask::loadPng(const std::string& filename, std::string& error) {
+    std::vector<unsigned char> rgba;
+    unsigned w = 0, h = 0;
+    unsigned status = lodepng::decode(rgba, w, h, filename);
+    if (status) {
+        error = lodepng_error_text(status);
+        return false;
+    }
+
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    inside.assign(static_cast<size_t>(width) * height, 0);
+    // PNG rows run top to bottom; the simulation's y axis points up.
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = &rgba[static_cast<size_t>(height - 1 - y) * width * 4];
+        for (int x = 0; x < width; ++x) {
+            const unsigned char* p = row + x * 4;
+            int luminance = (p[0] * 299 + p[1] * 587 + p[2] * 114) / 1000;
+            inside[static_cast<size_t>(y) * width + x] = luminance > 127 && p[3] > 127;
+        }
+    }
+    return true;
+}
+
+// Halves the resolution; a coarse cell is plate if at least two of its four children are.
+PlateMask PlateMask::coarsened() const {
+    PlateMask coarse;
+    coarse.width = (width + 1) / 2;
+    coarse.height = (height + 1) / 2;
+    coarse.inside.assign(static_cast<size_t>(coarse.width) * coarse.height, 0);
+    for (int y = 0; y < coarse.height; ++y) {
+        for (int x = 0; x < coarse.width; ++x) {
+            int count = 0;
+            for (int dy = 0; dy < 2; ++dy) {
+                for (int dx = 0; dx < 2; ++dx) {
+                    int fx = 2 * x + dx, fy = 2 * y + dy;
+                    if (fx < width && fy < height) count += inside[static_cast<size_t>(fy) * width + fx];
+                }
+            }
+            coarse.inside[static_cast<size_t>(y) * coarse.width + x] = count >= 2;
+        }
+    }
+    return coarse;
+}
+
+int PlateMask::cellCount() const {
+    return static_cast<int>(std::count(inside.begin(), inside.end(), 1));
+}
+
+// y = A x, parallel over rows.
+void SparseMatrix::multiply(const double* x, double* y) const {
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < rows; ++r) {
+        double sum = 0;
+        for (int k = rowStart[r]; k < rowStart[r + 1]; ++k) {
+            sum += values[k] * x[cols[k]];
+        }
+        y[r] = sum;
+    }
+}
+
+// Numbers the plate cells of a mask row by row; -1 marks cells off the plate.
+static std::vector<int> numberCells(const PlateMask& mask, int& count) {
+    std::vector<int> index(mask.inside.size(), -1);
+    count = 0;
+    for (size_t c = 0; c < mask.inside.size(); ++c) {
+        if (mask.inside[c]) index[c] = count++;
+    }
+    return index;
+}
+
+// Assembles the 13-point biharmonic stencil over the plate cells. Neighbours
+// off the plate are zero, which is a clamped edge and keeps the matrix SPD.
+static SparseMatrix buildBiharmonic(const PlateMask& mask, const std::vector<int>& index, int count) {
+    static const int offsets[13][2] = {
+        {0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1},
+        {-1, -1}, {1, -1}, {-1, 1}, {1, 1},
+        {-2, 0}, {2, 0}, {0, -2}, {0, 2}
+    };
+    static const double weights[13] = {20, -8, -8, -8, -8, 2, 2, 2, 2, 1, 1, 1, 1};
+
+    SparseMatrix a;
+    a.rows = count;
+    a.rowStart.reserve(count + 1);
+    a.cols.reserve(static_cast<size_t>(count) * 13);
+    a.values.reserve(static_cast<size_t>(count) * 13);
+    a.rowStart.push_back(0);
+    for (int y = 0; y < mask.height; ++y) {
+        for (int x = 0; x < mask.width; ++x) {
+            if (!mask.inside[static_cast<size_t>(y) * mask.width + x]) continue;
+            for (int k = 0; k < 13; ++k) {
+                int nx = x + offsets[k][0], ny = y + offsets[k][1];
+                if (nx < 0 || ny < 0 || nx >= mask.width || ny >= mask.height) continue;
+                int neighbor = index[static_cast<size_t>(ny) * mask.width + nx];
+                if (neighbor < 0) continue;
+                a.cols.push_back(neighbor);
+                a.values.push_back(weights[k]);
+            }
+            a.rowStart.push_back(static_cast<int>(a.cols.size()));
+        }
+    }
+    return a;
+}
+
+// Bilinear interpolation from a mask level to the next finer one, as a matrix
+// with one row per fine cell. Coarse cells outside the plate count as zero.
+static SparseMatrix buildProlongation(const PlateMask& coarse, const std::vector<int>& coarseIndex,
+                                      const PlateMask& fine, const std::vector<int>& fineIndex, int fineCount) {
+    SparseMatrix p;
+    p.rows = fineCount;
+    p.rowStart.assign(fineCount + 1, 0);
+    p.cols.reserve(static_cast<size_t>(fineCount) * 4);
+    p.values.reserve(static_cast<size_t>(fineCount) * 4);
+
+    int row = 0;
+    for (int y = 0; y < fine.height; ++y) {
+        // A fine cell centre sits a quarter of a coarse cell from its parent's centre.
+        const int y0 = (y & 1) ? y / 2 : y / 2 - 1;
+        const double wy0 = (y & 1) ? 0.75 : 0.25;
+        for (int x = 0; x < fine.width; ++x) {
+            if (fineIndex[static_cast<size_t>(y) * fine.width + x] < 0) continue;
+            const int x0 = (x & 1) ? x / 2 : x / 2 - 1;
+            const double wx0 = (x & 1) ? 0.75 : 0.25;
+            for (int dy = 0; dy < 2; ++dy) {
+                const int cy = y0 + dy;
+                if (cy < 0 || cy >= coarse.height) continue;
+                const double wy = dy ? 1.0 - wy0 : wy0;
+                for (int dx = 0; dx < 2; ++dx) {
+                    const int cx = x0 + dx;
+                    if (cx < 0 || cx >= coarse.width) continue;
+                    const int c = coarseIndex[static_cast<size_t>(cy) * coarse.width + cx];
+                    if (c < 0) continue;
+                    p.cols.push_back(c);
+                    p.values.push_back(wy * (dx ? 1.0 - wx0 : wx0));
+                }
+            }
+            p.rowStart[++row] = static_cast<int>(p.cols.size());
+        }
+    }
+    return p;
+}
+
+// y = P^T x for a prolongation P. y must hold one entry per coarse cell.
+static void restrictTo(const SparseMatrix& p, const double* x, double* y) {
+    for (int r = 0; r < p.rows; ++r) {
+        for (int k = p.rowStart[r]; k < p.rowStart[r + 1]; ++k) {
+            y[p.cols[k]] += p.values[k] * x[r];
+        }
+    }
+}
+
+// Cholesky factor of a banded SPD matrix, used to invert the coarsest level.
+// Plate cells are numbered row by row, so every stencil neighbour lies within
+// about two mask rows of the diagonal and the factor stays narrow.
+class BandedCholesky {
+public:
+    bool factor(const SparseMatrix& a) {
+        n = a.rows;
+        band = 0;
+        for (int r = 0; r < n; ++r) {
+            for (int k = a.rowStart[r]; k < a.rowStart[r + 1]; ++k) {
+                band = std::max(band, std::abs(a.cols[k] - r));
+            }
+        }
+        const int w = band + 1;
+        l.assign(static_cast<size_t>(n) * w, 0.0);
+        for (int r = 0; r < n; ++r) {
+            for (int k = a.rowStart[r]; k < a.rowStart[r + 1]; ++k) {
+                if (a.cols[k] <= r) at(r, a.cols[k]) = a.values[k];
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            const int first = std::max(0, i - band);
+            for (int j = first; j <= i; ++j) {
+                double sum = at(i, j);
+                for (int k = std::max(first, j - band); k < j; ++k) sum -= at(i, k) * at(j, k);
+                if (i == j) {
+                    if (sum <= 0) return false;
+                    at(i, i) = std::sqrt(sum);
+                } else {
+                    at(i, j) = sum / at(j, j);
+                }
+            }
+        }
+        return true;
+    }
+
+    // Solves A x = b in place.
+    void solve(double* x) const {
+        for (int i = 0; i < n; ++i) {
+            double sum = x[i];
+            for (int k = std::max(0, i - band); k < i; ++k) sum -= at(i, k) * x[k];
+            x[i] = sum / at(i, i);
+        }
+        for (int i = n - 1; i >= 0; --i) {
+            double sum = x[i];
+            for (int k = i + 1; k <= std::min(n - 1, i + band); ++k) sum -= at(k, i) * x[k];
+            x[i] = sum / at(i, i);
+        }
+    }
+
+private:
+    double& at(int i, int j) { return l[static_cast<size_t>(i) * (band + 1) + (j - i + band)]; }
+    double at(int i, int j) const { return l[static_cast<size_t>(i) * (band + 1) + (j - i + band)]; }
+
+    int n = 0, band = 0;
+    std::vector<double> l;
+};
+
+// Dense block of vectors of length n, stored column after column.
+struct Block {
+    int n = 0, count = 0;
+    std::vector<double> data;
+
+    Block() {}
+    Block(int n, int count) : n(n), count(count), data(static_cast<size_t>(n) * count, 0.0) {}
+    double* col(int j) { return &data[static_cast<size_t>(j) * n]; }
+    const double* col(int j) const { return &data[static_cast<size_t>(j) * n]; }
+};
+
+// G = A^T B for blocks with the same length, in one parallel pass over the rows.
+static std::vector<double> gram(const Block& a, const Block& b) {
+    const int ca = a.count, cb = b.count, n = a.n;
+    std::vector<double> g(static_cast<size_t>(ca) * cb, 0.0);
+
+    #pragma omp parallel
+    {
+        std::vector<double> local(g.size(), 0.0);
+        #pragma omp for schedule(static)
+        for (int r0 = 0; r0 < n; r0 += 512) {
+            const int r1 = std::min(n, r0 + 512);
+            for (int i = 0; i < ca; ++i) {
+                const double* x = a.col(i);
+                for (int j = 0; j < cb; ++j) {
+                    const double* y = b.col(j);
+                    double sum = 0;
+                    for (int r = r0; r < r1; ++r) sum += x[r] * y[r];
+                    local[static_cast<size_t>(i) * cb + j] += sum;
+                }
+            }
+        }
+        #pragma omp critical
+        for (size_t k = 0; k < g.size(); ++k) g[k] += local[k];
+    }
+    return g;
+}
+
+// out = in * Y, where Y is in.count x cols (row-major), parallel over rows.
+static Block combine(const Block& in, const std::vector<double>& y, int rowOffset, int rows, int cols) {
+    Block out(in.n, cols);
+    const int stride = cols;
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < in.n; ++r) {
+        for (int j = 0; j < cols; ++j) {
+            double sum = 0;
+            for (int i = 0; i < rows; ++i) {
+                sum += in.col(rowOffset + i)[r] * y[static_cast<size_t>(rowOffset + i) * stride + j];
+            }
+            out.col(j)[r] = sum;
+        }
+    }
+    return out;
+}
+
+// Orthonormalises the columns of s in place with two passes of classical
+// Gram-Schmidt, dropping columns that become numerically dependent. The first
+// `fixed` columns are assumed orthonormal already.
+static void orthonormalize(Block& s, int fixed) {
+    const int n = s.n;
+    int kept = fixed;
+    for (int j = fixed; j < s.count; ++j) {
+        double* v = s.col(j);
+        double original = 0;
+        for (int r = 0; r < n; ++r) original += v[r] * v[r];
+        original = std::sqrt(original);
+        if (original == 0) continue;
+
+        for (int pass = 0; pass < 2; ++pass) {
+            std::vector<double> coef(kept, 0.0);
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < kept; ++k) {
+                const double* q = s.col(k);
+                double sum = 0;
+                for (int r = 0; r < n; ++r) sum += q[r] * v[r];
+                coef[k] = sum;
+            }
+            #pragma omp parallel for schedule(static)
+            for (int r = 0; r < n; ++r) {
+                double sum = 0;
+                for (int k = 0; k < kept; ++k) sum += coef[k] * s.col(k)[r];
+                v[r] -= sum;
+            }
+        }
+
+        double norm = 0;
+        for (int r = 0; r < n; ++r) norm += v[r] * v[r];
+        norm = std::sqrt(norm);
+        if (norm < 1e-10 * original) continue;
+
+        double* dst = s.col(kept);
+        for (int r = 0; r < n; ++r) dst[r] = v[r] / norm;
+        ++kept;
+    }
+    s.count = kept;
+    s.data.resize(static_cast<size_t>(n) * kept);
+}
+
+// Eigen-decomposes the symmetric size x size matrix h (row-major) with cyclic
+// Jacobi rotations. Eigenvalues come back ascending, eigenvectors as columns.
+static void symmetricEigen(std::vector<double> h, int size,
+                           std::vector<double>& values, std::vector<double>& vectors) {
+    vectors.assign(static_cast<size_t>(size) * size, 0.0);
+    for (int i = 0; i < size; ++i) vectors[static_cast<size_t>(i) * size + i] = 1.0;
+
+    for (int sweep = 0; sweep < 100; ++sweep) {
+        double off = 0, total = 0;
+        for (int i = 0; i < size; ++i) {
+            for (int j = 0; j < size; ++j) {
+                double v = h[static_cast<size_t>(i) * size + j];
+                total += v * v;
+                if (i != j) off += v * v;
+            }
+        }
+        if (off <= 1e-28 * total) break;
+
+        for (int p = 0; p < size; ++p) {
+            for (int q = p + 1; q < size; ++q) {
+                double apq = h[static_cast<size_t>(p) * size + q];
+                if (std::abs(apq) < 1e-300) continue;
+                double app = h[static_cast<size_t>(p) * size + p];
+                double aqq = h[static_cast<size_t>(q) * size + q];
+                double theta = (aqq - app) / (2 * apq);
+                double t = (theta >= 0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+                double c = 1 / std::sqrt(t * t + 1), s = t * c;
+
+                for (int k = 0; k < size; ++k) {
+                    double akp = h[static_cast<size_t>(k) * size + p];
+                    double akq = h[static_cast<size_t>(k) * size + q];
+                    h[static_cast<size_t>(k) * size + p] = c * akp - s * akq;
+                    h[static_cast<size_t>(k) * size + q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < size; ++k) {
+                    double apk = h[static_cast<size_t>(p) * size + k];
+                    double aqk = h[static_cast<size_t>(q) * size + k];
+                    h[static_cast<size_t>(p) * size + k] = c * apk - s * aqk;
+                    h[static_cast<size_t>(q) * size + k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < size; ++k) {
+                    double vkp = vectors[static_cast<size_t>(k) * size + p];
+                    double vkq = vectors[static_cast<size_t>(k) * size + q];
+                    vectors[static_cast<size_t>(k) * size + p] = c * vkp - s * vkq;
+                    vectors[static_cast<size_t>(k) * size + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    // Sort eigenpairs ascending.
+    std::vector<int> order(size);
+    for (int i = 0; i < size; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return h[static_cast<size_t>(a) * size + a] < h[static_cast<size_t>(b) * size + b];
+    });
+    values.resize(size);
+    std::vector<double> sorted(vectors.size());
+    for (int j = 0; j < size; ++j) {
+        values[j] = h[static_cast<size_t>(order[j]) * size + order[j]];
+        for (int k = 0; k < size; ++k) {
+            sorted[static_cast<size_t>(k) * size + j] = vectors[static_cast<size_t>(k) * size + order[j]];
+        }
+    }
+    vectors.swap(sorted);
+}
+
+// Applies the matrix to every column of a block.
+static Block apply(const SparseMatrix& a, const Block& x) {
+    Block y(x.n, x.count);
+    for (int j = 0; j < x.count; ++j) a.multiply(x.col(j), y.col(j));
+    return y;
+}
+
+// Block LOBPCG for the smallest eigenpairs of a. precondition(r, z) maps a
+// residual to a search direction, approximating z = A^-1 r.
+// x holds the starting block and receives the Ritz vectors. Only the first
+// `wanted` columns are checked for convergence; the rest are guard vectors.
+static int lobpcg(const SparseMatrix& a, Block& x, int wanted, int maxIterations, double tolerance,
+                  const std::function<void(const double*, double*)>& precondition,
+                  std::vector<double>& lambda) {
+    const int n = x.n;
+    const int m = x.count;
+
+    // Initial Rayleigh-Ritz on the starting block.
+    orthonormalize(x, 0);
+    Block ax = apply(a, x);
+    {
+        std::vector<double> y;
+        symmetricEigen(gram(x, ax), x.count, lambda, y);
+        x = combine(x, y, 0, x.count, x.count);
+        ax = combine(ax, y, 0, ax.count, ax.count);
+    }
+
+    Block p;
+    int iteration = 0;
+    for (; iteration < maxIterations; ++iteration) {
+        const int mx = x.count;
+
+        // Residuals and convergence of the wanted modes.
+        Block w(n, mx);
+        std::vector<double> residual(n);
+        bool converged = true;
+        for (int j = 0; j < mx; ++j) {
+            const double* xj = x.col(j);
+            const double* axj = ax.col(j);
+            double norm = 0;
+            for (int r = 0; r < n; ++r) {
+                residual[r] = axj[r] - lambda[j] * xj[r];
+                norm += residual[r] * residual[r];
+            }
+            if (j < wanted && std::sqrt(norm) > tolerance * std::abs(lambda[j])) converged = false;
+            precondition(residual.data(), w.col(j));
+        }
+        if (converged) break;
+
+        // Search space [X W P], orthonormalised with X kept as is.
+        Block s(n, mx + w.count + p.count);
+        std::copy(x.data.begin(), x.data.end(), s.data.begin());
+        std::copy(w.data.begin(), w.data.end(), s.data.begin() + x.data.size());
+        std::copy(p.data.begin(), p.data.end(), s.data.begin() + x.data.size() + w.data.size());
+        orthonormalize(s, mx);
+
+        Block as = apply(a, s);
+        std::vector<double> h = gram(s, as);
+        // Symmetrise away rounding noise.
+        for (int i = 0; i < s.count; ++i) {
+            for (int j = i + 1; j < s.count; ++j) {
+                double v = 0.5 * (h[static_cast<size_t>(i) * s.count + j] + h[static_cast<size_t>(j) * s.count + i]);
+                h[static_cast<size_t>(i) * s.count + j] = v;
+                h[static_cast<size_t>(j) * s.count + i] = v;
+            }
+        }
+
+        std::vector<double> values, y;
+        symmetricEigen(h, s.count, values, y);
+        const int keep = std::min(m, s.count);
+
+        // Keep only the first `keep` eigenvector columns.
+        std::vector<double> yKeep(static_cast<size_t>(s.count) * keep);
+        for (int i = 0; i < s.count; ++i) {
+            for (int j = 0; j < keep; ++j) {
+                yKeep[static_cast<size_t>(i) * keep + j] = y[static_cast<size_t>(i) * s.count + j];
+            }
+        }
+
+        x = combine(s, yKeep, 0, s.count, keep);
+        ax = combine(as, yKeep, 0, as.count, keep);
+        p = combine(s, yKeep, mx, s.count - mx, keep);
+        lambda.assign(values.begin(), values.begin() + keep);
+    }
+    return iteration;
+}
+
+// Computes the modes of the mask.
+bool ShapeModeSolver::solve(const PlateMask& fineMask) {
+    auto start = std::chrono::steady_clock::now();
+    mask = fineMask;
+    eigenvalues.clear();
+    modes.clear();
+    iterations = 0;
+
+    // Mask pyramid, finest first.
+    std::vector<PlateMask> pyramid(1, fineMask);
+    while (pyramid.back().cellCount() > coarsestCells && pyramid.back().width > 8 && pyramid.back().height > 8) {
+        pyramid.push_back(pyramid.back().coarsened());
+    }
+    levels = static_cast<int>(pyramid.size());
+
+    const int blockSize = modeCount + std::max(2, modeCount / 4);
+    const int coarsest = levels - 1;
+
+    // The coarsest level is factored once and inverted exactly.
+    int coarseCount = 0;
+    std::vector<int> coarsestIndex = numberCells(pyramid[coarsest], coarseCount);
+    if (coarseCount < blockSize + 1) return false;
+    SparseMatrix coarseMatrix = buildBiharmonic(pyramid[coarsest], coarsestIndex, coarseCount);
+    BandedCholesky coarseFactor;
+    if (!coarseFactor.factor(coarseMatrix)) return false;
+
+    // Interpolation from each level to the next finer one, coarsest first.
+    std::vector<SparseMatrix> prolongations;
+    std::vector<int> coarseCounts(1, coarseCount);
+
+    Block x;
+    std::vector<int> previousIndex = coarsestIndex;
+    std::vector<double> lambda;
+
+    for (int level = coarsest; level >= 0; --level) {
+        const PlateMask& levelMask = pyramid[level];
+        int count = coarseCount;
+        std::vector<int> index = level == coarsest ? coarsestIndex : numberCells(levelMask, count);
+        SparseMatrix a = level == coarsest ? coarseMatrix : buildBiharmonic(levelMask, index, count);
+
+        Block guess(count, blockSize);
+        std::function<void(const double*, double*)> precondition;
+
+        if (level == coarsest) {
+            std::mt19937 gen(1234);
+            std::uniform_real_distribution<double> dis(-1.0, 1.0);
+            for (double& v : guess.data) v = dis(gen);
+
+            precondition = [&](const double* r, double* z) {
+                std::copy(r, r + count, z);
+                coarseFactor.solve(z);
+            };
+        } else {
+            // Interpolate the previous level's modes onto this one.
+            prolongations.push_back(buildProlongation(pyramid[level + 1], previousIndex, levelMask, index, count));
+            coarseCounts.push_back(count);
+            for (int j = 0; j < x.count; ++j) prolongations.back().multiply(x.col(j), guess.col(j));
+            std::mt19937 gen(4321 + level);
+            std::uniform_real_distribution<double> dis(-1.0, 1.0);
+            for (int j = x.count; j < blockSize; ++j) {
+                for (int r = 0; r < count; ++r) guess.col(j)[r] = dis(gen);
+            }
+
+            // Two-level preconditioner: Jacobi for the rough part of the residual
+            // plus an exact coarsest-level solve for the smooth part, moved between
+            // levels by the chain of interpolations.
+            std::vector<double> inverseDiagonal(count, 1.0);
+            for (int r = 0; r < count; ++r) {
+                for (int k = a.rowStart[r]; k < a.rowStart[r + 1]; ++k) {
+                    if (a.cols[k] == r) inverseDiagonal[r] = 1.0 / a.values[k];
+                }
+            }
+            // The Galerkin coarse operator is a quarter of the rediscretised one per level.
+            const double coarseScale = std::pow(4.0, coarsest - level);
+
+            precondition = [=, &coarseFactor, &prolongations, &coarseCounts](const double* r, double* z) {
+                const int chain = static_cast<int>(prolongations.size());
+                std::vector<std::vector<double> > v(chain + 1);
+                v[chain].assign(r, r + count);
+                for (int l = chain; l > 0; --l) {
+                    v[l - 1].assign(coarseCounts[l - 1], 0.0);
+                    restrictTo(prolongations[l - 1], v[l].data(), v[l - 1].data());
+                }
+                coarseFactor.solve(v[0].data());
+                for (int l = 0; l < chain; ++l) {
+                    prolongations[l].multiply(v[l].data(), v[l + 1].data());
+                }
+                const std::vector<double>& smooth = v[chain];
+                #pragma omp parallel for schedule(static)
+                for (int i = 0; i < count; ++i) {
+                    z[i] = r[i] * inverseDiagonal[i] + coarseScale * smooth[i];
+                }
+            };
+        }
+
+        iterations += lobpcg(a, guess, modeCount, level == coarsest ? maxIterations : refineIterations,
+                             tolerance, precondition, lambda);
+        x = guess;
+        previousIndex.swap(index);
+    }
+
+    // Keep the wanted modes as dense fields over the finest mask.
+    const int found = std::min(modeCount, x.count);
+    eigenvalues.assign(lambda.begin(), lambda.begin() + found);
+    modes.assign(found, std::vector<float>(mask.inside.size(), 0.0f));
+    for (int j = 0; j < found; ++j) {
+        for (size_t c = 0; c < mask.inside.size(); ++c) {
+            int k = previousIndex[c];
+            if (k >= 0) modes[j][c] = static_cast<float>(x.col(j)[k]);
+        }
+    }
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return found > 0;
+}
+
+// Frequency of a computed mode in Hz.
+float ShapeModeSolver::frequency(int mode) const {
+    if (mode < 0 || mode >= computedModes() || mask.width == 0) return 0;
+    const double thickness = PLATE_THICKNESS;
+    const double rigidity = PLATE_YOUNGS_MODULUS * thickness * thickness * thickness /
+                            (12.0 * (1.0 - PLATE_POISSON_RATIO * PLATE_POISSON_RATIO));
+    const double kappa = std::sqrt(rigidity / (PLATE_DENSITY * thickness));
+    const double dx = PLATE_SIDE / mask.width;
+    return static_cast<float>(kappa * std::sqrt(std::max(0.0, eigenvalues[mode])) / (dx * dx) / (2.0 * PI));
+}
+
+// Resamples |mode| onto a width x height grid, normalised to [0, 1].
+void ShapeModeSolver::sampleMode(int mode, std::vector<float>& out, int width, int height) const {
+    out.assign(static_cast<size_t>(width) * height, 1.0f);
+    if (mode < 0 || mode >= computedModes()) return;
+
+    const std::vector<float>& shape = modes[mode];
+    float peak = 0;
+    for (float v : shape) peak = std::max(peak, std::abs(v));
+    const float norm = peak > 0 ? 1.0f / peak : 0.0f;
+    const float sx = float(mask.width) / width;
+    const float sy = float(mask.height) / height;
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        // Sample at cell centres; the mask cell underneath decides plate or not.
+        const float v = std::max(0.0f, (y + 0.5f) * sy - 0.5f);
+        const int j = std::min(static_cast<int>(v), mask.height - 1);
+        const int j1 = std::min(j + 1, mask.height - 1);
+        const float fy = v - j;
+        const int cy = std::min(static_cast<int>((y + 0.5f) * sy), mask.height - 1);
+        for (int x = 0; x < width; ++x) {
+            const int cx = std::min(static_cast<int>((x + 0.5f) * sx), mask.width - 1);
+            if (!mask.inside[static_cast<size_t>(cy) * mask.width + cx]) continue;
+
+            const float u = std::max(0.0f, (x + 0.5f) * sx - 0.5f);
+            const int i = std::min(static_cast<int>(u), mask.width - 1);
+            const int i1 = std::min(i + 1, mask.width - 1);
+            const float fx = u - i;
+            const float a = std::abs(shape[static_cast<size_t>(j) * mask.width + i]);
+            const float b = std::abs(shape[static_cast<size_t>(j) * mask.width + i1]);
+            const float c = std::abs(shape[static_cast<size_t>(j1) * mask.width + i]);
+            const float d = std::abs(shape[static_cast<size_t>(j1) * mask.width + i1]);
+            const float top = a + (b - a) * fx;
+            const float bottom = c + (d - c) * fx;
+            out[static_cast<size_t>(y) * width + x] = (top + (bottom - top) * fy) * norm;
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef SHAPEMODES_H
+#define SHAPEMODES_H
+
+#include <string>
+#include <vector>
+
+// Which cells of a rectangular grid belong to the plate.
+struct PlateMask {
+    int width = 0, height = 0;
+    std::vector<unsigned char> inside;   // 1 for plate cells, row-major.
+
+    // Loads a mask from a PNG through lodepng. Bright, opaque pixels are plate.
+    // Returns false and fills error if the file cannot be decoded.
+    bool loadPng(const std::string& filename, std::string& error);
+
+    // Halves the resolution; a coarse cell is plate if at least two of its four children are.
+    PlateMask coarsened() const;
+
+    int cellCount() const;
+};
+
+// Sparse symmetric matrix in compressed row storage.
+struct SparseMatrix {
+    int rows = 0;
+    std::vector<int> rowStart;     // rows + 1 offsets into cols/values.
+    std::vector<int> cols;
+    std::vector<double> values;
+
+    // y = A x, parallel over rows.
+    void multiply(const double* x, double* y) const;
+};
+
+// Lowest vibration modes of an arbitrarily shaped plate.
+// The plate is the set of mask cells; the 13-point biharmonic stencil is
+// assembled over them with zero displacement outside (a clamped edge). The
+// lowest eigenpairs are found with block LOBPCG, first on a coarsened copy of
+// the mask (preconditioned by its exact banded Cholesky factor) and then
+// refined level by level, each level starting from the previous level's modes
+// and preconditioned by Jacobi plus a coarsest-level correction. Only a few
+// iterations are needed on the fine levels, which keeps million-cell masks
+// within minutes.
+class ShapeModeSolver {
+public:
+    int modeCount = 10;          // Modes to compute.
+    int coarsestCells = 4096;    // Coarsen the mask until it has at most this many cells.
+    int maxIterations = 100;     // LOBPCG iterations on the coarsest level.
+    int refineIterations = 25;   // LOBPCG iterations on every finer level.
+    double tolerance = 1e-4;     // Relative residual at which a mode counts as converged.
+
+    // Computes the modes of the mask. Returns false if the mask has too few cells.
+    bool solve(const PlateMask& mask);
+
+    // Frequency of a computed mode in Hz, for the steel plate of Simulation.h
+    // stretched so the mask width spans the plate side.
+    float frequency(int mode) const;
+
+    // Resamples |mode| onto a width x height grid, normalised to [0, 1].
+    // Cells outside the plate are set to 1 so particles are pushed off them.
+    void sampleMode(int mode, std::vector<float>& out, int width, int height) const;
+
+    int computedModes() const { return static_cast<int>(eigenvalues.size()); }
+
+    // Statistics of the last solve.
+    double seconds = 0;
+    int levels = 0;
+    int iterations = 0;          // Total LOBPCG iterations over all levels.
+
+private:
+    PlateMask mask;                         // Finest mask.
+    std::vector<double> eigenvalues;        // Ascending, in grid units of the finest level.
+    std::vector<std::vector<float> > modes; // Mode shapes over the finest mask, row-major.
+};
+
+#endif // SHAPEMODES_H
@@ -0,0 +1,249 @@
+#include "SharedFrames.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Rounds a size up to a whole number of cache lines.
+static size_t alignUp(size_t bytes) {
+    return (bytes + 63) & ~static_cast<size_t>(63);
+}
+
+// Slot of a frame counter.
+static inline SharedFrameSlot* slotAt(const SharedFrameHeader* header, uint64_t index) {
+    char* base = reinterpret_cast<char*>(const_cast<SharedFrameHeader*>(header)) + SHARED_FRAME_HEADER;
+    return reinterpret_cast<SharedFrameSlot*>(base + (index % header->slotCount) * header->slotBytes);
+}
+
+SharedFrameWriter::~SharedFrameWriter() {
+    close();
+}
+
+SharedFrameReader::~SharedFrameReader() {
+    close();
+}
+
+// Publishes particle positions as one frame.
+bool SharedFrameWriter::publishParticles(const std::vector<Particle>& particles, int width, int height, uint64_t frame) {
+    float* out = static_cast<float*>(beginFrame(particles.size() * 2 * sizeof(float), width, height, frame));
+    if (out) {
+        for (size_t i = 0; i < particles.size(); ++i) {
+            out[2 * i] = particles[i].x;
+            out[2 * i + 1] = particles[i].y;
+        }
+    }
+    endFrame();
+    return out != nullptr;
+}
+
+#ifdef _WIN32
+
+bool SharedFrameWriter::open(const std::string& name, SharedFrameKind kind, size_t payloadBytes, std::string& error) {
+    error = "POSIX shared memory is not supported on this platform";
+    return false;
+}
+
+void SharedFrameWriter::close() {}
+
+void* SharedFrameWriter::beginFrame(size_t bytes, int width, int height, uint64_t frame) {
+    return nullptr;
+}
+
+void SharedFrameWriter::endFrame() {}
+
+bool SharedFrameReader::open(const std::string& name, std::string& error) {
+    error = "POSIX shared memory is not supported on this platform";
+    return false;
+}
+
+void SharedFrameReader::close() {}
+
+bool SharedFrameReader::latest(SharedFrameView& view, uint64_t lastFrame) {
+    return false;
+}
+
+bool SharedFrameReader::stillValid(const SharedFrameView& view) const {
+    return false;
+}
+
+#else
+
+// Creates the segment and publishes an empty ring.
+bool SharedFrameWriter::open(const std::string& segment, SharedFrameKind frameKind, size_t payloadBytes,
+                             std::string& error) {
+    close();
+    name = segment[0] == '/' ? segment : "/" + segment;
+    kind = frameKind;
+    return map(payloadBytes, error);
+}
+
+// Creates and maps a fresh segment under the writer's name.
+bool SharedFrameWriter::map(size_t payloadBytes, std::string& error) {
+    const size_t slotBytes = alignUp(SHARED_FRAME_PAYLOAD + payloadBytes);
+    const size_t total = SHARED_FRAME_HEADER + slotBytes * slotCount;
+
+    // Unlinking first means readers of an old segment keep their mapping until they reopen.
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd, total) < 0) {
+        error = std::strerror(errno);
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* memory = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        error = std::strerror(errno);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // The pages arrive zeroed, so every slot sequence starts even and empty.
+    header = static_cast<SharedFrameHeader*>(memory);
+    mappedBytes = total;
+    header->version = SHARED_FRAME_VERSION;
+    header->kind = kind;
+    header->slotCount = slotCount;
+    header->slotBytes = slotBytes;
+    header->published.store(0, std::memory_order_relaxed);
+    header->stale.store(0, std::memory_order_relaxed);
+    // Readers check the magic last, so it marks a finished header.
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHARED_FRAME_MAGIC;
+    return true;
+}
+
+// Marks the mapping stale for readers and drops it.
+void SharedFrameWriter::unmap() {
+    if (!header) return;
+    header->stale.store(1, std::memory_order_release);
+    munmap(header, mappedBytes);
+    header = nullptr;
+    mappedBytes = 0;
+}
+
+// Removes the segment.
+void SharedFrameWriter::close() {
+    if (!header) return;
+    unmap();
+    shm_unlink(name.c_str());
+}
+
+// Opens the next slot for writing, growing the segment if the frame does not fit.
+void* SharedFrameWriter::beginFrame(size_t bytes, int width, int height, uint64_t frame) {
+    current = nullptr;
+    if (!header) return nullptr;
+    if (SHARED_FRAME_PAYLOAD + bytes > header->slotBytes) {
+        unmap();
+        std::string error;
+        if (!map(bytes + bytes / 2, error)) return nullptr;
+        ++regrows;
+    }
+
+    current = slotAt(header, header->published.load(std::memory_order_relaxed));
+    const uint32_t sequence = current->sequence.load(std::memory_order_relaxed);
+    current->sequence.store(sequence + 1, std::memory_order_relaxed);
+    // Keeps the payload writes below from moving ahead of the odd sequence.
+    std::atomic_thread_fence(std::memory_order_release);
+    current->width = width;
+    current->height = height;
+    current->frame = frame;
+    current->bytes = bytes;
+    return reinterpret_cast<char*>(current) + SHARED_FRAME_PAYLOAD;
+}
+
+// Seals the slot and makes it the newest frame.
+void SharedFrameWriter::endFrame() {
+    if (!current) return;
+    const uint32_t sequence = current->sequence.load(std::memory_order_relaxed);
+    current->sequence.store(sequence + 1, std::memory_order_release);
+    header->published.fetch_add(1, std::memory_order_release);
+    current = nullptr;
+    ++framesPublished;
+}
+
+// Maps an existing segment read-only.
+bool SharedFrameReader::open(const std::string& segment, std::string& error) {
+    close();
+    name = segment[0] == '/' ? segment : "/" + segment;
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) < SHARED_FRAME_HEADER) {
+        error = "segment too small";
+        ::close(fd);
+        return false;
+    }
+    void* memory = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        error = std::strerror(errno);
+        return false;
+    }
+    header = static_cast<const SharedFrameHeader*>(memory);
+    mappedBytes = info.st_size;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->magic != SHARED_FRAME_MAGIC || header->version != SHARED_FRAME_VERSION ||
+        SHARED_FRAME_HEADER + header->slotBytes * header->slotCount > mappedBytes) {
+        error = "not a frame ring of this version";
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SharedFrameReader::close() {
+    if (!header) return;
+    munmap(const_cast<SharedFrameHeader*>(header), mappedBytes);
+    header = nullptr;
+    mappedBytes = 0;
+}
+
+// Points view at the newest complete frame, reopening the segment if the writer replaced it.
+bool SharedFrameReader::latest(SharedFrameView& view, uint64_t lastFrame) {
+    if (!header || header->stale.load(std::memory_order_acquire)) {
+        // The writer is between segments if this fails; try again next time.
+        const std::string segment = name;
+        std::string error;
+        if (segment.empty() || !open(segment, error)) return false;
+    }
+    const uint64_t published = header->published.load(std::memory_order_acquire);
+    if (published == 0) return false;
+
+    const SharedFrameSlot* slot = slotAt(header, published - 1);
+    const uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence & 1) return false;
+    if (slot->frame == lastFrame) return false;
+    view.slot = slot;
+    view.sequence = sequence;
+    view.width = slot->width;
+    view.height = slot->height;
+    view.frame = slot->frame;
+    view.bytes = slot->bytes;
+    view.data = reinterpret_cast<const char*>(slot) + SHARED_FRAME_PAYLOAD;
+    return stillValid(view);
+}
+
+// True if the slot's sequence has not moved since the view was taken.
+bool SharedFrameReader::stillValid(const SharedFrameView& view) const {
+    // Orders the caller's payload reads before the sequence check.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot && view.slot->sequence.load(std::memory_order_relaxed) == view.sequence &&
+           !header->stale.load(std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef SHAREDFRAMES_H
+#define SHAREDFRAMES_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Particle.h"
+
+// What the slots of a shared frame ring hold.
+enum class SharedFrameKind : uint32_t {
+    Pixels = 1,      // width * height RGBA8 pixels, bottom row first as glReadPixels returns them.
+    Particles = 2    // count (x, y) float32 pairs in pixels of a width * height plate.
+};
+
+// Layout of the shared-memory segment. A header page is followed by
+// slotCount slots of slotBytes each; every slot starts with a SharedFrameSlot
+// and its payload follows at SHARED_FRAME_PAYLOAD bytes.
+//
+// Each slot is guarded by a seqlock. The writer makes sequence odd, writes the
+// slot, then makes it even again. A reader loads an even sequence, reads the
+// payload in place and checks the sequence is unchanged afterwards; if not, the
+// frame was overwritten while being read and must be dropped. Frames go round
+// the ring, so a reader has slotCount - 1 frame times before its slot is reused.
+struct SharedFrameHeader {
+    uint32_t magic;
+    uint32_t version;
+    SharedFrameKind kind;
+    uint32_t slotCount;
+    uint64_t slotBytes;             // Including the slot header.
+    std::atomic<uint64_t> published; // Frames published; the newest is in slot (published - 1) % slotCount.
+    std::atomic<uint32_t> stale;     // Set when the writer replaced the segment; readers reopen it.
+};
+
+struct SharedFrameSlot {
+    std::atomic<uint32_t> sequence;  // Odd while the writer fills the slot.
+    uint32_t width, height;
+    uint64_t frame;                  // Simulation frame number.
+    uint64_t bytes;                  // Payload size.
+};
+
+static const uint32_t SHARED_FRAME_MAGIC = 0x43484c46;   // "CHLF"
+static const uint32_t SHARED_FRAME_VERSION = 1;
+static const size_t SHARED_FRAME_HEADER = 4096;
+static const size_t SHARED_FRAME_PAYLOAD = 64;
+
+// Publishes frames into a POSIX shared-memory ring. Frames are written
+// straight into the mapped slot, so a consumer reads the same memory the
+// simulator wrote without a socket or an extra copy.
+class SharedFrameWriter {
+public:
+    ~SharedFrameWriter();
+
+    // Creates the segment /name with room for frames of up to payloadBytes,
+    // replacing any old segment of that name. Returns false and fills error on
+    // failure, or on platforms without POSIX shared memory.
+    bool open(const std::string& name, SharedFrameKind kind, size_t payloadBytes, std::string& error);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    // Starts the next frame and returns where to write its payload, or nullptr
+    // if it does not fit and the segment cannot grow. Every call must be
+    // followed by endFrame.
+    void* beginFrame(size_t bytes, int width, int height, uint64_t frame);
+    void endFrame();
+
+    // Publishes particle positions as one frame.
+    bool publishParticles(const std::vector<Particle>& particles, int width, int height, uint64_t frame);
+
+    SharedFrameKind kind = SharedFrameKind::Pixels;
+    uint32_t slotCount = 3;
+    long long framesPublished = 0;
+    long long regrows = 0;   // Times a larger frame forced a new segment.
+
+private:
+    bool map(size_t payloadBytes, std::string& error);
+    void unmap();
+
+    std::string name;
+    SharedFrameHeader* header = nullptr;
+    size_t mappedBytes = 0;
+    SharedFrameSlot* current = nullptr;
+};
+
+// A frame read in place from the ring. Valid until the writer reuses its slot;
+// check SharedFrameReader::stillValid after using the payload.
+struct SharedFrameView {
+    const void* data = nullptr;
+    size_t bytes = 0;
+    int width = 0, height = 0;
+    uint64_t frame = 0;
+    const SharedFrameSlot* slot = nullptr;
+    uint32_t sequence = 0;
+};
+
+// Consumer side of a shared frame ring.
+class SharedFrameReader {
+public:
+    ~SharedFrameReader();
+
+    bool open(const std::string& name, std::string& error);
+    void close();
+
+    // Points view at the newest complete frame. Returns false if none has been
+    // published since lastFrame, or the segment is being replaced.
+    bool latest(SharedFrameView& view, uint64_t lastFrame = UINT64_MAX);
+
+    // True if the writer has not touched the frame's slot since latest returned it.
+    bool stillValid(const SharedFrameView& view) const;
+
+    SharedFrameKind kind() const { return header->kind; }
+
+private:
+    std::string name;
+    const SharedFrameHeader* header = nullptr;
+    size_t mappedBytes = 0;
+};
+
+#endif // SHAREDFRAMES_H
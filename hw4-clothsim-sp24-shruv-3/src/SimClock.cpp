@@ -0,0 +1,73 @@
+#include "SimClock.h"
+
+#include <algorithm>
+
+// Starts a loop iteration at wall time now.
+void SimClock::beginFrame(double now, bool active) {
+    if (!active) {
+        accumulator = 0;
+    } else if (lastTime >= 0) {
+        const double budget = static_cast<double>(maxFrameSteps) * substeps;
+        accumulator = std::min(accumulator + (now - lastTime) / stepSeconds * substeps, budget);
+    }
+    if (reportTime < 0) reportTime = now;
+    lastTime = now;
+    frameStart = now;
+    frameSteps = 0;
+    running = active;
+}
+
+// True while another step should run this iteration; counts it as run.
+bool SimClock::stepDue(double now) {
+    if (!running) return false;
+    if (mode == ClockMode::RealTime) {
+        if (accumulator < 1.0) return false;
+        accumulator -= 1.0;
+    } else {
+        if (renderEvery > 0 && stepsSinceRender >= renderEvery) return false;
+        if (frameSteps > 0 && now - frameStart >= batchSeconds) return false;
+    }
+    ++steps;
+    ++frameSteps;
+    ++stepsSinceRender;
+    return true;
+}
+
+// True if this iteration's state should be drawn.
+bool SimClock::renderDue() {
+    // Paused, or in real time, every iteration is drawn.
+    const bool due = mode == ClockMode::RealTime || !running ||
+                     (renderEvery > 0 && stepsSinceRender >= renderEvery);
+    if (due) {
+        stepsSinceRender = 0;
+        ++renders;
+    }
+    return due;
+}
+
+// Switches between real time and fast-forward.
+void SimClock::toggleFastForward() {
+    mode = mode == ClockMode::RealTime ? ClockMode::FastForward : ClockMode::RealTime;
+    accumulator = 0;
+    stepsSinceRender = 0;
+}
+
+// Prints steps, renders and steps per second since the last report.
+void SimClock::report(std::ostream& out, double now) {
+    const double seconds = reportTime < 0 ? 0 : now - reportTime;
+    const long long newSteps = steps - reportSteps, newRenders = renders - reportRenders;
+    out << "Clock: " << newSteps << " steps, " << newRenders << " frames drawn";
+    if (seconds > 0) {
+        out << " in " << seconds << " s (" << newSteps / seconds << " steps/s, " << newRenders / seconds
+            << " frames/s)";
+    }
+    out << std::endl;
+    reportTime = now;
+    reportSteps = steps;
+    reportRenders = renders;
+}
+
+// Name of a clock mode for status output.
+const char* clockModeName(ClockMode mode) {
+    return mode == ClockMode::RealTime ? "real time" : "fast-forward";
+}
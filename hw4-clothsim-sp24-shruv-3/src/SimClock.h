@@ -0,0 +1,68 @@
+#ifndef SIMCLOCK_H
+#define SIMCLOCK_H
+
+#include <ostream>
+
+// How simulation steps are paced against the wall clock.
+enum class ClockMode {
+    RealTime,     // substeps steps per stepSeconds of wall time, one render per frame.
+    FastForward   // Steps back to back, a render every renderEvery steps.
+};
+
+// Fixed-timestep scheduler of the particle steps. A step is the unit of
+// particle motion, so pacing steps by wall time instead of running one per
+// buffer swap makes the simulation speed independent of vsync and the
+// display's refresh rate. Each loop iteration calls beginFrame, then steps
+// while stepDue, then renders if renderDue.
+//
+// In real time, wall time is accumulated and spent in whole steps; a display
+// at 144 Hz runs fewer steps per frame than one at 60 Hz and the same number
+// per second. After a stall the backlog is dropped beyond maxFrameSteps, so a
+// slow frame cannot snowball into ever slower ones.
+// In fast-forward, steps run as fast as the CPU allows and only every
+// renderEvery-th state is drawn (none for 0). Steps stop after batchSeconds
+// even without a render, so the window keeps handling events.
+class SimClock {
+public:
+    ClockMode mode = ClockMode::RealTime;
+    double stepSeconds = 1.0 / 60.0;   // Wall time per step at one substep, the frame time the motion was tuned at.
+    int substeps = 1;                  // Steps per stepSeconds in real time.
+    int maxFrameSteps = 8;             // Most steps per frame in real time, times substeps.
+    int renderEvery = 16;              // Steps per render in fast-forward, 0 to never render.
+    double batchSeconds = 0.05;        // Longest stretch of fast-forward steps between event polls.
+
+    // Starts a loop iteration at wall time now; active is false while paused.
+    // No time accrues while paused, so resuming does not run it off in a burst.
+    void beginFrame(double now, bool active);
+
+    // True while another step should run this iteration; counts it as run.
+    // now is the current wall time, read by fast-forward only.
+    bool stepDue(double now);
+
+    // True if this iteration's state should be drawn.
+    bool renderDue();
+
+    // Switches between real time and fast-forward.
+    void toggleFastForward();
+
+    // Prints steps, renders and steps per second since the last report.
+    void report(std::ostream& out, double now);
+
+    long long steps = 0;     // Steps run in total.
+    long long renders = 0;   // Frames drawn in total.
+
+private:
+    double accumulator = 0;        // Unspent wall time in real time, in steps.
+    double lastTime = -1;          // Wall time of the previous beginFrame, -1 before the first.
+    double frameStart = 0;
+    int frameSteps = 0;            // Steps run in this iteration.
+    int stepsSinceRender = 0;
+    bool running = false;          // The simulation was running at beginFrame.
+    double reportTime = -1;
+    long long reportSteps = 0, reportRenders = 0;
+};
+
+// Name of a clock mode for status output.
+const char* clockModeName(ClockMode mode);
+
+#endif // SIMCLOCK_H
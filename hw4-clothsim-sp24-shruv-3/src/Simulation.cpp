@@ -0,0 +1,88 @@
+#include "Simulation.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+// List of Chladni parameters configurations.
+std::vector<ChladniParams> chladniParams = {
+        {1, 2, L1}, {1, 3, L3}, {2, 3, L2}, {1, 4, L2}, {2, 4, L2}, {3, 4, L2}, {1, 5, L2},
+          {2, 5, L2}, {3, 5, L2}, {3, 7, L2}
+};
+
+// Computes vibration values based on current Chladni parameters.
+void Simulation::computeVibrationValues(const ChladniParams& params) {
+    float TX = std::rand() % height;  // Random translation offset X
+    float TY = std::rand() % height;  // Random translation offset Y
+    computeVibrationValues(params, TX, TY);
+}
+
+// Computes vibration values with the pattern translated by (TX, TY).
+void Simulation::computeVibrationValues(const ChladniParams& params, float TX, float TY) {
+    vibrationValues.resize(width * height);
+
+    // Calculate vibration values across the grid.
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float scaledX = x * params.l + TX;
+            float scaledY = y * params.l + TY;
+            float NX = params.n * scaledX;
+            float MX = params.m * scaledX;
+            float NY = params.n * scaledY;
+            float MY = params.m * scaledY;
+
+            // Vibration formula for a Chladni plate.
+            float value = std::cos(NX) * std::cos(MY) - std::cos(MX) * std::cos(NY);
+            value /= 2; 
+            value *= std::copysign(1.0, value); 
+            vibrationValues[y * width + x] = value;
+        }
+    }
+}
+
+// Computes gradients from the vibration values to guide particle movement.
+void Simulation::computeGradients() {
+    gradients.resize(width * height);
+    #pragma omp parallel for schedule(static)
+    for (int y = 1; y < height - 1; ++y) {
+        for (int x = 1; x < width - 1; ++x) {
+            int index = y * width + x;
+            float currentVibration = vibrationValues[index];
+            if (std::abs(currentVibration) < 0.01) {  
+                gradients[index] = {0, 0};
+                continue;
+            }
+
+            Gradient bestGradient = {0, 0};
+            float minVibration = std::numeric_limits<float>::max();
+
+             // Find the gradient with minimum neighboring vibration value.
+            for (int ny = -1; ny <= 1; ++ny) {
+                for (int nx = -1; nx <= 1; ++nx) {
+                    if (nx == 0 && ny == 0) continue;
+
+                    int neighborIndex = (y + ny) * width + (x + nx);
+                    float neighborVibration = vibrationValues[neighborIndex];
+
+                    if (neighborVibration < minVibration) {
+                        minVibration = neighborVibration;
+                        bestGradient = {float(nx), float(ny)};
+                    }
+                }
+            }
+            gradients[index] = bestGradient;
+        }
+    }
+}
+
+float calculateFrequency(const ChladniParams& params) {
+    // Physical constants for steel
+    const float E = PLATE_YOUNGS_MODULUS;
+    const float density = PLATE_DENSITY;
+    const float h = PLATE_THICKNESS;
+    const float a = PLATE_SIDE;
+
+    // Frequency calculation for a square plate with free boundaries
+    float frequency = (PI / 2) * sqrt(E / density) * (h / (a * a)) * sqrt((params.m * params.m) + (params.n * params.n));
+    return frequency;
+}
@@ -0,0 +1,57 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <vector>
+
+// Constants for different Chladni plate parameters.
+const float L1 = 0.04;
+const float L2 = 0.02;
+const float L3 = 0.018;
+
+// Constant for PI.
+const float PI = 3.141592653589793238462643383279502884197;
+
+// Physical constants for the steel plate.
+const float PLATE_YOUNGS_MODULUS = 2.1e11f; // Young's modulus in Pascal
+const float PLATE_DENSITY = 7800.0f;        // Density in kg/m^3
+const float PLATE_THICKNESS = 0.01f;        // Plate thickness in meters
+const float PLATE_SIDE = 0.5f;              // Side length of the square plate in meters
+const float PLATE_POISSON_RATIO = 0.3f;     // Poisson's ratio
+
+// Structure to store Chladni parameters including mode numbers (m, n) and scaling factor (l).
+struct ChladniParams {
+    int m, n;
+    float l;
+    ChladniParams(int m, int n, float l) : m(m), n(n), l(l) {}
+};
+
+// List of Chladni parameters configurations.
+extern std::vector<ChladniParams> chladniParams;
+
+// Structure to store gradient vectors.
+struct Gradient {
+    float dx, dy;
+};
+
+// Class to manage the Chladni plate simulation.
+class Simulation {
+public:
+    std::vector<float> vibrationValues; // Stores vibration values at each grid point.
+    std::vector<Gradient> gradients;    // Stores gradient vectors for particle movement.
+    int width, height;                  // Dimensions of the simulation grid.
+
+    // Computes vibration values based on current Chladni parameters.
+    void computeVibrationValues(const ChladniParams& params);
+
+    // Computes vibration values with a given translation instead of a random one.
+    // Touches no shared state, so several simulations can be filled concurrently.
+    void computeVibrationValues(const ChladniParams& params, float offsetX, float offsetY);
+
+    // Computes gradients from the vibration values to guide particle movement.
+    void computeGradients();
+};
+
+// Returns the resonant frequency in Hz of the steel plate for the given mode.
+float calculateFrequency(const ChladniParams& params);
+
+#endif // SIMULATION_H
@@ -0,0 +1,188 @@
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Buckets per thread in SpatialGrid::build. Particles crowd onto nodal lines,
+// so many bands per thread let the dynamic schedule even out dense and empty ones.
+static const int BUCKETS_PER_THREAD = 16;
+
+// Particles per bucket aimed for with many particles, so the cell-level sort
+// of a bucket scatters within a range that stays in cache.
+static const int PARTICLES_PER_BUCKET = 16384;
+
+// Bins every on-screen particle into cells of the given size.
+// A two-level counting sort. Buckets are bands of whole cell rows, few enough
+// that per-thread bucket histograms stay small at any grid size and many
+// enough that each bucket's cell sort stays in cache. Each thread histograms
+// a contiguous slice of the particles by bucket, and the slices are scattered
+// into bucket order along with their cells and positions, so the second level
+// reads them sequentially. Each bucket is then sorted by cell on its own,
+// which also writes the cell offsets of its band, so no pass over all cells
+// is serial or repeated per thread. Both scatters are stable, so particles
+// keep their relative order inside a cell.
+void SpatialGrid::build(const std::vector<Particle>& particles, int width, int height, float size) {
+    cellSize = size;
+    cols = std::max(1, static_cast<int>(std::ceil(width / cellSize)));
+    rows = std::max(1, static_cast<int>(std::ceil(height / cellSize)));
+    const int numCells = cols * rows;
+    const int numParticles = static_cast<int>(particles.size());
+
+    int maxThreads = 1;
+#ifdef _OPENMP
+    maxThreads = omp_get_max_threads();
+#endif
+    const int wantedBuckets = std::max(BUCKETS_PER_THREAD * maxThreads, numParticles / PARTICLES_PER_BUCKET);
+    const int bandRows = std::max(1, (rows + wantedBuckets - 1) / wantedBuckets);
+    const int numBuckets = (rows + bandRows - 1) / bandRows;
+    const int bandCells = bandRows * cols;
+
+    cellStart.resize(numCells + 1);
+    cellKeys.resize(numParticles);
+    bucketEntries.resize(numParticles);
+    sortedIndices.resize(numParticles);
+    sortedX.resize(numParticles);
+    sortedY.resize(numParticles);
+    threadCounts.assign(static_cast<size_t>(maxThreads) * numBuckets, 0);
+    bucketStart.resize(numBuckets + 1);
+    if (bandCounts.size() < static_cast<size_t>(maxThreads) * bandCells) {
+        bandCounts.resize(static_cast<size_t>(maxThreads) * bandCells);
+    }
+
+    const float invCellSize = 1.0f / cellSize;
+
+    #pragma omp parallel
+    {
+        int thread = 0, numThreads = 1;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+        numThreads = omp_get_num_threads();
+#endif
+        const int begin = static_cast<int>(static_cast<long long>(numParticles) * thread / numThreads);
+        const int end = static_cast<int>(static_cast<long long>(numParticles) * (thread + 1) / numThreads);
+        int* counts = &threadCounts[static_cast<size_t>(thread) * numBuckets];
+
+        // Histogram this thread's slice by bucket.
+        for (int i = begin; i < end; ++i) {
+            const Particle& p = particles[i];
+            if (p.x < 0 || p.x >= width || p.y < 0 || p.y >= height) {
+                cellKeys[i] = -1;
+                continue;
+            }
+            int cx = std::min(static_cast<int>(p.x * invCellSize), cols - 1);
+            int cy = std::min(static_cast<int>(p.y * invCellSize), rows - 1);
+            cellKeys[i] = cy * cols + cx;
+            counts[cy / bandRows]++;
+        }
+        #pragma omp barrier
+
+        // Turn the counts into per-thread offsets, bucket by bucket; only
+        // numBuckets x numThreads entries, so one thread does it.
+        #pragma omp single
+        {
+            int running = 0;
+            for (int b = 0; b < numBuckets; ++b) {
+                bucketStart[b] = running;
+                for (int t = 0; t < numThreads; ++t) {
+                    int& count = threadCounts[static_cast<size_t>(t) * numBuckets + b];
+                    int n = count;
+                    count = running;
+                    running += n;
+                }
+            }
+            bucketStart[numBuckets] = running;
+            cellStart[numCells] = running;
+        }
+
+        // Scatter this thread's slice into bucket order.
+        for (int i = begin; i < end; ++i) {
+            int key = cellKeys[i];
+            if (key < 0) continue;
+            BucketEntry& entry = bucketEntries[counts[key / bandCells]++];
+            entry.cell = key;
+            entry.index = i;
+            entry.x = particles[i].x;
+            entry.y = particles[i].y;
+        }
+        #pragma omp barrier
+
+        // Sort each bucket by cell into the final arrays.
+        int* cellCounts = &bandCounts[static_cast<size_t>(thread) * bandCells];
+        #pragma omp for schedule(dynamic)
+        for (int b = 0; b < numBuckets; ++b) {
+            const int firstCell = b * bandCells;
+            const int cells = std::min(bandCells, numCells - firstCell);
+            const int first = bucketStart[b], last = bucketStart[b + 1];
+            std::fill(cellCounts, cellCounts + cells, 0);
+            for (int k = first; k < last; ++k) {
+                cellCounts[bucketEntries[k].cell - firstCell]++;
+            }
+            int running = first;
+            for (int c = 0; c < cells; ++c) {
+                int n = cellCounts[c];
+                cellStart[firstCell + c] = running;
+                cellCounts[c] = running;
+                running += n;
+            }
+            for (int k = first; k < last; ++k) {
+                const BucketEntry& entry = bucketEntries[k];
+                int slot = cellCounts[entry.cell - firstCell]++;
+                sortedIndices[slot] = entry.index;
+                sortedX[slot] = entry.x;
+                sortedY[slot] = entry.y;
+            }
+        }
+    }
+}
+
+// Pushes overlapping particles apart so piles on nodal lines keep a finite width.
+// Neighbours are read from the grid's sorted copy of the positions, so every
+// particle can be moved independently and the loop parallelises without locks.
+void applyRepulsion(std::vector<Particle>& particles, const SpatialGrid& grid, float radius, float strength) {
+    if (grid.cellStart.empty()) return;
+
+    const int total = grid.cellStart.back();
+    const float radiusSq = radius * radius;
+    const int reach = std::max(1, static_cast<int>(std::ceil(radius / grid.cellSize)));
+    const float invCellSize = 1.0f / grid.cellSize;
+
+    #pragma omp parallel for schedule(static)
+    for (int s = 0; s < total; ++s) {
+        const float px = grid.sortedX[s];
+        const float py = grid.sortedY[s];
+        const int cx = std::min(static_cast<int>(px * invCellSize), grid.cols - 1);
+        const int cy = std::min(static_cast<int>(py * invCellSize), grid.rows - 1);
+
+        float pushX = 0, pushY = 0;
+        for (int ny = std::max(0, cy - reach); ny <= std::min(grid.rows - 1, cy + reach); ++ny) {
+            for (int nx = std::max(0, cx - reach); nx <= std::min(grid.cols - 1, cx + reach); ++nx) {
+                const int cell = ny * grid.cols + nx;
+                for (int k = grid.cellStart[cell]; k < grid.cellStart[cell + 1]; ++k) {
+                    if (k == s) continue;
+                    float dx = px - grid.sortedX[k];
+                    float dy = py - grid.sortedY[k];
+                    float distSq = dx * dx + dy * dy;
+                    if (distSq >= radiusSq) continue;
+
+                    if (distSq == 0) {
+                        // Stacked exactly on top of each other: split them along x by index.
+                        pushX += (s < k ? -0.5f : 0.5f) * radius;
+                        continue;
+                    }
+                    float dist = std::sqrt(distSq);
+                    float overlap = (radius - dist) * 0.5f;
+                    pushX += dx / dist * overlap;
+                    pushY += dy / dist * overlap;
+                }
+            }
+        }
+
+        Particle& particle = particles[grid.sortedIndices[s]];
+        particle.x += pushX * strength;
+        particle.y += pushY * strength;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <vector>
+#include "Particle.h"
+
+// Uniform grid over the window used to find nearby particles.
+// Rebuilt every frame with a two-level counting sort, bands of rows and then
+// cells, so particles that share a cell end up next to each other in memory.
+class SpatialGrid {
+public:
+    float cellSize = 1.0f;               // Side length of a grid cell in pixels.
+    int cols = 0, rows = 0;              // Number of cells in each direction.
+    std::vector<int> cellStart;          // Offset of each cell's first entry, plus one past the end.
+    std::vector<int> sortedIndices;      // Particle indices grouped by cell.
+    std::vector<float> sortedX, sortedY; // Particle positions in the same order as sortedIndices.
+
+    // Bins every on-screen particle into cells of the given size.
+    void build(const std::vector<Particle>& particles, int width, int height, float cellSize);
+
+private:
+    // A particle on its way between the two levels of the sort.
+    struct BucketEntry {
+        int cell, index;
+        float x, y;
+    };
+
+    std::vector<int> cellKeys;     // Cell of each particle, or -1 when off-screen.
+    std::vector<BucketEntry> bucketEntries;  // Particles grouped by band of rows.
+    std::vector<int> bucketStart;  // Offset of each band's first entry, plus one past the end.
+    std::vector<int> threadCounts; // Per-thread band histograms, laid out thread-major.
+    std::vector<int> bandCounts;   // Per-thread cell counts of the band being sorted.
+};
+
+// Pushes overlapping particles apart so piles on nodal lines keep a finite width.
+// Particles closer than radius are separated by strength times their overlap.
+void applyRepulsion(std::vector<Particle>& particles, const SpatialGrid& grid, float radius, float strength);
+
+#endif // SPATIALGRID_H
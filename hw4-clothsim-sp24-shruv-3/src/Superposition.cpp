@@ -0,0 +1,107 @@
+#include "Superposition.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Columns of a row accumulated together; 512 floats stay in L1 with room for the tables.
+static const int TILE_WIDTH = 512;
+
+// Sets the grid size.
+void ModeSuperposition::resize(int newWidth, int newHeight) {
+    if (newWidth == width && newHeight == height) return;
+    width = newWidth;
+    height = newHeight;
+    xTables.clear();
+    yTables.clear();
+    xBank.clear();
+    yBank.clear();
+}
+
+// Returns the bank index of a 1D cosine table.
+int ModeSuperposition::table(std::vector<std::vector<float> >& tables,
+                             std::map<std::tuple<int, float, float>, int>& bank,
+                             int q, float l, float offset, int length) {
+    const std::tuple<int, float, float> key(q, l, offset);
+    auto found = bank.find(key);
+    if (found != bank.end()) return found->second;
+
+    // Same float arithmetic as computeVibrationValues, so single modes match it.
+    std::vector<float> values(length);
+    for (int i = 0; i < length; ++i) {
+        const float scaled = i * l + offset;
+        values[i] = std::cos(q * scaled);
+    }
+    tables.push_back(values);
+    const int index = static_cast<int>(tables.size()) - 1;
+    bank[key] = index;
+    return index;
+}
+
+// Writes the normalised magnitude of the weighted mode sum.
+void ModeSuperposition::evaluate(const std::vector<ChladniParams>& modes, const std::vector<float>& weights,
+                                 std::vector<float>& out) {
+    // Look up the tables of every mode with a nonzero weight. Pointers are
+    // taken afterwards because building a table may grow the bank.
+    std::vector<int> xnIndex, xmIndex, ymIndex, ynIndex;
+    std::vector<float> halfWeights;
+    float total = 0;
+    for (size_t k = 0; k < modes.size() && k < weights.size(); ++k) {
+        if (weights[k] == 0.0f) continue;
+        const ChladniParams& p = modes[k];
+        xnIndex.push_back(table(xTables, xBank, p.n, p.l, offsetX, width));
+        xmIndex.push_back(table(xTables, xBank, p.m, p.l, offsetX, width));
+        ymIndex.push_back(table(yTables, yBank, p.m, p.l, offsetY, height));
+        ynIndex.push_back(table(yTables, yBank, p.n, p.l, offsetY, height));
+        halfWeights.push_back(0.5f * weights[k]);
+        total += std::abs(weights[k]);
+    }
+    out.resize(static_cast<size_t>(width) * height);
+    if (total == 0.0f) {
+        std::fill(out.begin(), out.end(), 0.0f);
+        return;
+    }
+
+    const int count = static_cast<int>(halfWeights.size());
+    std::vector<const float*> xn(count), xm(count), ym(count), yn(count);
+    for (int k = 0; k < count; ++k) {
+        xn[k] = xTables[xnIndex[k]].data();
+        xm[k] = xTables[xmIndex[k]].data();
+        ym[k] = yTables[ymIndex[k]].data();
+        yn[k] = yTables[ynIndex[k]].data();
+    }
+    const float scale = 1.0f / total;
+    float* field = out.data();
+
+    #pragma omp parallel
+    {
+        // Row coefficients of each mode: (w/2) cos(m sy) and (w/2) cos(n sy).
+        std::vector<float> a(count), c(count);
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; ++y) {
+            for (int k = 0; k < count; ++k) {
+                a[k] = halfWeights[k] * ym[k][y];
+                c[k] = halfWeights[k] * yn[k][y];
+            }
+            float* row = field + static_cast<size_t>(y) * width;
+            for (int x0 = 0; x0 < width; x0 += TILE_WIDTH) {
+                const int length = std::min(TILE_WIDTH, width - x0);
+                float* tile = row + x0;
+                std::fill(tile, tile + length, 0.0f);
+                for (int k = 0; k < count; ++k) {
+                    const float* p = xn[k] + x0;
+                    const float* q = xm[k] + x0;
+                    const float ak = a[k], ck = c[k];
+                    #pragma omp simd
+                    for (int x = 0; x < length; ++x) {
+                        tile[x] += ak * p[x] - ck * q[x];
+                    }
+                }
+                #pragma omp simd
+                for (int x = 0; x < length; ++x) {
+                    tile[x] = std::abs(tile[x]) * scale;
+                }
+            }
+        }
+    }
+}
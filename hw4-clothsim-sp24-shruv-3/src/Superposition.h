@@ -0,0 +1,41 @@
+#ifndef SUPERPOSITION_H
+#define SUPERPOSITION_H
+
+#include <map>
+#include <tuple>
+#include <vector>
+#include "Simulation.h"
+
+// Weighted sums of analytic Chladni modes.
+// A mode cos(n sx) cos(m sy) - cos(m sx) cos(n sy) is separable, so each one
+// is four 1D cosine tables, kept in a bank shared between modes that use the
+// same wave number. A row of the sum is then
+//   sum_k (w_k/2) (cos(m_k sy) Xn_k[x] - cos(n_k sy) Xm_k[x]),
+// two multiply-adds per mode and cell with no trigonometry. Rows are built
+// in column tiles that stay in L1 while the tables of all K modes stream past,
+// so the cost is linear in K.
+class ModeSuperposition {
+public:
+    float offsetX = 0, offsetY = 0;   // Plate translation, as TX and TY in computeVibrationValues.
+
+    // Sets the grid size. Drops the table bank if the size changed.
+    void resize(int width, int height);
+
+    // Writes |sum_k weights[k] * mode_k| / sum_k |weights[k]| to out, in [0, 1].
+    // Modes with zero weight are skipped.
+    void evaluate(const std::vector<ChladniParams>& modes, const std::vector<float>& weights,
+                  std::vector<float>& out);
+
+    int tableCount() const { return static_cast<int>(xTables.size() + yTables.size()); }
+
+private:
+    // Returns the bank index of cos(q * (i * l + offset)) over one axis, building it on first use.
+    int table(std::vector<std::vector<float> >& tables, std::map<std::tuple<int, float, float>, int>& bank,
+              int q, float l, float offset, int length);
+
+    int width = 0, height = 0;
+    std::vector<std::vector<float> > xTables, yTables;
+    std::map<std::tuple<int, float, float>, int> xBank, yBank;   // (wave number, l, offset) -> table.
+};
+
+#endif // SUPERPOSITION_H
@@ -0,0 +1,209 @@
+#include "VideoStream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#endif
+
+VideoStreamer::~VideoStreamer() {
+    close();
+}
+
+// Format from a file name: .y4m (or stdout) streams Y4M, anything else raw RGB.
+VideoFormat VideoStreamer::formatFor(const std::string& path) {
+    if (path == "-") return VideoFormat::Y4m;
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0) return VideoFormat::Y4m;
+    return VideoFormat::RawRgb;
+}
+
+// Opens the output and starts the convert and write stages.
+bool VideoStreamer::open(const std::string& path, VideoFormat videoFormat, int frameWidth, int frameHeight, int fps,
+                         std::string& error) {
+    close();
+    if (path == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        output = stdout;
+        ownsOutput = false;
+    } else {
+        output = std::fopen(path.c_str(), "wb");
+        if (!output) {
+            error = std::strerror(errno);
+            return false;
+        }
+        ownsOutput = true;
+    }
+#ifndef _WIN32
+    // A consumer that exits early must fail the write, not kill the simulator.
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    format = videoFormat;
+    width = frameWidth;
+    height = frameHeight;
+    if (format == VideoFormat::Y4m) {
+        // Chroma planes are subsampled 2x2, so keep both sides even.
+        width &= ~1;
+        height &= ~1;
+        std::fprintf(output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+    }
+
+    const size_t packedBytes = format == VideoFormat::Y4m
+        ? static_cast<size_t>(width) * height * 3 / 2
+        : static_cast<size_t>(width) * height * 3;
+    slots.assign(slotCount, Slot());
+    free.reset(slotCount);
+    captured.reset(slotCount);
+    converted.reset(slotCount);
+    for (int i = 0; i < slotCount; ++i) {
+        slots[i].packed.resize(packedBytes);
+        free.push(i);
+    }
+    failed = false;
+    converter = std::thread(&VideoStreamer::convertLoop, this);
+    writer = std::thread(&VideoStreamer::writeLoop, this);
+    return true;
+}
+
+// Lets the queued frames drain through both stages, then closes the output.
+void VideoStreamer::close() {
+    if (!output) return;
+    captured.close();
+    converter.join();
+    converted.close();
+    writer.join();
+    free.close();
+    std::fflush(output);
+    if (ownsOutput) std::fclose(output);
+    output = nullptr;
+    slots.clear();
+}
+
+// Waits for a free slot and returns where to read the frame.
+uint8_t* VideoStreamer::acquire(int frameWidth, int frameHeight) {
+    auto start = std::chrono::steady_clock::now();
+    if (!free.pop(current)) {
+        current = -1;
+        return nullptr;
+    }
+    const double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    renderWaitSeconds += waited;
+    maxRenderWaitSeconds = std::max(maxRenderWaitSeconds, waited);
+
+    Slot& slot = slots[current];
+    slot.width = frameWidth;
+    slot.height = frameHeight;
+    slot.rgba.resize(static_cast<size_t>(frameWidth) * frameHeight * 4);
+    return slot.rgba.data();
+}
+
+// Hands the filled slot to the convert stage.
+void VideoStreamer::submit() {
+    if (current < 0) return;
+    captured.push(current);
+    current = -1;
+    ++framesSubmitted;
+}
+
+// Convert stage.
+void VideoStreamer::convertLoop() {
+    int index;
+    while (captured.pop(index)) {
+        convert(slots[index]);
+        converted.push(index);
+    }
+}
+
+// Write stage. After a failed write the frames are still recycled so the render thread never stalls.
+void VideoStreamer::writeLoop() {
+    static const char frameHeader[] = "FRAME\n";
+    int index;
+    while (converted.pop(index)) {
+        const std::vector<uint8_t>& packed = slots[index].packed;
+        if (!failed) {
+            bool ok = true;
+            if (format == VideoFormat::Y4m) ok = std::fwrite(frameHeader, 1, 6, output) == 6;
+            ok = ok && std::fwrite(packed.data(), 1, packed.size(), output) == packed.size();
+            if (ok) {
+                ++framesWritten;
+                bytesWritten += static_cast<long long>(packed.size()) + (format == VideoFormat::Y4m ? 6 : 0);
+            } else {
+                failed = true;
+            }
+        }
+        free.push(index);
+    }
+}
+
+// Flips the RGBA frame to top row first, fits it to the stream size and packs it.
+void VideoStreamer::convert(Slot& slot) const {
+    const uint8_t* rgba = slot.rgba.data();
+    uint8_t* out = slot.packed.data();
+    const int copyWidth = std::min(width, slot.width);
+    const int copyHeight = std::min(height, slot.height);
+
+    // Source pixel of output row y (top first), or nullptr for padding.
+    auto sourceRow = [&](int y) -> const uint8_t* {
+        const int fromBottom = height - 1 - y;
+        if (fromBottom >= copyHeight) return nullptr;
+        return rgba + static_cast<size_t>(fromBottom) * slot.width * 4;
+    };
+
+    if (format == VideoFormat::RawRgb) {
+        for (int y = 0; y < height; ++y) {
+            const uint8_t* src = sourceRow(y);
+            uint8_t* dst = out + static_cast<size_t>(y) * width * 3;
+            std::memset(dst, 0, static_cast<size_t>(width) * 3);
+            if (!src) continue;
+            for (int x = 0; x < copyWidth; ++x) {
+                dst[3 * x] = src[4 * x];
+                dst[3 * x + 1] = src[4 * x + 1];
+                dst[3 * x + 2] = src[4 * x + 2];
+            }
+        }
+        return;
+    }
+
+    // Full-range BT.601 in 16.16 fixed point. Padding is black: Y 0, chroma 128.
+    uint8_t* yPlane = out;
+    uint8_t* uPlane = yPlane + static_cast<size_t>(width) * height;
+    uint8_t* vPlane = uPlane + static_cast<size_t>(width / 2) * (height / 2);
+    std::memset(yPlane, 0, static_cast<size_t>(width) * height);
+    std::memset(uPlane, 128, static_cast<size_t>(width / 2) * (height / 2) * 2);
+    for (int y = 0; y < height; y += 2) {
+        const uint8_t* rows[2] = {sourceRow(y), sourceRow(y + 1)};
+        for (int x = 0; x < width; x += 2) {
+            int r = 0, g = 0, b = 0;
+            for (int dy = 0; dy < 2; ++dy) {
+                for (int dx = 0; dx < 2; ++dx) {
+                    int pr = 0, pg = 0, pb = 0;
+                    if (rows[dy] && x + dx < copyWidth) {
+                        const uint8_t* p = rows[dy] + 4 * (x + dx);
+                        pr = p[0];
+                        pg = p[1];
+                        pb = p[2];
+                    }
+                    yPlane[static_cast<size_t>(y + dy) * width + x + dx] =
+                        static_cast<uint8_t>((19595 * pr + 38470 * pg + 7471 * pb + 32768) >> 16);
+                    r += pr;
+                    g += pg;
+                    b += pb;
+                }
+            }
+            // Chroma of the 2x2 average; the sums carry 4x the value, hence >> 18.
+            const int u = (-11059 * r - 21709 * g + 32768 * b + (128 << 18) + (1 << 17)) >> 18;
+            const int v = (32768 * r - 27439 * g - 5329 * b + (128 << 18) + (1 << 17)) >> 18;
+            const size_t c = static_cast<size_t>(y / 2) * (width / 2) + x / 2;
+            uPlane[c] = static_cast<uint8_t>(std::min(255, std::max(0, u)));
+            vPlane[c] = static_cast<uint8_t>(std::min(255, std::max(0, v)));
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef VIDEOSTREAM_H
+#define VIDEOSTREAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BoundedQueue.h"
+
+// Container of a video stream.
+enum class VideoFormat {
+    Y4m,      // YUV4MPEG2 with 4:2:0 full-range BT.601 planes; players and ffmpeg read it directly.
+    RawRgb    // Bare rgb24 frames, top row first: ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -r FPS -i ...
+};
+
+// Streams rendered frames to a file or stdout without losing any.
+// The render thread only reads pixels into a free slot and queues it. A
+// convert thread flips the rows and converts the colour, and a write thread
+// writes the result, so both run concurrently with the next frames. A fixed
+// number of slots circulates free -> captured -> converted -> written -> free
+// through bounded queues; if the writer falls behind, acquire waits for a slot
+// instead of dropping the frame.
+class VideoStreamer {
+public:
+    ~VideoStreamer();
+
+    // Opens path ("-" for stdout) for frames of the given size. Frames of
+    // another size, e.g. after a window resize, are cropped or padded with
+    // black from the bottom-left corner. Returns false and fills error on failure.
+    bool open(const std::string& path, VideoFormat format, int width, int height, int fps, std::string& error);
+
+    // Flushes every queued frame and closes the output.
+    void close();
+    bool isOpen() const { return output != nullptr; }
+
+    // Render thread: waits for a free slot and returns where to read a
+    // width * height RGBA8 frame, bottom row first as glReadPixels writes it.
+    // Every call must be followed by submit.
+    uint8_t* acquire(int width, int height);
+    void submit();
+
+    // Format from a file name: .y4m (or stdout) streams Y4M, anything else raw RGB.
+    static VideoFormat formatFor(const std::string& path);
+
+    int slotCount = 8;   // Frames in flight, set before open.
+
+    // Statistics.
+    long long framesSubmitted = 0;
+    std::atomic<long long> framesWritten{0};
+    std::atomic<long long> bytesWritten{0};
+    double renderWaitSeconds = 0;     // Time acquire spent waiting for the writer.
+    double maxRenderWaitSeconds = 0;
+    std::atomic<bool> failed{false};  // The output stopped accepting data, e.g. a closed pipe.
+
+private:
+    struct Slot {
+        std::vector<uint8_t> rgba;
+        std::vector<uint8_t> packed;   // Converted frame as written.
+        int width = 0, height = 0;
+    };
+
+    void convertLoop();
+    void writeLoop();
+    void convert(Slot& slot) const;
+
+    VideoFormat format = VideoFormat::Y4m;
+    int width = 0, height = 0;
+    FILE* output = nullptr;
+    bool ownsOutput = false;
+    std::vector<Slot> slots;
+    BoundedQueue<int> free, captured, converted;   // Slot indices.
+    int current = -1;
+    std::thread converter, writer;
+};
+
+#endif // VIDEOSTREAM_H
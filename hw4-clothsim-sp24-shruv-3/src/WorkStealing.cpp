@@ -0,0 +1,99 @@
+#include "WorkStealing.h"
+
+#include <algorithm>
+
+// Starts the background workers.
+WorkStealingPool::WorkStealingPool(int threadCount) : batch(nullptr), remaining(0), stealCount(0) {
+    if (threadCount <= 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < threadCount; ++i) {
+        workers.push_back(std::unique_ptr<Worker>(new Worker));
+    }
+    for (int i = 1; i < threadCount; ++i) {
+        threads.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+    }
+}
+
+// Stops and joins the background workers.
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> guard(startLock);
+        stopping = true;
+    }
+    startSignal.notify_all();
+    for (std::thread& thread : threads) thread.join();
+}
+
+// Runs one task, from the worker's own deque if it has any, else stolen.
+// Returns false if every deque was empty.
+bool WorkStealingPool::runOne(int worker) {
+    const int count = threadCount();
+    int task = -1;
+    bool stolen = false;
+    {
+        Worker& own = *workers[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.queue.empty()) {
+            task = own.queue.back();
+            own.queue.pop_back();
+        }
+    }
+    for (int i = 1; task < 0 && i < count; ++i) {
+        Worker& victim = *workers[(worker + i) % count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.queue.empty()) {
+            task = victim.queue.front();
+            victim.queue.pop_front();
+            stolen = true;
+        }
+    }
+    if (task < 0) return false;
+
+    (*batch.load(std::memory_order_acquire))[task]();
+    if (stolen) stealCount.fetch_add(1, std::memory_order_relaxed);
+    remaining.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+// Background worker: waits for a batch and helps until it is drained.
+void WorkStealingPool::workerLoop(int worker) {
+    long long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(startLock);
+            startSignal.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            if (!runOne(worker)) std::this_thread::yield();
+        }
+    }
+}
+
+// Runs every task and returns once all have finished.
+void WorkStealingPool::run(const std::vector<Task>& tasks, const std::vector<int>& homes) {
+    if (tasks.empty()) return;
+    const int count = threadCount();
+    // Publish the batch and its count before the first task is queued: a
+    // worker still draining the previous batch may take a task the moment it
+    // is pushed, and its decrement must land on this batch's count.
+    batch.store(&tasks, std::memory_order_release);
+    remaining.store(static_cast<int>(tasks.size()), std::memory_order_release);
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        Worker& home = *workers[(i < homes.size() ? homes[i] : static_cast<int>(i)) % count];
+        std::lock_guard<std::mutex> guard(home.lock);
+        home.queue.push_back(static_cast<int>(i));
+    }
+    {
+        std::lock_guard<std::mutex> guard(startLock);
+        ++generation;
+    }
+    startSignal.notify_all();
+
+    // Help until every task has finished, including those still running elsewhere.
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (!runOne(0)) std::this_thread::yield();
+    }
+    tasksRun += static_cast<long long>(tasks.size());
+    steals = stealCount.load(std::memory_order_relaxed);
+}
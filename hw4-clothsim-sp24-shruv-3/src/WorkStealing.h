@@ -0,0 +1,59 @@
+#ifndef WORKSTEALING_H
+#define WORKSTEALING_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of threads that runs batches of tasks with work stealing.
+// Every worker owns a deque. A batch places each task on the deque of its
+// home worker; workers take their own tasks from the back (most recently
+// queued, still warm in cache) and, once empty, steal from the front of the
+// other deques. The calling thread works as worker 0, so a pool of one
+// thread runs everything inline.
+// Tasks must not use OpenMP: each pool thread would start a team of its own.
+class WorkStealingPool {
+public:
+    typedef std::function<void()> Task;
+
+    // Starts threads - 1 background workers; 0 uses every hardware thread.
+    explicit WorkStealingPool(int threads = 0);
+    ~WorkStealingPool();
+
+    // Runs every task and returns once all have finished. homes[i] is the
+    // preferred worker of tasks[i], taken modulo the thread count.
+    void run(const std::vector<Task>& tasks, const std::vector<int>& homes);
+
+    int threadCount() const { return static_cast<int>(workers.size()); }
+
+    // Statistics over every batch.
+    long long tasksRun = 0;
+    long long steals = 0;    // Tasks run by a worker other than their home.
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<int> queue;   // Indices into the current batch.
+    };
+
+    bool runOne(int worker);
+    void workerLoop(int worker);
+
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::vector<std::thread> threads;
+    std::atomic<const std::vector<Task>*> batch;   // Published before any of its tasks is queued.
+    std::atomic<int> remaining;
+    std::atomic<long long> stealCount;
+
+    std::mutex startLock;
+    std::condition_variable startSignal;
+    long long generation = 0;    // Batches started; workers wake when it changes.
+    bool stopping = false;
+};
+
+#endif // WORKSTEALING_H
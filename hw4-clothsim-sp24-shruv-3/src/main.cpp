@@ -3,125 +3,162 @@
 #include <vector>
 #include <cmath>
 #include <random>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include "Particle.h"
+#include "Integrator.h"
+#include "Simulation.h"
+#include "SpatialGrid.h"
+#include "MortonSort.h"
+#include "ParticlePool.h"
+#include "Boundary.h"
+#include "Plate.h"
+#include "Multigrid.h"
+#include "ShapeModes.h"
+#include "CircularPlate.h"
+#include "ModeBlend.h"
+#include "Audio.h"
+#include "ModeIndex.h"
+#include "Superposition.h"
+#include "Control.h"
+#include "SharedFrames.h"
+#include "VideoStream.h"
+#include "PngDump.h"
+#include "FieldExr.h"
+#include "MeasuredField.h"
+#include "RunSpec.h"
+#include "Regression.h"
+#include "SimClock.h"
+#include "Renderer.h"
+#include "Benchmark.h"
 
 
-// Constants for different Chladni plate parameters.
-const float L1 = 0.04;
-const float L2 = 0.02;
-const float L3 = 0.018;
-
 // Index to track which Chladni parameter set is currently active.
 int currentParamIndex = 0;
 
-// Constant for PI.
-const float PI = 3.141592653589793238462643383279502884197;
-
-// Structure to store Chladni parameters including mode numbers (m, n) and scaling factor (l).
-struct ChladniParams {
-    int m, n;
-    float l;
-    ChladniParams(int m, int n, float l) : m(m), n(n), l(l) {}
+// Where the vibration field comes from.
+enum class FieldSource {
+    Analytic,        // Closed-form cos*cos superposition.
+    PlateFdtd,       // Driven plate solved in the time domain.
+    PlateMultigrid,  // Driven plate solved in the frequency domain with multigrid.
+    MaskModes,       // Eigenmodes of a plate shape loaded from a mask image.
+    CircularModes,   // Bessel modes of a circular plate.
+    Measured         // Displacement scans of real plates given with --scan.
 };
+FieldSource fieldSource = FieldSource::Analytic;
 
-// List of Chladni parameters configurations.
-std::vector<ChladniParams> chladniParams = {
-        {1, 2, L1}, {1, 3, L3}, {2, 3, L2}, {1, 4, L2}, {2, 4, L2}, {3, 4, L2}, {1, 5, L2},
-          {2, 5, L2}, {3, 5, L2}, {3, 7, L2}
-};
+// Function prototypes
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void initializeParticles(std::vector<Particle>& particles, int gridWidth, int gridHeight);
+void updateParticles(std::vector<Particle>& particles, ParticleVelocities& velocities, Simulation& sim,
+                     int gridWidth, int gridHeight, bool isRunning);
+void initializeParticlesAtMouse(ParticlePool& pool, int count, float posX, float posY);
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+void framebufferSizeCallback(GLFWwindow* window, int width, int height);
+void displayFrequency(GLFWwindow* window, float frequency);
+void buildPattern(Simulation& sim, PlateSolver& plate, PlateMultigrid& multigrid, int pattern);
+void preparePatterns(const Simulation& sim, PlateSolver& plate, PlateMultigrid& multigrid,
+                     const ModeBlender::Builder& builder);
+bool addScan(const std::string& filename, float frequency);
+int patternCount();
+float patternFrequency(int index);
+std::vector<float> patternFrequencies();
+
+// Global variables to control simulation state.
+bool isRunning = false;
+bool needsReset = false;
+bool needsRebuild = false;   // Cached patterns are stale, e.g. after a field source change.
+float currentFrequency = 0.0;
+
+// Modes of the plate shape given with --mask, if any.
+ShapeModeSolver shapeModes;
+
+// Tabulated Bessel modes of the circular plate.
+CircularPlate circularPlate;
 
-// Structure to store gradient vectors.
-struct Gradient {
-    float dx, dy;
+// Measured scans given with --scan, one pattern each, decoded once and resampled on every rebuild.
+struct ScanPattern {
+    std::string filename;
+    float frequency;   // Drive frequency in Hz if given as file@Hz, else 0.
 };
+std::vector<ScanPattern> scanPatterns;
+MeasuredFieldCache scanCache;
+ResampleFilter scanFilter = ResampleFilter::Lanczos3;
 
-// Class to manage the Chladni plate simulation.
-class Simulation {
-public:
-    std::vector<float> vibrationValues; // Stores vibration values at each grid point.
-    std::vector<Gradient> gradients;    // Stores gradient vectors for particle movement.
-    int width, height;                  // Dimensions of the simulation grid.
-
-     // Computes vibration values based on current Chladni parameters.
-    void computeVibrationValues(const ChladniParams& params) {
-        vibrationValues.resize(width * height);
-        float TX = std::rand() % height;  // Random translation offset X
-        float TY = std::rand() % height;  // Random translation offset Y
-
-        // Calculate vibration values across the grid.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                float scaledX = x * params.l + TX;
-                float scaledY = y * params.l + TY;
-                float NX = params.n * scaledX;
-                float MX = params.m * scaledX;
-                float NY = params.n * scaledY;
-                float MY = params.m * scaledY;
-
-                // Vibration formula for a Chladni plate.
-                float value = std::cos(NX) * std::cos(MY) - std::cos(MX) * std::cos(NY);
-                value /= 2; 
-                value *= std::copysign(1.0, value); 
-                vibrationValues[y * width + x] = value;
-            }
-        }
-    }
+// Crossfades and sweeps between the cached patterns of the current field source.
+ModeBlender blender;
 
-    // Computes gradients from the vibration values to guide particle movement.
-    void computeGradients() {
-        gradients.resize(width * height);
-        for (int y = 1; y < height - 1; ++y) {
-            for (int x = 1; x < width - 1; ++x) {
-                int index = y * width + x;
-                float currentVibration = vibrationValues[index];
-                if (std::abs(currentVibration) < 0.01) {  
-                    gradients[index] = {0, 0};
-                    continue;
-                }
+// Square-plate modes by frequency, for naming the mode nearest to the shown frequency.
+const int modeIndexOrder = 20;
+ModeIndex squareModes;
 
-                Gradient bestGradient = {0, 0};
-                float minVibration = std::numeric_limits<float>::max();
+// Pattern weights driven by a WAV file given with --audio, if any.
+AudioExcitation audio;
+bool audioActive = false;
 
-                 // Find the gradient with minimum neighboring vibration value.
-                for (int ny = -1; ny <= 1; ++ny) {
-                    for (int nx = -1; nx <= 1; ++nx) {
-                        if (nx == 0 && ny == 0) continue;
+// Sums analytic modes with their signs, so excited modes interfere as on a real plate.
+ModeSuperposition superposition;
 
-                        int neighborIndex = (y + ny) * width + (x + nx);
-                        float neighborVibration = vibrationValues[neighborIndex];
+// Commands from show-control software on a Unix-domain socket, given with --control.
+ControlServer control;
 
-                        if (neighborVibration < minVibration) {
-                            minVibration = neighborVibration;
-                            bestGradient = {float(nx), float(ny)};
-                        }
-                    }
-                }
-                gradients[index] = bestGradient;
-            }
-        }
-    }
-};
+// Rendered frames or particle positions published to shared memory, given with --shm or --shm-particles.
+SharedFrameWriter frameExport;
 
+// Rendered frames streamed to a file or stdout, given with --video.
+VideoStreamer video;
+std::string videoPath;
+const int videoFps = 60;
 
-// Particle structure for representing individual particles in the simulation.
-struct Particle {
-    float x, y;    // Position of the particle.
-    Particle(float x, float y) : x(x), y(y) {}
-};
+// Frame dumps saved with P as chladni_<n>.png.
+bool needsScreenshot = false;
+int screenshotCount = 0;
 
-// Function prototypes
-void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
-void initializeParticles(std::vector<Particle>& particles, int windowWidth, int windowHeight);
-void updateParticles(std::vector<Particle>& particles, int windowWidth, int windowHeight, bool isRunning);
-void renderParticles(const std::vector<Particle>& particles, int windowWidth, int windowHeight);
-void initializeParticlesAtMouse(std::vector<Particle>& particles, int windowWidth, int windowHeight, int count, float posX, float posY);
-void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
-float calculateFrequency(const ChladniParams& params);
-void displayFrequency(GLFWwindow* window, float frequency);
+// Field dumps saved with E as chladni_field_<n>.exr.
+bool needsFieldDump = false;
+int fieldDumpCount = 0;
 
-// Global variables to control simulation state.
-bool isRunning = false;
-bool needsResize = false;
-float currentFrequency = 0.0;
+// Run settings from --spec, or their defaults: grid, modes, particle budget, seed, outputs.
+RunSpec runSpec;
+
+// Drives the particle positions and the analytic pattern offsets; seeded from the spec if it has a seed.
+std::mt19937 runRandom;
+
+// Translation of the analytic plate, drawn whenever the patterns are rebuilt.
+// Shared by every analytic pattern and by the audio superposition, so a mode
+// looks the same whether it is selected, blended or excited by the recording.
+std::pair<float, float> analyticOffset;
+
+// Paces the particle steps by wall time, or runs them flat out with every Nth state drawn.
+SimClock simClock;
+
+// Draws the field grid into the window through a view transform; window resizes only change the transform.
+Renderer renderer;
+
+// Particle storage limits. The pool never grows past the spec's capacity.
+const int reclaimBudget = 65536;   // Slots checked for escaped particles per frame.
+const int compactInterval = 600;   // Frames between removals of escaped particles.
+const int particleChunk = 16384;   // Particles per parallel task of a step.
+
+// How particles move: the positional random walk or damped inertial motion.
+IntegratorKind integratorKind = IntegratorKind::Jitter;
+InertialIntegrator inertialIntegrator;
+
+// Annealing of the jitter walk, and the steps since the field last changed, from which global annealing counts.
+JitterSchedule jitterSchedule;
+long long annealSteps = 0;
+
+// What happens to particles that leave the window.
+BoundaryPolicy boundaryPolicy = BoundaryPolicy::Kill;
+bool needsCompaction = false;
+
+// Particle-particle collision settings.
+bool collisionsEnabled = false;
+float particleRadius = 1.5f;     // Minimum spacing between particles in pixels.
+float repulsionStrength = 0.5f;  // Fraction of the overlap resolved per frame.
 
 // Function to handle key press events.
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -132,42 +169,235 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
                 isRunning = !isRunning;
                 break;
             case GLFW_KEY_R: 
-            // Resize
-                needsResize = true;
+            // Respawn the particles; the field grid keeps its resolution whatever the window size
+                needsReset = true;
                 break;
             case GLFW_KEY_UP: 
-            // Increase frequency pattern
-                currentParamIndex = (currentParamIndex + 1) % chladniParams.size();
-                needsResize = true;
-                currentFrequency = calculateFrequency(chladniParams[currentParamIndex]);
-                displayFrequency(window, currentFrequency);
+            // Crossfade to the next frequency pattern
+                blender.step(1);
                 break;
             case GLFW_KEY_DOWN: 
-            // Decrease frequency pattern
-                currentParamIndex = (currentParamIndex - 1 + chladniParams.size()) % chladniParams.size();
-                needsResize = true;  
-                currentFrequency = calculateFrequency(chladniParams[currentParamIndex]);
-                displayFrequency(window, currentFrequency);
+            // Crossfade to the previous frequency pattern
+                blender.step(-1);
                 break;
+            case GLFW_KEY_S:
+            // Toggle the continuous frequency sweep
+                blender.toggleSweep();
+                break;
+            case GLFW_KEY_P:
+            // Save the current frame as a PNG
+                needsScreenshot = true;
+                break;
+            case GLFW_KEY_E:
+            // Save the vibration field and gradients as a tiled EXR
+                needsFieldDump = true;
+                break;
+            case GLFW_KEY_T:
+            // Toggle fast-forward; vsync would cap the steps at the refresh rate, so it is off meanwhile
+                simClock.report(std::cout, glfwGetTime());
+                simClock.toggleFastForward();
+                glfwSwapInterval(simClock.mode == ClockMode::FastForward ? 0 : 1);
+                std::cout << "Clock: " << clockModeName(simClock.mode) << std::endl;
+                break;
+            case GLFW_KEY_I:
+            // Toggle the inertial integrator; particles start from rest
+                integratorKind = integratorKind == IntegratorKind::Jitter ? IntegratorKind::Inertial
+                                                                          : IntegratorKind::Jitter;
+                if (void* pool = glfwGetWindowUserPointer(window)) static_cast<ParticlePool*>(pool)->velocities.clear();
+                std::cout << "Integrator: " << integratorName(integratorKind) << std::endl;
+                break;
+            case GLFW_KEY_J:
+            // Cycle the jitter annealing: fixed, global, local
+                jitterSchedule.mode = static_cast<AnnealMode>((static_cast<int>(jitterSchedule.mode) + 1) % 3);
+                annealSteps = 0;
+                std::cout << "Jitter annealing: " << annealModeName(jitterSchedule.mode) << std::endl;
+                break;
+            case GLFW_KEY_C:
+            // Toggle particle-particle collisions
+                collisionsEnabled = !collisionsEnabled;
+                break;
+            case GLFW_KEY_B:
+            // Cycle the boundary policy
+                boundaryPolicy = static_cast<BoundaryPolicy>((static_cast<int>(boundaryPolicy) + 1) % 4);
+                // Drop escaped and parked particles so the new policy cannot revive recycled slots
+                needsCompaction = true;
+                std::cout << "Boundary policy: " << boundaryPolicyName(boundaryPolicy) << std::endl;
+                break;
+            case GLFW_KEY_F:
+            // Cycle the analytic field, the plate solvers, the mask modes, the circular plate and the scans
+                if (fieldSource == FieldSource::Analytic) {
+                    fieldSource = FieldSource::PlateFdtd;
+                } else if (fieldSource == FieldSource::PlateFdtd) {
+                    fieldSource = FieldSource::PlateMultigrid;
+                } else if (fieldSource == FieldSource::PlateMultigrid && shapeModes.computedModes() > 0) {
+                    fieldSource = FieldSource::MaskModes;
+                } else if (fieldSource == FieldSource::PlateMultigrid || fieldSource == FieldSource::MaskModes) {
+                    fieldSource = FieldSource::CircularModes;
+                } else if (fieldSource == FieldSource::CircularModes && !scanPatterns.empty()) {
+                    fieldSource = FieldSource::Measured;
+                } else {
+                    fieldSource = FieldSource::Analytic;
+                }
+                currentParamIndex = 0;
+                needsReset = true;
+                needsRebuild = true;
+                break;
+        }
+    }
+}
+
+// Number of patterns UP/DOWN cycle through for the current field source.
+int patternCount() {
+    if (fieldSource == FieldSource::MaskModes) return shapeModes.computedModes();
+    if (fieldSource == FieldSource::CircularModes) return static_cast<int>(circularModes.size());
+    if (fieldSource == FieldSource::Measured) return static_cast<int>(scanPatterns.size());
+    return static_cast<int>(chladniParams.size());
+}
+
+// Frequency in Hz of a pattern of the current field source.
+float patternFrequency(int index) {
+    if (fieldSource == FieldSource::MaskModes) return shapeModes.frequency(index);
+    if (fieldSource == FieldSource::CircularModes) return circularFrequency(circularModes[index]);
+    if (fieldSource == FieldSource::Measured) return scanPatterns[index].frequency;
+    return calculateFrequency(chladniParams[index]);
+}
+
+// Resonant frequency of every pattern of the current field source.
+std::vector<float> patternFrequencies() {
+    std::vector<float> frequencies(patternCount());
+    for (size_t i = 0; i < frequencies.size(); ++i) {
+        frequencies[i] = patternFrequency(static_cast<int>(i));
+    }
+    return frequencies;
+}
+
+// Builds the vibration field of a pattern of the current field source.
+void buildPattern(Simulation& sim, PlateSolver& plate, PlateMultigrid& multigrid, int pattern) {
+    switch (fieldSource) {
+        case FieldSource::Analytic:
+            sim.computeVibrationValues(chladniParams[pattern], analyticOffset.first, analyticOffset.second);
+            break;
+        case FieldSource::PlateFdtd: {
+            float frequency = calculateFrequency(chladniParams[pattern]);
+            bool steady = plate.solve(frequency);
+            plate.sampleAmplitude(sim.vibrationValues, sim.width, sim.height);
+            std::cout << "Plate solver: " << frequency << " Hz, " << plate.steps << " steps, "
+                      << plate.seconds << " s" << (steady ? "" : " (not steady)") << std::endl;
+            break;
+        }
+        case FieldSource::PlateMultigrid: {
+            float frequency = calculateFrequency(chladniParams[pattern]);
+            bool converged = multigrid.solve(frequency);
+            multigrid.sampleAmplitude(sim.vibrationValues, sim.width, sim.height);
+            std::cout << "Plate multigrid: " << frequency << " Hz, " << multigrid.cycles << " cycles, rate "
+                      << multigrid.convergenceRate << ", " << multigrid.seconds << " s"
+                      << (converged ? "" : " (not converged)") << std::endl;
+            break;
+        }
+        case FieldSource::MaskModes:
+            shapeModes.sampleMode(pattern, sim.vibrationValues, sim.width, sim.height);
+            break;
+        case FieldSource::CircularModes:
+            circularPlate.sampleMode(circularModes[pattern], sim.vibrationValues, sim.width, sim.height);
+            break;
+        case FieldSource::Measured: {
+            // Decoded only the first time or after the file changed; resampled for the current grid
+            std::string error;
+            std::shared_ptr<const MeasuredScan> scan = scanCache.load(scanPatterns[pattern].filename, error);
+            if (!scan) {
+                std::cerr << "Failed to load scan " << scanPatterns[pattern].filename << ": " << error << std::endl;
+                sim.vibrationValues.assign(static_cast<size_t>(sim.width) * sim.height, 1.0f);
+                break;
+            }
+            resampleScan(*scan, scanFilter, sim.vibrationValues, sim.width, sim.height);
+            break;
         }
     }
 }
 
-float calculateFrequency(const ChladniParams& params) {
-    // Physical constants for steel
-    const float E = 2.1e11f; // Young's modulus in Pascal
-    const float density = 7800.0f; // Density in kg/m^3
-    const float h = 0.01f; // Plate thickness in meters
-    const float a = 0.5f; // Side length of the square plate in meters
+// How the patterns of the current field source can be built. The plate
+// solvers and the circular plate's lookup tables are shared, so their
+// patterns are built one at a time, each in parallel over the grid.
+FieldCost fieldCost() {
+    FieldCost cost;
+    cost.independent = fieldSource == FieldSource::Analytic || fieldSource == FieldSource::MaskModes ||
+                       fieldSource == FieldSource::Measured;
+    cost.expensive = fieldSource == FieldSource::PlateFdtd || fieldSource == FieldSource::PlateMultigrid;
+    return cost;
+}
+
+// Resets the blender for the current field source and grid, then builds the
+// fields the plan picks before the first frame, several at once if they are
+// independent. The rest are built by the blender when first shown.
+void preparePatterns(const Simulation& sim, PlateSolver& plate, PlateMultigrid& multigrid,
+                     const ModeBlender::Builder& builder) {
+    const int count = patternCount();
+    analyticOffset.first = static_cast<float>(runRandom() % sim.height);
+    analyticOffset.second = static_cast<float>(runRandom() % sim.height);
+    superposition.offsetX = analyticOffset.first;
+    superposition.offsetY = analyticOffset.second;
+    currentParamIndex = std::min(currentParamIndex, std::max(count - 1, 0));
+    blender.reset(builder, count, currentParamIndex);
+
+    const FieldPlan plan = planFields(runSpec, count, currentParamIndex, sim.width, sim.height, fieldCost(),
+                                      audioActive);
+    blender.residentLimit = plan.residentLimit;
+    if (plan.budgetTooSmall) {
+        std::cerr << "Resident budget of " << runSpec.residentMegabytes << " MB holds " << plan.residentLimit
+                  << " of " << count << " fields; sweeps and audio will rebuild fields as they go" << std::endl;
+    }
+    if (plan.precompute.empty()) return;
+
+    const auto start = std::chrono::steady_clock::now();
+    const int planned = static_cast<int>(plan.precompute.size());
+    std::vector<std::vector<float> > fields(planned);
+    #pragma omp parallel for schedule(dynamic) if (plan.parallel)
+    for (int i = 0; i < planned; ++i) {
+        Simulation scratch;
+        scratch.width = sim.width;
+        scratch.height = sim.height;
+        buildPattern(scratch, plate, multigrid, plan.precompute[i]);
+        fields[i].swap(scratch.vibrationValues);
+    }
+    for (int i = 0; i < planned; ++i) {
+        blender.store(plan.precompute[i], fields[i]);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Precomputed " << planned << " of " << count << " fields" << (plan.parallel ? " in parallel" : "")
+              << " in " << seconds << " s, " << plan.fieldBytes * planned / (1 << 20) << " MB resident"
+              << (plan.residentLimit ? ", at most " + std::to_string(plan.residentLimit) + " fields cached" : "")
+              << std::endl;
+}
 
-    // Frequency calculation for a square plate with free boundaries
-    float frequency = (PI / 2) * sqrt(E / density) * (h / (a * a)) * sqrt((params.m * params.m) + (params.n * params.n));
-    return frequency;
+// Loads a measured scan into the cache and adds it as a pattern. Reports failures.
+bool addScan(const std::string& filename, float frequency) {
+    std::string error;
+    std::shared_ptr<const MeasuredScan> scan = scanCache.load(filename, error);
+    if (!scan) {
+        std::cerr << "Failed to load scan " << filename << ": " << error << std::endl;
+        return false;
+    }
+    std::cout << "Scan: " << filename << " " << scan->width << "x" << scan->height << ", channel "
+              << scan->channel << ", " << scan->invalidSamples << " dropouts" << std::endl;
+    ScanPattern pattern;
+    pattern.filename = filename;
+    pattern.frequency = frequency;
+    scanPatterns.push_back(pattern);
+    return true;
 }
 
+// Shows the frequency and the nearest square-plate modes, degenerate ones included, in the title.
 void displayFrequency(GLFWwindow* window, float frequency) {
     char title[256];
-    sprintf(title, "Chladni Plate Simulation - Frequency: %.2f Hz", frequency);
+    int length = snprintf(title, sizeof(title), "Chladni Plate Simulation - Frequency: %.2f Hz - nearest mode", frequency);
+    const int nearest = squareModes.nearest(frequency);
+    if (nearest >= 0) {
+        const std::pair<int, int> range = squareModes.degenerate(nearest);
+        for (int i = range.first; i < range.second && length < static_cast<int>(sizeof(title)); ++i) {
+            const IndexedMode& mode = squareModes.modes()[i];
+            length += snprintf(title + length, sizeof(title) - length, " (%d,%d)", mode.m, mode.n);
+        }
+    }
     glfwSetWindowTitle(window, title);
 }
 
@@ -178,104 +408,289 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
         glfwGetCursorPos(window, &xpos, &ypos);
         int windowWidth, windowHeight;
         glfwGetWindowSize(window, &windowWidth, &windowHeight);
+        if (windowWidth <= 0 || windowHeight <= 0) return;
 
-        ypos = windowHeight - ypos - 1;
+        // Window coordinates to framebuffer pixels (they differ on high-DPI screens), y up, then to the grid
+        const ViewTransform& view = renderer.view;
+        xpos = xpos * view.framebufferWidth / windowWidth;
+        ypos = (windowHeight - ypos) * view.framebufferHeight / windowHeight;
+        float gridX, gridY;
+        if (!view.toGrid(xpos, ypos, gridX, gridY)) return;
 
         void* ptr = glfwGetWindowUserPointer(window);
         if (!ptr) return; 
-        std::vector<Particle>* particles = static_cast<std::vector<Particle>*>(ptr);
+        ParticlePool* pool = static_cast<ParticlePool*>(ptr);
 
-        initializeParticlesAtMouse(*particles, windowWidth, windowHeight, 500, xpos, ypos); 
+        initializeParticlesAtMouse(*pool, runSpec.spawnCount, gridX, gridY);
     }
 }
 
-// Function to initialize particles at a given mouse position.
-void initializeParticlesAtMouse(std::vector<Particle>& particles, int windowWidth, int windowHeight, int count, float posX, float posY) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(-10.0, 10.0); 
+// Function to handle framebuffer resizes: only the view changes, never the grid or the particles.
+void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
+    if (width <= 0 || height <= 0) return;   // Minimized.
+    renderer.view.fit(renderer.view.gridWidth, renderer.view.gridHeight, width, height);
+}
 
-    for (int i = 0; i < count; ++i) {
-        float x = posX + dis(gen); 
-        float y = posY + dis(gen);
-        particles.emplace_back(x, y);
-    }
+// Function to initialize particles at a given mouse position.
+// Recycles parked off-screen slots first, so spawning never reallocates.
+void initializeParticlesAtMouse(ParticlePool& pool, int count, float posX, float posY) {
+    pool.spawn(count, posX, posY, 10.0f);
 }
 
 
 // Function to initialize particles at random positions.
-void initializeParticles(std::vector<Particle>& particles, int windowWidth, int windowHeight) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+void initializeParticles(std::vector<Particle>& particles, int gridWidth, int gridHeight) {
     std::uniform_real_distribution<> dis(0.0, 1.0);
 
     particles.clear();
-    for (int i = 0; i < 30000; ++i) {
-        particles.emplace_back(dis(gen) * windowWidth, dis(gen) * windowHeight);
+    for (int i = 0; i < runSpec.particleCount; ++i) {
+        particles.emplace_back(dis(runRandom) * gridWidth, dis(runRandom) * gridHeight);
     }
 }
 
 // Function to update particle positions based on the simulation gradients.
-void updateParticles(std::vector<Particle>& particles, Simulation& sim, int windowWidth, int windowHeight, bool isRunning) {
+void updateParticles(std::vector<Particle>& particles, ParticleVelocities& velocities, Simulation& sim,
+                     int gridWidth, int gridHeight, bool isRunning) {
     if (!isRunning) return;
+    const size_t cells = static_cast<size_t>(gridWidth) * gridHeight;
+    if (sim.gradients.size() != cells || sim.vibrationValues.size() != cells) return;
 
     // Slow factor to control particle movement speed.
     float slowFactor = 0.2; 
 
-    // Update particle positions based on the gradient vectors.
-    for (auto& particle : particles) {
-        if (particle.x < 0 || particle.x >= windowWidth || particle.y < 0 || particle.y >= windowHeight) {
-            continue; 
+    // Random numbers are hashed from one seed per step and the particle index,
+    // so the chunks can run on every core and a seeded run repeats exactly.
+    const uint32_t seed = static_cast<uint32_t>(runRandom());
+    const float jitter = jitterSchedule.globalScale(annealSteps++);
+    const size_t count = particles.size();
+    if (integratorKind == IntegratorKind::Inertial) velocities.resize(count);
+    const int chunks = static_cast<int>((count + particleChunk - 1) / particleChunk);
+
+    #pragma omp parallel for schedule(static)
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+        const size_t begin = static_cast<size_t>(chunk) * particleChunk;
+        const size_t end = std::min(count, begin + particleChunk);
+        if (integratorKind == IntegratorKind::Inertial) {
+            inertialIntegrator.step(particles.data(), velocities, begin, end, sim.vibrationValues.data(),
+                                    sim.gradients.data(), gridWidth, gridHeight, seed);
+        } else {
+            jitterStep(particles.data(), begin, end, sim.gradients.data(), sim.vibrationValues.data(), gridWidth,
+                       gridHeight, slowFactor, jitterSchedule, jitter, seed);
         }
+    }
+}
 
-        int index = static_cast<int>(particle.y) * windowWidth + static_cast<int>(particle.x);
-        if (index < 0 || index >= sim.gradients.size()) {
-            continue; 
+// Main function to run the simulation.
+int main(int argc, char** argv) {
+    // Headless benchmarks: ChladniPlateSim --bench <name>
+    if (argc == 3 && std::string(argv[1]) == "--bench") {
+        if (!runBenchmark(argv[2], std::cout)) {
+            std::cerr << "Unknown benchmark: " << argv[2] << std::endl;
+            return -1;
         }
+        return 0;
+    }
 
-        Gradient grad = sim.gradients[index];
+    // Headless regression check against stored goldens: ChladniPlateSim --regress <regress> [--update]
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--regress") {
+        const bool update = argc == 4 && std::string(argv[3]) == "--update";
+        return runRegression(argv[2], update, std::cout) ? 0 : 1;
+    }
 
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<> dis(-0.5, 0.5); // Random displacement distribution
+    // Run spec, combinable with every option below, which override it: ... --spec <scene/chladni.json>
+    std::string specPath;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) != "--spec") continue;
+        std::string error;
+        if (!loadRunSpec(argv[i + 1], runSpec, error)) {
+            std::cerr << "Failed to load run spec " << error << std::endl;
+            return -1;
+        }
+        specPath = argv[i + 1];
+    }
 
-// Randomly adjust the particle's position
-        particle.x += grad.dx * slowFactor + dis(gen); // Add some randomness
-        particle.y += grad.dy * slowFactor + dis(gen);//
-        // Apply a factor to slow down movement
-       // particle.x += grad.dx * slowFactor + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX) * windowWidth);
-       // particle.y += grad.dy * slowFactor + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX) * windowHeight);
+    // Frame stream, combinable with the options below: ... --video <file.y4m | file.rgb | ->
+    // Resolved before any status output, which must not reach a video on stdout.
+    videoPath = runSpec.video;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--video") videoPath = argv[i + 1];
+    }
+    if (videoPath == "-") {
+        // stdout carries the video, so status output moves to stderr.
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    if (!specPath.empty()) std::cout << "Run spec: " << specPath << std::endl;
+
+    // Field grid resolution, independent of the window: ... --grid <width>x<height>
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) != "--grid") continue;
+        int width = 0, height = 0;
+        if (std::sscanf(argv[i + 1], "%dx%d", &width, &height) != 2 || width < 16 || height < 16) {
+            std::cerr << "Expected --grid <width>x<height>, got " << argv[i + 1] << std::endl;
+            return -1;
+        }
+        runSpec.width = width;
+        runSpec.height = height;
+    }
+    if (runSpec.seeded) {
+        runRandom.seed(runSpec.seed);
+    } else {
+        runRandom.seed(std::random_device()());
+    }
+    if (!runSpec.modes.empty()) chladniParams = runSpec.modes;
+    static const FieldSource specSources[] = {FieldSource::Analytic, FieldSource::PlateFdtd, FieldSource::PlateMultigrid,
+                                              FieldSource::MaskModes, FieldSource::CircularModes, FieldSource::Measured};
+    static const char* const specSourceNames[] = {"analytic", "fdtd", "multigrid", "mask", "circular", "scan"};
+    for (int i = 0; i < 6; ++i) {
+        if (runSpec.field == specSourceNames[i]) fieldSource = specSources[i];
+    }
+    currentParamIndex = runSpec.startPattern;
+
+    // Particle motion, combinable with the options below: ... --integrator jitter | inertial,
+    // --anneal fixed | global | local
+    inertialIntegrator.damping = runSpec.damping;
+    if (runSpec.integrator == "inertial") integratorKind = IntegratorKind::Inertial;
+    jitterSchedule.halfLife = runSpec.annealHalfLife;
+    const AnnealMode annealModes[] = {AnnealMode::Fixed, AnnealMode::Global, AnnealMode::Local};
+    for (AnnealMode mode : annealModes) {
+        if (runSpec.anneal == annealModeName(mode)) jitterSchedule.mode = mode;
+    }
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--integrator") {
+            integratorKind = std::string(argv[i + 1]) == "inertial" ? IntegratorKind::Inertial : IntegratorKind::Jitter;
+        }
+        if (option != "--anneal") continue;
+        for (AnnealMode mode : annealModes) {
+            if (argv[i + 1] == std::string(annealModeName(mode))) jitterSchedule.mode = mode;
+        }
+    }
 
-        // Boundary checks
+    // Step pacing, combinable with the options below: ... --substeps K, --fast-forward N (draw every Nth step, 0 never)
+    simClock.substeps = runSpec.substeps;
+    simClock.renderEvery = runSpec.renderEvery;
+    if (runSpec.fastForward) simClock.mode = ClockMode::FastForward;
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--substeps") simClock.substeps = std::max(1, std::atoi(argv[i + 1]));
+        if (option == "--fast-forward") {
+            simClock.mode = ClockMode::FastForward;
+            simClock.renderEvery = std::max(0, std::atoi(argv[i + 1]));
+        }
     }
-}
 
-// Function to render particles on the screen.
-void renderParticles(const std::vector<Particle>& particles, int windowWidth, int windowHeight) {
-    glPointSize(1.0f);
-    glBegin(GL_POINTS);
-    for (const auto& particle : particles) {
-        if (particle.x <= 0 || particle.x >= windowWidth || particle.y <= 0 || particle.y >= windowHeight) {
-            continue; 
+    // Plate shape from a mask image, combinable with the other options: ... --mask <file.png> [--modes K]
+    std::string maskPath = runSpec.mask;
+    shapeModes.modeCount = runSpec.maskModes;
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--modes") shapeModes.modeCount = std::max(1, std::atoi(argv[i + 1]));
+        if (option != "--mask") continue;
+        maskPath = argv[i + 1];
+        fieldSource = FieldSource::MaskModes;
+    }
+    if (!maskPath.empty()) {
+        PlateMask mask;
+        std::string error;
+        if (!mask.loadPng(maskPath, error)) {
+            std::cerr << "Failed to load mask " << maskPath << ": " << error << std::endl;
+            return -1;
         }
-        float glX = (particle.x / windowWidth) * 2.0f - 1.0f;
-        float glY = (particle.y / windowHeight) * 2.0f - 1.0f;
-        glVertex2f(glX, glY);
+        if (!shapeModes.solve(mask)) {
+            std::cerr << "Mask " << maskPath << " has too few plate cells." << std::endl;
+            return -1;
+        }
+        std::cout << "Mask modes: " << mask.cellCount() << " cells, " << shapeModes.computedModes() << " modes, "
+                  << shapeModes.levels << " levels, " << shapeModes.iterations << " iterations, "
+                  << shapeModes.seconds << " s" << std::endl;
     }
-    glEnd();
-}
 
+    // Plate driven by a recording, combinable likewise: ... --audio <file.wav>
+    std::string audioPath = runSpec.audio;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--audio") audioPath = argv[i + 1];
+    }
+    if (!audioPath.empty()) {
+        std::string error;
+        if (!audio.open(audioPath, error)) {
+            std::cerr << "Failed to open audio " << audioPath << ": " << error << std::endl;
+            return -1;
+        }
+        audioActive = true;
+    }
+
+    // Measured plates, combinable with the other options: ... --scan <file.exr | file.png>[@Hz] ...
+    // [--scan-filter bilinear | lanczos]. Each scan is one pattern, after those of the spec.
+    for (const ScanSpec& scan : runSpec.scans) {
+        if (!addScan(scan.file, scan.frequency)) return -1;
+    }
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--scan-filter") {
+            scanFilter = std::string(argv[i + 1]) == "bilinear" ? ResampleFilter::Bilinear : ResampleFilter::Lanczos3;
+            continue;
+        }
+        if (option != "--scan") continue;
+        std::string filename = argv[i + 1];
+        float frequency = 0.0f;
+        const size_t at = filename.rfind('@');
+        if (at != std::string::npos) {
+            frequency = static_cast<float>(std::atof(filename.c_str() + at + 1));
+            filename.erase(at);
+        }
+        if (!addScan(filename, frequency)) return -1;
+        fieldSource = FieldSource::Measured;
+    }
+
+    // External control, combinable with the options above: ... --control <socket path>
+    std::string controlPath = runSpec.control;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--control") controlPath = argv[i + 1];
+    }
+    if (!controlPath.empty()) {
+        std::string error;
+        if (!control.start(controlPath, error)) {
+            std::cerr << "Failed to open control socket " << controlPath << ": " << error << std::endl;
+            return -1;
+        }
+        std::cout << "Control socket: " << controlPath << std::endl;
+    }
+
+    // Shared-memory frame export, combinable likewise: ... --shm <name> or --shm-particles <name>
+    std::string shmName = runSpec.shm.empty() ? runSpec.shmParticles : runSpec.shm;
+    bool shmPixels = !runSpec.shm.empty();
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string option = argv[i];
+        if (option != "--shm" && option != "--shm-particles") continue;
+        shmName = argv[i + 1];
+        shmPixels = option == "--shm";
+    }
+    if (!shmName.empty()) {
+        std::string error;
+        if (!frameExport.open(shmName, shmPixels ? SharedFrameKind::Pixels : SharedFrameKind::Particles,
+                              shmPixels ? static_cast<size_t>(runSpec.width) * runSpec.height * 4
+                                        : runSpec.particleCapacity * 2 * sizeof(float), error)) {
+            std::cerr << "Failed to open shared memory " << shmName << ": " << error << std::endl;
+            return -1;
+        }
+        std::cout << "Shared frames: /dev/shm/" << shmName << std::endl;
+    }
+
+    // A spec may name a source whose patterns did not load; fall back to the analytic field.
+    if ((fieldSource == FieldSource::MaskModes && shapeModes.computedModes() == 0) ||
+        (fieldSource == FieldSource::Measured && scanPatterns.empty())) {
+        fieldSource = FieldSource::Analytic;
+    }
 
-// Main function to run the simulation.
-int main() {
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW." << std::endl;
         return -1;
     }
 
-    int windowWidth = 640;
-    int windowHeight = 480;
-    GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "Chladni Plate Simulation", NULL, NULL);
+    // The window opens at the grid size; resizing it later only rescales the view
+    const int gridWidth = runSpec.width;
+    const int gridHeight = runSpec.height;
+    GLFWwindow* window = glfwCreateWindow(gridWidth, gridHeight, "Chladni Plate Simulation", NULL, NULL);
     if (!window) {
         std::cerr << "Failed to create GLFW window." << std::endl;
         glfwTerminate();
@@ -283,53 +698,250 @@ int main() {
     }
 
     glfwMakeContextCurrent(window);
+    glfwSwapInterval(simClock.mode == ClockMode::FastForward ? 0 : 1);
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    renderer.view.fit(gridWidth, gridHeight, framebufferWidth, framebufferHeight);
+
+    if (!videoPath.empty()) {
+        std::string error;
+        const VideoFormat format = VideoStreamer::formatFor(videoPath);
+        if (!video.open(videoPath, format, framebufferWidth, framebufferHeight, videoFps, error)) {
+            std::cerr << "Failed to open video output " << videoPath << ": " << error << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        std::cout << "Video: " << (format == VideoFormat::Y4m ? "Y4M" : "raw rgb24") << " " << framebufferWidth << "x"
+                  << framebufferHeight << " at " << videoFps << " fps to " << videoPath << std::endl;
+    }
     glfwSetKeyCallback(window, keyCallback); 
     glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
     
 
 
     // Create and initialize particles
-    std::vector<Particle> particles;
-    initializeParticles(particles, windowWidth, windowHeight);
-    glfwSetWindowUserPointer(window, &particles);
+    ParticlePool pool(runSpec.particleCapacity, runRandom());
+    std::vector<Particle>& particles = pool.particles;
+    initializeParticles(particles, gridWidth, gridHeight);
+    glfwSetWindowUserPointer(window, &pool);
 
 
     // Initialize Simulation
     Simulation sim;
-    sim.width = windowWidth;
-    sim.height = windowHeight;
-    sim.computeVibrationValues(chladniParams[0]);
-    sim.computeGradients();
-    float currentFrequency = calculateFrequency(chladniParams[currentParamIndex]);
-    displayFrequency(window, currentFrequency);
-
+    sim.width = gridWidth;
+    sim.height = gridHeight;
+    PlateSolver plate;
+    PlateMultigrid multigrid;
+    circularPlate.precompute(circularModes);
+    squareModes.build(modeIndexOrder);
+
+    // Patterns the plan leaves out are built on first use into a scratch simulation and cached by the blender
+    Simulation patternSim;
+    ModeBlender::Builder builder = [&](int pattern, std::vector<float>& out) {
+        patternSim.width = sim.width;
+        patternSim.height = sim.height;
+        buildPattern(patternSim, plate, multigrid, pattern);
+        out.swap(patternSim.vibrationValues);
+    };
+    preparePatterns(sim, plate, multigrid, builder);
+    if (runSpec.sweep) blender.toggleSweep();
+    audio.setPatterns(patternFrequencies());
+    double lastTime = glfwGetTime();
+    double audioStart = lastTime;
+
+    // Grid reused every frame for collision lookups
+    SpatialGrid grid;
+
+    // Keeps particles in Z-order so gradient lookups stay cache friendly
+    MortonSorter sorter;
+
+    long long frame = 0;
     while (!glfwWindowShouldClose(window)) {
-        glClear(GL_COLOR_BUFFER_BIT);
-
         // Check if parameters need updating
-        if (needsResize) {
-            glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
-            glViewport(0, 0, windowWidth, windowHeight);
-            initializeParticles(particles, windowWidth, windowHeight);
-            sim.width = windowWidth;
-            sim.height = windowHeight;
-            sim.computeVibrationValues(chladniParams[currentParamIndex]); 
-            sim.computeGradients();
-            needsResize = false;
+        if (needsReset) {
+            pool.reset();
+            initializeParticles(particles, gridWidth, gridHeight);
+            annealSteps = 0;
+            if (needsRebuild) {
+                preparePatterns(sim, plate, multigrid, builder);
+                audio.setPatterns(patternFrequencies());
+                needsRebuild = false;
+            }
+            needsReset = false;
+        }
+
+        // Carry out queued control commands; this never waits on the socket
+        Command command;
+        while (control.nextCommand(command)) {
+            switch (command.type) {
+                case CommandType::SetMode:
+                    blender.crossfadeTo(command.pattern);
+                    break;
+                case CommandType::Spawn:
+                    pool.spawn(command.count, command.x, command.y, 10.0f);
+                    break;
+                case CommandType::Pause:
+                    isRunning = false;
+                    break;
+                case CommandType::Resume:
+                    isRunning = true;
+                    break;
+                case CommandType::Snapshot:
+                    control.completeSnapshot(command, particles);
+                    break;
+            }
+        }
+
+        // Advance the crossfade or sweep; the field only changes while the blend moves
+        double now = glfwGetTime();
+        float dt = static_cast<float>(std::min(now - lastTime, 0.1));
+        lastTime = now;
+        if (blender.update(sim, dt)) {
+            annealSteps = 0;
+            currentParamIndex = blender.nearestPattern();
+            float mix = blender.mix();
+            currentFrequency = (1.0f - mix) * patternFrequency(blender.basePattern()) +
+                               mix * patternFrequency(blender.nextPattern());
+            displayFrequency(window, currentFrequency);
+        }
+
+        // Follow the recording in real time, mixing the patterns its spectrum excites.
+        // Analytic modes are superposed; other sources blend their cached magnitudes.
+        if (audioActive && audio.advanceTo(now - audioStart)) {
+            if (fieldSource == FieldSource::Analytic) {
+                superposition.resize(sim.width, sim.height);
+                superposition.evaluate(chladniParams, audio.weights(), sim.vibrationValues);
+                sim.computeGradients();
+            } else {
+                blender.compose(sim, audio.weights());
+            }
+            annealSteps = 0;
+            currentFrequency = audio.dominantFrequency;
+            displayFrequency(window, currentFrequency);
+        }
+        if (audioActive && audio.finished()) {
+            std::cout << "Audio: " << audio.blocks << " blocks of " << audio.position() << " s analysed in "
+                      << audio.analysisSeconds << " s" << std::endl;
+            audioActive = false;
         }
 
-        // Update particles if the simulation is running
-        if (isRunning) {
-            updateParticles(particles, sim, windowWidth, windowHeight, isRunning);
+        // Compact before stepping: after a policy change, parked and escaped
+        // particles must be dropped before the new policy brings them back
+        if (needsCompaction) {
+            pool.compact(gridWidth, gridHeight);
+            needsCompaction = false;
         }
 
-        // Render particles
-        renderParticles(particles, windowWidth, windowHeight);
+        // Run the particle steps the clock has due; none while paused
+        simClock.beginFrame(now, isRunning);
+        while (simClock.stepDue(glfwGetTime())) {
+            updateParticles(particles, pool.velocities, sim, gridWidth, gridHeight, isRunning);
+
+            if (collisionsEnabled) {
+                grid.build(particles, gridWidth, gridHeight, particleRadius);
+                applyRepulsion(particles, grid, particleRadius, repulsionStrength);
+            }
+
+            applyBoundary(particles, gridWidth, gridHeight, boundaryPolicy);
+
+            if (++frame % compactInterval == 0) {
+                needsCompaction = true;
+            }
+
+            ParticleVelocities* velocities = integratorKind == IntegratorKind::Inertial ? &pool.velocities : nullptr;
+            if (sorter.update(particles, gridWidth, gridHeight, velocities)) {
+                pool.invalidateFreeSlots();
+            }
+            pool.reclaim(gridWidth, gridHeight, reclaimBudget);
+        }
+
+        // Dump the field for inspection outside the simulator
+        if (needsFieldDump) {
+            FieldExrWriter writer;
+            const std::string filename = "chladni_field_" + std::to_string(fieldDumpCount++) + ".exr";
+            std::string error;
+            if (writer.write(filename, sim, error)) {
+                std::cout << "Saved " << filename << " (" << writer.tiles << " tiles, " << writer.fileBytes
+                          << " bytes)" << std::endl;
+            } else {
+                std::cerr << "Failed to save " << filename << ": " << error << std::endl;
+            }
+            needsFieldDump = false;
+        }
+
+        // Draw the state; in fast-forward only every Nth one is, and the frame outputs follow the drawn frames
+        if (simClock.renderDue()) {
+            // Render particles through the view transform
+            renderer.draw(particles);
+            const int frameWidth = renderer.view.framebufferWidth, frameHeight = renderer.view.framebufferHeight;
+
+            // Publish the frame in place for consumers of the shared-memory ring
+            if (frameExport.isOpen()) {
+                if (frameExport.kind == SharedFrameKind::Pixels) {
+                    void* pixels = frameExport.beginFrame(static_cast<size_t>(frameWidth) * frameHeight * 4,
+                                                          frameWidth, frameHeight, frame);
+                    if (pixels) {
+                        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                        glReadPixels(0, 0, frameWidth, frameHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+                    }
+                    frameExport.endFrame();
+                } else {
+                    frameExport.publishParticles(particles, gridWidth, gridHeight, frame);
+                }
+            }
+
+            // Dump the frame; the PNG is filtered and deflated on every core
+            if (needsScreenshot) {
+                std::vector<uint8_t> pixels(static_cast<size_t>(frameWidth) * frameHeight * 4);
+                glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                glReadPixels(0, 0, frameWidth, frameHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+                const std::string filename = "chladni_" + std::to_string(screenshotCount++) + ".png";
+                std::string error;
+                if (writePng(filename, pixels, frameWidth, frameHeight, true, error)) {
+                    std::cout << "Saved " << filename << std::endl;
+                } else {
+                    std::cerr << "Failed to save " << filename << ": " << error << std::endl;
+                }
+                needsScreenshot = false;
+            }
+
+            // Queue the frame for the video stream; conversion and writing happen on other threads
+            if (video.isOpen()) {
+                uint8_t* pixels = video.acquire(frameWidth, frameHeight);
+                if (pixels) {
+                    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                    glReadPixels(0, 0, frameWidth, frameHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+                }
+                video.submit();
+            }
+
+            glfwSwapBuffers(window);
+        }
+
+        // Publish this frame's state for metrics queries
+        control.metrics.frame.store(frame);
+        control.metrics.fps.store(dt > 0 ? 1.0f / dt : 0.0f);
+        control.metrics.particles.store(static_cast<long long>(particles.size()));
+        control.metrics.pattern.store(currentParamIndex);
+        control.metrics.patternCount.store(patternCount());
+        control.metrics.frequency.store(currentFrequency);
+        control.metrics.running.store(isRunning);
 
-        glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    sorter.report(std::cout);
+    simClock.report(std::cout, glfwGetTime());
+    control.stop();
+    frameExport.close();
+    if (video.isOpen()) {
+        video.close();
+        std::cout << "Video: " << video.framesWritten << " of " << video.framesSubmitted << " frames written"
+                  << (video.failed ? " before the output closed" : "") << ", render thread waited "
+                  << video.renderWaitSeconds << " s in total, at most " << video.maxRenderWaitSeconds << " s" << std::endl;
+    }
+
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;